@@ -0,0 +1,762 @@
+/*
+ * csv_bench.c
+ *
+ * PURPOSE: Measures the performance of csv_merge. Generates a pair of synthetic csv files from a fixed seed, runs
+ *          csv_merge on them once per join engine and prints the timings of each run as one JSON object per line,
+ *          along with the report csv_merge gives with --stats. every run must write the same number of rows to each
+ *          output, so the benchmark also checks the engines agree on awkward inputs.
+ */
+
+#define _GNU_SOURCE //for wait4
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define null "NULL" // "NULL" is the value csv_merge treats as null
+
+//names of the files csv_merge reads and writes within its working directory
+#define FILENAME1 "input1.txt"
+#define FILENAME2 "input2.txt"
+#define NATURAL_OUTPUT "Natural_Join.txt"
+#define LEFT_OUTPUT "Left_Join.txt"
+#define FULL_OUTER_OUTPUT "Full_Outer_Join.txt"
+#define INDEX_FILE "input2.index" //index of the second input the index engine joins against
+#define STATS_FILE "stats.json" //where csv_merge's --stats report is kept while it is read back
+
+#define WRITE_BUFFER_SIZE (1024 * 1024) //size of the buffer each generated file is written through
+#define COUNT_BUFFER_SIZE (1024 * 1024) //size of each block an output file is read in when counting its rows
+#define MAX_ARGS 16 //most arguments csv_merge is ever run with
+
+typedef struct BENCH_OPTIONS
+{
+	long rows1;          //rows generated for each input
+	long rows2;
+	int cols;            //columbs of each input, including the key columbs
+	int key_cols;        //columbs shared by both inputs
+	long keys;           //distinct values of each key columb
+	double zipf;         //skew of the key values, 0 gives every value the same chance
+	double nulls;        //chance of a key value being null
+	int width;           //characters in each value of a non-key columb
+	double quotes;       //chance of a non-key value holding a comma and a quote so it has to be quoted
+	double breaks;       //chance of a non-key value holding a line break so it has to be quoted
+	double stray_quotes; //chance of a non-key value holding a quote after its first character, leaving it unquoted
+	int is_gzipped;      //boolean, the inputs are compressed with gzip before csv_merge reads them
+	uint64_t seed;
+	int repeat;          //runs of each engine
+	char* threads;       //passed to csv_merge as --threads, NULL to leave it out
+	char* memory_limit;  //passed to csv_merge as --memory-limit by the memory-limit engine
+	char* engine;        //only engine to run, NULL for every engine
+	char* program;       //path of the csv_merge program
+	char* dir;           //directory the inputs are generated in and csv_merge is run in
+	char* inputs[2];     //names csv_merge is given the inputs by
+} Bench_options;
+
+typedef struct BENCH_ENGINE
+{
+	char* name;
+	char* option;        //option selecting the engine, NULL for the default engine
+	int is_indexed;      //boolean, the engine joins the first input against an index built from the second with --build-index
+} Bench_engine;
+
+//every join engine of csv_merge, new engines only need adding here
+Bench_engine engines[] = {
+	{ "hash", NULL, 0 },
+	{ "stream", "--stream", 0 },
+	{ "sort-merge", "--sort-merge", 0 },
+	{ "bloom", "--bloom", 0 },
+	{ "memory-limit", "--memory-limit", 0 },
+	{ "index", "--index", 1 },
+};
+
+/**
+ * PURPOSE: steps a splitmix64 random number generator
+ * INPUT PARAMETERS:
+ *    state: the generator's state, advanced by the call
+ * OUTPUT PARAMETERS:
+ *    returns the next 64 random bits
+ */
+uint64_t next_random(uint64_t* state)
+{
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * PURPOSE: draws a random number between 0 and 1
+ * INPUT PARAMETERS:
+ *    state: the generator's state, advanced by the call
+ * OUTPUT PARAMETERS:
+ *    returns a number at least 0 and less than 1
+ */
+double next_fraction(uint64_t* state)
+{
+	return (double)(next_random(state) >> 11) / (double)(1ULL << 53);
+}
+
+/**
+ * PURPOSE: builds the cumulative distribution of a zipf distribution so key values can be drawn from it
+ * INPUT PARAMETERS:
+ *    keys: number of distinct values
+ *    skew: exponent of the distribution, value k is drawn with a chance proportional to 1 / (k + 1)^skew
+ * OUTPUT PARAMETERS:
+ *    returns the chance of drawing each value or any value before it, or NULL if skew is 0 and values are drawn evenly
+ */
+double* new_zipf_table(long keys, double skew)
+{
+	double* cdf = NULL;
+	double total = 0;
+
+	if (0 == skew)
+	{
+		return NULL;
+	}
+
+	cdf = malloc((keys + 1) * sizeof(double));
+	assert(NULL != cdf);
+	for (long k = 0; k < keys; k++)
+	{
+		total += 1.0 / pow((double)(k + 1), skew);
+		cdf[k] = total;
+	}
+	for (long k = 0; k < keys; k++)
+	{
+		cdf[k] /= total;
+	}
+	return cdf;
+}
+
+/**
+ * PURPOSE: draws a key value
+ * INPUT PARAMETERS:
+ *    state: the generator's state, advanced by the call
+ *    keys: number of distinct values
+ *    cdf: table from new_zipf_table, or NULL to draw values evenly
+ * OUTPUT PARAMETERS:
+ *    returns a value from 0 to keys - 1
+ */
+long next_key(uint64_t* state, long keys, double* cdf)
+{
+	double draw = next_fraction(state);
+	long low = 0;
+	long high = keys - 1;
+	long mid = 0;
+
+	if (NULL == cdf)
+	{
+		return (long)(next_random(state) % (uint64_t)keys);
+	}
+
+	//finds the first value whose cumulative chance reaches the draw
+	while (low < high)
+	{
+		mid = low + (high - low) / 2;
+		if (cdf[mid] < draw)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/**
+ * PURPOSE: writes a random value of a non-key columb, quoting it when it holds a comma and a quote or a line break
+ * INPUT PARAMETERS:
+ *    output: file to write to
+ *    state: the generator's state, advanced by the call
+ *    options: the benchmark's options
+ */
+void write_random_value(FILE* output, uint64_t* state, Bench_options* options)
+{
+	static const char letters[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+	int is_quoted = (next_fraction(state) < options->quotes);
+	//the other chances are only drawn when asked for, so a seed gives the same inputs it gave before they were added
+	int is_broken = (!is_quoted && 0 < options->breaks && next_fraction(state) < options->breaks);
+	int is_stray = (!is_quoted && !is_broken && 0 < options->stray_quotes && next_fraction(state) < options->stray_quotes);
+
+	if (is_quoted)
+	{
+		fputs("\"a,\"\"", output);
+	}
+	else if (is_broken)
+	{
+		fputs("\"a\n", output);
+	}
+	else if (is_stray)
+	{
+		fputs("a\"", output);
+	}
+	for (int i = 0; i < options->width; i++)
+	{
+		putc(letters[next_random(state) % (sizeof(letters) - 1)], output);
+	}
+	if (is_quoted || is_broken)
+	{
+		putc('"', output);
+	}
+}
+
+/**
+ * PURPOSE: generates one of the two input files. the first key_cols columbs are named the same in both files so they are
+ *          joined on, the rest are named after the file so they are not
+ * INPUT PARAMETERS:
+ *    filename: name of the file to create
+ *    file: 1 or 2, which input is generated
+ *    rows: number of rows to generate
+ *    cdf: table from new_zipf_table, or NULL to draw key values evenly
+ *    options: the benchmark's options
+ * OUTPUT PARAMETERS:
+ *    returns the size of the file in bytes, exiting the program if it could not be written
+ */
+long generate_csv(char* filename, int file, long rows, double* cdf, Bench_options* options)
+{
+	FILE* output = fopen(filename, "w");
+	uint64_t state = options->seed * 2 + (uint64_t)file;
+	long size = 0;
+
+	if (NULL == output)
+	{
+		fprintf(stderr, "Unable to create %s.\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	setvbuf(output, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+	for (int c = 0; c < options->cols; c++)
+	{
+		fprintf(output, (c < options->key_cols) ? "%skey%d" : "%scol%d_%d", (0 < c) ? "," : "", (c < options->key_cols) ? c : file, c);
+	}
+	putc('\n', output);
+
+	for (long r = 0; r < rows; r++)
+	{
+		for (int c = 0; c < options->cols; c++)
+		{
+			if (0 < c)
+			{
+				putc(',', output);
+			}
+			if (c < options->key_cols && next_fraction(&state) < options->nulls)
+			{
+				fputs(null, output);
+			}
+			else if (c < options->key_cols)
+			{
+				fprintf(output, "k%ld", next_key(&state, options->keys, cdf));
+			}
+			else
+			{
+				write_random_value(output, &state, options);
+			}
+		}
+		putc('\n', output);
+	}
+
+	size = ftell(output);
+	if (0 != fclose(output))
+	{
+		fprintf(stderr, "Unable to write %s.\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	return size;
+}
+
+/**
+ * PURPOSE: compresses a generated input with gzip, replacing it with the compressed file
+ * INPUT PARAMETERS:
+ *    filename: name of the input, the compressed file is named after it with .gz added
+ * OUTPUT PARAMETERS:
+ *    exits the program if gzip could not be run or failed
+ */
+void gzip_file(char* filename)
+{
+	char* argv[] = { "gzip", "-1", "-f", filename, NULL };
+	int status = 0;
+	pid_t child = fork();
+
+	if (0 == child)
+	{
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+	if (-1 == child || -1 == waitpid(child, &status, 0) || !WIFEXITED(status) || 0 != WEXITSTATUS(status))
+	{
+		fprintf(stderr, "Unable to compress %s with gzip.\n", filename);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * PURPOSE: gets the time from a clock that only moves forwards
+ * OUTPUT PARAMETERS:
+ *    returns the time in seconds
+ */
+double now_seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/**
+ * PURPOSE: counts the rows of an output file written by csv_merge and finds its size. csv_merge quotes every value
+ *          holding a quote or a line break, so a row ends at each line feed outside quotes
+ * INPUT PARAMETERS:
+ *    filename: name of the output file
+ *    bytes: set to the size of the file in bytes, 0 if it does not exist
+ * OUTPUT PARAMETERS:
+ *    returns the number of rows in the file, 0 if it does not exist
+ */
+long count_output_rows(char* filename, long* bytes)
+{
+	FILE* input = fopen(filename, "r");
+	char* buffer = NULL;
+	size_t read_size = 0;
+	long rows = 0;
+	char last = '\n';
+	int in_quotes = 0; //boolean
+
+	*bytes = 0;
+	if (NULL == input)
+	{
+		return 0;
+	}
+	buffer = malloc(COUNT_BUFFER_SIZE);
+	assert(NULL != buffer);
+
+	while (0 < (read_size = fread(buffer, 1, COUNT_BUFFER_SIZE, input)))
+	{
+		*bytes += (long)read_size;
+		for (size_t i = 0; i < read_size; i++)
+		{
+			in_quotes ^= ('"' == buffer[i]);
+			rows += ('\n' == buffer[i] && !in_quotes);
+		}
+		last = buffer[read_size - 1];
+	}
+
+	//rows are written with a line feed before them rather than after, so a row ending the file has none after it
+	if (0 < *bytes && '\n' == last)
+	{
+		rows--;
+	}
+	fclose(input);
+	free(buffer);
+	return rows;
+}
+
+/**
+ * PURPOSE: runs csv_merge once and waits for it to finish, keeping what it reports on stderr in STATS_FILE
+ * INPUT PARAMETERS:
+ *    argv: arguments to run csv_merge with, starting with its path and ending in NULL
+ *    name: name of the engine being run, used in error messages
+ *    usage: set to the resources csv_merge used
+ * OUTPUT PARAMETERS:
+ *    returns the seconds csv_merge took, exiting the program if it could not be run or failed
+ */
+double run_program(char* argv[], char* name, struct rusage* usage)
+{
+	double start = now_seconds();
+	int status = 0;
+	pid_t child = 0;
+
+	fflush(stdout);
+	child = fork();
+	if (0 == child)
+	{
+		//silences the program's own messages so only the results reach stdout
+		if (NULL == freopen("/dev/null", "w", stdout) || NULL == freopen(STATS_FILE, "w", stderr))
+		{
+			_exit(127);
+		}
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	if (-1 == child || -1 == wait4(child, &status, 0, usage))
+	{
+		fprintf(stderr, "Unable to run %s.\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	if (!WIFEXITED(status) || 0 != WEXITSTATUS(status))
+	{
+		fprintf(stderr, "%s failed running the %s engine, its messages are in %s.\n", argv[0], name, STATS_FILE);
+		exit(EXIT_FAILURE);
+	}
+	return now_seconds() - start;
+}
+
+/**
+ * PURPOSE: prints the report csv_merge gave with --stats, as the last line of STATS_FILE starting with '{'
+ * OUTPUT PARAMETERS:
+ *    prints the report's JSON object to stdout, or null if there is none
+ */
+void print_stats_report(void)
+{
+	FILE* input = fopen(STATS_FILE, "r");
+	char* line = NULL;
+	char* report = NULL;
+	size_t capacity = 0;
+	ssize_t length = 0;
+
+	while (NULL != input && 0 < (length = getline(&line, &capacity, input)))
+	{
+		if ('{' == line[0])
+		{
+			line[length - 1] = ('\n' == line[length - 1]) ? '\0' : line[length - 1];
+			free(report);
+			report = strdup(line);
+			assert(NULL != report);
+		}
+	}
+	printf("%s", (NULL != report) ? report : "null");
+	if (NULL != input)
+	{
+		fclose(input);
+	}
+	free(line);
+	free(report);
+}
+
+/**
+ * PURPOSE: builds the index the index engine joins against from the second input, naming the key columbs in order
+ * INPUT PARAMETERS:
+ *    options: the benchmark's options
+ * OUTPUT PARAMETERS:
+ *    writes INDEX_FILE and prints how long building it took as a line of JSON to stdout
+ */
+void build_index(Bench_options* options)
+{
+	char* argv[MAX_ARGS];
+	int argc = 0;
+	char* cols = malloc((size_t)options->key_cols * 16 + 1);
+	size_t used = 0;
+	struct rusage usage;
+	double seconds = 0;
+
+	assert(NULL != cols);
+	cols[0] = '\0';
+	for (int c = 0; c < options->key_cols; c++)
+	{
+		used += (size_t)sprintf(cols + used, "%skey%d", (0 < c) ? "," : "", c);
+	}
+
+	argv[argc++] = options->program;
+	argv[argc++] = "--build-index";
+	argv[argc++] = INDEX_FILE;
+	argv[argc++] = "--index-cols";
+	argv[argc++] = cols;
+	argv[argc++] = "--stats";
+	if (NULL != options->threads)
+	{
+		argv[argc++] = "--threads";
+		argv[argc++] = options->threads;
+	}
+	argv[argc++] = options->inputs[1];
+	argv[argc] = NULL;
+
+	seconds = run_program(argv, "index", &usage);
+	printf("{\"build_index\":{\"seconds\":%.6f,\"stats\":", seconds);
+	print_stats_report();
+	printf("}}\n");
+	fflush(stdout);
+	free(cols);
+}
+
+/**
+ * PURPOSE: runs csv_merge once with one engine and prints how it went as a JSON object
+ * INPUT PARAMETERS:
+ *    engine: the engine to run
+ *    run: number of the run, starting at 1
+ *    input_bytes: combined size of both inputs
+ *    options: the benchmark's options
+ *    first_rows: rows of each output written by the first run, -1 before it. set by the first run
+ * OUTPUT PARAMETERS:
+ *    prints a line of JSON to stdout holding the run's times and output sizes followed by csv_merge's --stats report,
+ *    exiting the program if csv_merge could not be run or failed, or wrote a different number of rows to an output
+ *    than the first run did
+ */
+void run_engine(Bench_engine* engine, int run, long input_bytes, Bench_options* options, long* first_rows)
+{
+	char* argv[MAX_ARGS];
+	int argc = 0;
+	char* outputs[] = { NATURAL_OUTPUT, LEFT_OUTPUT, FULL_OUTER_OUTPUT };
+	char* output_names[] = { "natural", "left", "full_outer" };
+	long output_rows = 0;
+	long output_bytes = 0;
+	long input_rows = options->rows1 + options->rows2;
+	struct rusage usage;
+	double seconds = 0;
+
+	argv[argc++] = options->program;
+	argv[argc++] = "--stats";
+	if (NULL != engine->option)
+	{
+		argv[argc++] = engine->option;
+	}
+	if (engine->is_indexed)
+	{
+		argv[argc++] = INDEX_FILE;
+	}
+	if (0 == strcmp(engine->name, "memory-limit"))
+	{
+		argv[argc++] = options->memory_limit;
+	}
+	if (NULL != options->threads)
+	{
+		argv[argc++] = "--threads";
+		argv[argc++] = options->threads;
+	}
+	//the index stands in for the second input, so only the first is named
+	argv[argc++] = options->inputs[0];
+	if (!engine->is_indexed)
+	{
+		argv[argc++] = options->inputs[1];
+	}
+	argv[argc] = NULL;
+
+	seconds = run_program(argv, engine->name, &usage);
+	printf("{\"engine\":\"%s\",\"run\":%d,\"threads\":%s,\"seconds\":%.6f,\"user_seconds\":%.6f,\"system_seconds\":%.6f,"
+		"\"rows_per_second\":%.1f,\"bytes_per_second\":%.1f,\"peak_rss_kb\":%ld,\"outputs\":{",
+		engine->name, run, (NULL != options->threads) ? options->threads : "null", seconds,
+		(double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec / 1e6,
+		(double)usage.ru_stime.tv_sec + (double)usage.ru_stime.tv_usec / 1e6,
+		(double)input_rows / seconds, (double)input_bytes / seconds, usage.ru_maxrss);
+	for (int i = 0; i < 3; i++)
+	{
+		output_rows = count_output_rows(outputs[i], &output_bytes);
+		printf("%s\"%s\":{\"rows\":%ld,\"bytes\":%ld}", (0 < i) ? "," : "", output_names[i], output_rows, output_bytes);
+		if (-1 != first_rows[i] && first_rows[i] != output_rows)
+		{
+			fprintf(stderr, "\nThe %s engine wrote %ld rows to %s where the first run wrote %ld.\n", engine->name, output_rows,
+				outputs[i], first_rows[i]);
+			exit(EXIT_FAILURE);
+		}
+		first_rows[i] = output_rows;
+	}
+	printf("},\"stats\":");
+	print_stats_report();
+	printf("}\n");
+	fflush(stdout);
+}
+
+/**
+ * PURPOSE: reads the value following an option
+ * INPUT PARAMETERS:
+ *    argc: number of arguments
+ *    argv: the arguments
+ *    i: position of the option, moved on to its value
+ * OUTPUT PARAMETERS:
+ *    returns the value, exiting the program if the option is the last argument
+ */
+char* option_value(int argc, char* argv[], int* i)
+{
+	if (*i + 1 >= argc)
+	{
+		fprintf(stderr, "Missing value for %s\n", argv[*i]);
+		exit(EXIT_FAILURE);
+	}
+	(*i)++;
+	return argv[*i];
+}
+
+int main(int argc, char* argv[])
+{
+	Bench_options options = { 1000000, 1000000, 4, 1, 100000, 0, 0, 8, 0, 0, 0, 0, 1, 1, NULL, "16M", NULL, "./csv_merge.out", "bench_data",
+		{ FILENAME1, FILENAME2 } };
+	long first_rows[3] = { -1, -1, -1 };
+	char program[PATH_MAX];
+	double* cdf = NULL;
+	double start = 0;
+	long input_bytes = 0;
+	int engine_count = (int)(sizeof(engines) / sizeof(engines[0]));
+	int found = 0; //boolean
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (0 == strcmp(argv[i], "--rows1"))
+		{
+			options.rows1 = atol(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--rows2"))
+		{
+			options.rows2 = atol(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--cols"))
+		{
+			options.cols = atoi(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--key-cols"))
+		{
+			options.key_cols = atoi(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--keys"))
+		{
+			options.keys = atol(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--zipf"))
+		{
+			options.zipf = atof(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--nulls"))
+		{
+			options.nulls = atof(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--width"))
+		{
+			options.width = atoi(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--quotes"))
+		{
+			options.quotes = atof(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--breaks"))
+		{
+			options.breaks = atof(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--stray-quotes"))
+		{
+			options.stray_quotes = atof(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--gzip"))
+		{
+			options.is_gzipped = 1;
+		}
+		else if (0 == strcmp(argv[i], "--seed"))
+		{
+			options.seed = strtoull(option_value(argc, argv, &i), NULL, 10);
+		}
+		else if (0 == strcmp(argv[i], "--repeat"))
+		{
+			options.repeat = atoi(option_value(argc, argv, &i));
+		}
+		else if (0 == strcmp(argv[i], "--threads"))
+		{
+			options.threads = option_value(argc, argv, &i);
+		}
+		else if (0 == strcmp(argv[i], "--memory-limit"))
+		{
+			options.memory_limit = option_value(argc, argv, &i);
+		}
+		else if (0 == strcmp(argv[i], "--engine"))
+		{
+			options.engine = option_value(argc, argv, &i);
+		}
+		else if (0 == strcmp(argv[i], "--program"))
+		{
+			options.program = option_value(argc, argv, &i);
+		}
+		else if (0 == strcmp(argv[i], "--dir"))
+		{
+			options.dir = option_value(argc, argv, &i);
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\nUsage: %s [--rows1 N] [--rows2 N] [--cols N] [--key-cols N] [--keys N] [--zipf S] "
+				"[--nulls P] [--width N] [--quotes P] [--breaks P] [--stray-quotes P] [--gzip] [--seed N] [--repeat N] [--threads N] [--memory-limit SIZE] [--engine NAME] [--program PATH] [--dir DIR]\n",
+				argv[i], argv[0]);
+			return 1;
+		}
+	}
+	if (0 > options.rows1 || 0 > options.rows2 || 1 > options.cols || 0 > options.key_cols || options.key_cols > options.cols
+		|| 1 > options.keys || 0 > options.zipf || 0 > options.width || 1 > options.repeat)
+	{
+		fprintf(stderr, "Invalid benchmark options.\n");
+		return 1;
+	}
+	for (int e = 0; e < engine_count; e++)
+	{
+		if (NULL == options.engine || 0 == strcmp(options.engine, engines[e].name))
+		{
+			found = 1;
+		}
+	}
+	if (!found)
+	{
+		fprintf(stderr, "Unknown engine %s\n", options.engine);
+		return 1;
+	}
+
+	//csv_merge is run from within the data directory, so its path has to be resolved first
+	if (NULL == realpath(options.program, program))
+	{
+		fprintf(stderr, "Unable to find %s.\n", options.program);
+		return 1;
+	}
+	options.program = program;
+	if (0 != mkdir(options.dir, 0755) && EEXIST != errno)
+	{
+		fprintf(stderr, "Unable to create %s.\n", options.dir);
+		return 1;
+	}
+	if (0 != chdir(options.dir))
+	{
+		fprintf(stderr, "Unable to enter %s.\n", options.dir);
+		return 1;
+	}
+
+	start = now_seconds();
+	cdf = new_zipf_table(options.keys, options.zipf);
+	input_bytes = generate_csv(FILENAME1, 1, options.rows1, cdf, &options);
+	input_bytes += generate_csv(FILENAME2, 2, options.rows2, cdf, &options);
+	free(cdf);
+	if (options.is_gzipped)
+	{
+		gzip_file(FILENAME1);
+		gzip_file(FILENAME2);
+		options.inputs[0] = FILENAME1 ".gz";
+		options.inputs[1] = FILENAME2 ".gz";
+	}
+
+	printf("{\"dataset\":{\"rows1\":%ld,\"rows2\":%ld,\"cols\":%d,\"key_cols\":%d,\"keys\":%ld,\"zipf\":%g,\"nulls\":%g,"
+		"\"width\":%d,\"quotes\":%g,\"breaks\":%g,\"stray_quotes\":%g,\"gzip\":%s,\"seed\":%llu,\"bytes\":%ld,"
+		"\"generate_seconds\":%.6f}}\n",
+		options.rows1, options.rows2, options.cols, options.key_cols, options.keys, options.zipf, options.nulls,
+		options.width, options.quotes, options.breaks, options.stray_quotes, options.is_gzipped ? "true" : "false",
+		(unsigned long long)options.seed, input_bytes, now_seconds() - start);
+
+	for (int e = 0; e < engine_count; e++)
+	{
+		if (NULL != options.engine && 0 != strcmp(options.engine, engines[e].name))
+		{
+			continue;
+		}
+		//an index needs key columbs to be built over, so without any it is only an error when it was asked for by name
+		if (engines[e].is_indexed && 0 == options.key_cols && NULL == options.engine)
+		{
+			continue;
+		}
+		if (engines[e].is_indexed && 0 == options.key_cols)
+		{
+			fprintf(stderr, "The %s engine needs --key-cols of at least 1.\n", engines[e].name);
+			return 1;
+		}
+		if (engines[e].is_indexed)
+		{
+			build_index(&options);
+		}
+		for (int run = 1; run <= options.repeat; run++)
+		{
+			run_engine(&engines[e], run, input_bytes, &options, first_rows);
+		}
+	}
+	return 0;
+}
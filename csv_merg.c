@@ -8,1035 +8,7625 @@
  *          storing the results in files named after the join that was preformed.
  */
 
+#define _GNU_SOURCE //for O_DIRECT and fallocate
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <assert.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/resource.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
-#define MAX_LINE 1000 //maximum size of any line in an input csv file
-#define MAX_COL 100  //maximum number of columbs an input csv can have
 #define null "NULL" // "NULL" is the expected entry for any null values in the csv
-#define EMPTY "csv_merge.c - empty csv_row identifier" //placeholder for empty rows in an input file
 
-//names of the two files to be processed, they must be in the same directory as this program.
+//bit flags used to select which joins join_csvs preformes
+#define JOIN_NATURAL 1
+#define JOIN_LEFT 2
+#define JOIN_FULL_OUTER 4
+
+//names of the output files each join creates unless another file is given
+#define NATURAL_OUTPUT "Natural_Join.txt"
+#define LEFT_OUTPUT "Left_Join.txt"
+#define FULL_OUTER_OUTPUT "Full_Outer_Join.txt"
+
+#define SORT_RUN_BYTES (64 * 1024 * 1024) //memory used to sort each run of a --sort-merge join
+#define MERGE_WAY 32 //maximum number of sorted runs merged at once
+#define READ_BLOCK_SIZE (16 * 1024 * 1024) //size of each block an unmappable input is read in, and of the memory a reader releases at once
+#define READ_AHEAD_BLOCK (1024 * 1024) //bytes of a compressed input or pipe read at a time, and decoded at a time from it
+#define READ_AHEAD_BYTES (16 * 1024 * 1024) //most decoded bytes of a compressed input or pipe kept ready ahead of the parser
+#define READ_AHEAD_RESERVE ((size_t)1 << 40) //address space a compressed input or pipe is decoded into, halved until it can be reserved
+#define WRITE_BUFFER_SIZE (1024 * 1024) //size of the buffer each output file's rows are gathered in before being written
+#define WRITE_ALIGNMENT 4096 //block size every write must be a multiple of when writing with --direct-io
+#define FALLOCATE_BYTES (64 * 1024 * 1024) //size of each reservation of disk space made ahead of writes with --direct-io
+#define ARENA_BLOCK_SIZE (1024 * 1024) //size of each block of memory arena_strdup packs strings into
+#define DICT_MAX_SIZE 1024 //most distinct values a columb can hold and still be dictionary encoded, must be a power of two
+#define DICT_BUCKETS (DICT_MAX_SIZE * 2) //size of each columb's dictionary hash table, must be a power of two
+#define MIN_CHUNK_BYTES (4 * 1024 * 1024) //smallest share of an input each thread parses, smaller inputs are parsed by fewer threads
+#define BATCH_VALUES 65536 //values in each batch of records handed from stage to stage of a pipelined --stream join
+#define RING_SIZE 64 //most batches a ring buffer between two stages of a pipelined join holds, must be a power of two
+#define PARTITION_ROWS 16384 //most csv2 rows a partition of a parallel join aims for, so each partition's hash table stays in cache
+#define MIN_PARTITION_BITS 8 //a parallel join always has at least 1 << MIN_PARTITION_BITS partitions to share between its threads
+#define MAX_PARTITION_BITS 16
+
+//how an input or output file is compressed, an input by the bytes it starts with and an output by the end of its name
+#define FORMAT_PLAIN 0
+#define FORMAT_GZIP 1
+#define FORMAT_ZSTD 2
+//where a scan for the ends of records is, following the rules split_csv_field splits by
+#define SCAN_FIELD_START 0 //at the start of a field, where a quote opens a quoted value
+#define SCAN_UNQUOTED 1    //within a field that was not opened by a quote, or past the closing quote of one that was
+#define SCAN_QUOTED 2      //within a quoted value
+#define SCAN_QUOTE 3       //just past a quote within a quoted value, which either closes it or is the first of a pair
+#define SCAN_STATE_COUNT 4
+#define GZIP_LEVEL 1 //compression level of outputs named .gz, the fastest so compressing keeps up with the join
+#define ZSTD_LEVEL 3 //compression level of outputs named .zst, zstd's own default
+
+//types a joined columb's values can be compared as, a columb of numbers or dates is compared by value so "007" matches "7"
+#define KEY_UNKNOWN 0 //a columb whose type has not been worked out yet
+#define KEY_TEXT 1
+#define KEY_NUMBER 2  //integers and decimals, held as a whole number of 10^-scale units
+#define KEY_DATE 3    //ISO dates, YYYY-MM-DD
+#define MAX_KEY_DIGITS 18 //most digits a KEY_NUMBER value can hold, including those after the decimal point, so it fits in 64 bits
+#define INVALID_WORD INT64_MIN //binary value of a null key, or of one that is not of its columb's type, never matches anything
+
+#define BLOOM_KEYS_PER_WORD 4 //indexed keys per 64 bit word of a Bloom filter, giving 16 bits per key
+#define BLOOM_WORD_SHIFT 24   //a key's hash above this bit picks its word of a Bloom filter, the bits below pick the 4 bits it sets
+
+#define STATE_MAGIC 0x31544e49564d5343ULL //"CSMVINT1", starts every file written by save_incremental_state
+#define STATE_CHECK_BYTES 4096 //bytes at the start and end of what an input held at the last --incremental run that are
+                               //hashed, so an input that was changed rather than appended to is noticed. --cache hashes
+                               //as many bytes of an input to notice it changed since its table image was written
+#define CACHE_MAGIC 0x31484341434d5343ULL //"CSMCACH1", starts every table image written by --cache
+#define CACHE_SUFFIX ".cache" //added to the name of an input to name the table image --cache keeps next to it
+#define INDEX_MAGIC 0x31584449434d5343ULL //"CSMCIDX1", starts the hash index that follows the table image in an --index file
+
+#define SPILL_PARTITION_BITS 6 //most bits of a key's hash a --memory-limit join splits an input on at once, giving up to 64 partitions
+#define SPILL_BUFFER_SIZE (64 * 1024) //size of the buffer of each partition file a --memory-limit join writes, small as there are many
+#define ROW_INDEX_BYTES 48 //memory the hash index and matched flag of a loaded row take, as estimated against --memory-limit
+
+#define FNV_OFFSET 14695981039346656037ULL //starting value of the 64 bit FNV-1a hash used on join keys
+#define FNV_PRIME 1099511628211ULL
+
+//phases of a run timed by --stats, in the order they happen
+#define PHASE_OPEN 0
+#define PHASE_LOAD 1
+#define PHASE_SORT 2
+#define PHASE_JOIN_COLS 3
+#define PHASE_INDEX 4
+#define PHASE_JOIN 5
+#define PHASE_OUTPUT 6
+#define PHASE_CLEANUP 7
+#define PHASE_COUNT 8
+
+//names of the two files processed unless others are given on the command line
 #define FILENAME1 "input1.txt"
 #define FILENAME2 "input2.txt"
 
-typedef struct CSV_COL
+typedef struct READ_AHEAD
+{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;    //signalled whenever ready, taken or is_done change
+	FILE* input;
+	int format;                //FORMAT_PLAIN, FORMAT_GZIP or FORMAT_ZSTD
+	char* data;                //reserved address space the file is decoded into, shared with the reader
+	size_t reserved;           //bytes of data
+	size_t ready;              //bytes at the start of data holding whole records, which the reader may take
+	size_t taken;              //bytes at the start of data the reader has taken
+	int is_done;               //boolean, nothing more will be made ready
+	int is_failed;             //boolean, the file could not be read or decoded, or was too large for data
+	int is_stopping;           //boolean, the reader is being closed
+	char* block;               //bytes read from the file and not yet decoded
+	size_t block_size;
+	size_t block_pos;
+	int is_ended;              //boolean, the last compressed stream or frame was complete
+#ifdef HAVE_ZLIB
+	z_stream gzip;
+#endif
+#ifdef HAVE_ZSTD
+	ZSTD_DStream* zstd;
+#endif
+} Read_ahead;
+
+typedef struct CSV_READER
+{
+	FILE* input;
+	char* name;          //name of the file, used in error messages
+	char* data;          //contents of the file, either mapped or read into memory, always ending in a line feed
+	size_t size;         //bytes in data
+	size_t pos;          //start of the next record within data
+	size_t record_start; //start of the most recently read record within data
+	size_t released;     //bytes at the start of data already handed back to the system
+	size_t map_size;     //bytes mapped for data, including the page after the file
+	int is_mapped;       //boolean, 0 if the file could not be mapped and was read into memory instead
+	int is_unclosed;     //boolean, set once a quoted value runs to the end of data without its closing quote
+	Read_ahead* ahead;   //decodes the file into data on a thread of its own, handing over whole records as they are needed.
+	                     //NULL if data already holds the whole file
+} Csv_reader;
+
+typedef struct CSV_WRITER
+{
+	int fd;           //-1 for a writer that only gathers rows in memory, growing its buffer as needed
+	char* buffer;     //rows waiting to be written, aligned to WRITE_ALIGNMENT so it can be written with O_DIRECT
+	size_t used;      //bytes of buffer in use
+	size_t capacity;  //bytes buffer can hold
+	int is_direct;    //boolean, 1 if fd was opened with O_DIRECT
+	off_t written;    //bytes written to fd so far
+	off_t allocated;  //bytes of fd reserved with fallocate
+	char* packed;     //compressed rows ready to be written, WRITE_BUFFER_SIZE bytes, NULL unless the output is compressed
+#ifdef HAVE_ZLIB
+	z_stream* gzip;   //compresses the rows of an output named .gz
+#endif
+#ifdef HAVE_ZSTD
+	ZSTD_CStream* zstd; //compresses the rows of an output named .zst
+#endif
+} Csv_writer;
+
+typedef struct ARENA_BLOCK
+{
+	struct ARENA_BLOCK* next; //block allocated before this one, NULL for the first block
+	size_t size;              //bytes available in data
+	size_t used;              //bytes of data already handed out
+	char data[];
+} Arena_block;
+
+typedef struct CSV_COLUMN
+{
+	char* data;            //the columb's strings packed end to end, each ending in '\0'
+	size_t data_size;
+	size_t data_capacity;
+	size_t* offsets;       //start of each row's value within data, only used once the columb is no longer dictionary encoded
+	int* codes;            //dictionary code of each row's value, NULL if the columb is not dictionary encoded
+	size_t* dict_offsets;  //start of each dictionary entry's value within data
+	uint64_t* dict_hashes; //hash of each dictionary entry's value
+	int dict_count;
+	int* dict_buckets;     //open addressing hash table from a value to its dictionary code, -1 marks an empty bucket
+	int key_type;          //type the columb's values are compared as when it is joined on, KEY_UNKNOWN until then
+	int key_scale;         //digits after the decimal point every KEY_NUMBER value is scaled by
+	int64_t* words;        //each row's value as a binary number or date, NULL unless key_type is KEY_NUMBER or KEY_DATE
+} Csv_column;
+
+typedef struct CSV_TABLE
+{
+	char** columbs;       //name of each columb
+	int col_count;
+	int row_count;
+	int row_capacity;     //rows every columb has room for
+	Csv_column* columns;  //the values of each columb stored contiguously
+	Arena_block* arena;   //block holding the columb names
+	char* image;          //table image mapped by --cache or --index that the names and values point into, NULL if the csv was parsed
+	size_t image_size;
+	struct INDEX_HEADER* stored_index; //hash index an --index file holds over the table, NULL for any other table
+} Csv_table;
+
+typedef struct JOIN_COLS
+{
+	int count;         //number of columbs shared by both csvs
+	char** names;      //name of each shared columb, in the order they appear in csv1
+	int* csv1_index;   //position of each shared columb within csv1
+	int* csv2_index;   //position of each shared columb within csv2
+	int* csv1_key_pos; //for each csv1 columb its position in names, or -1 if it is not shared
+	int* csv2_key_pos; //for each csv2 columb its position in names, or -1 if it is not shared
+	int* key_types;    //type each shared columb is compared as, KEY_TEXT unless set by find_key_types
+	int* key_scales;   //digits after the decimal point of each KEY_NUMBER shared columb
+	int* string_keys;  //position in names of each KEY_TEXT shared columb csv2 holds without a dictionary, whose strings are compared once their hashes match
+	int string_key_count;
+} Join_cols;
+
+typedef struct JOIN_INDEX
+{
+	int* buckets;                 //first entry of each bucket's chain, -1 if the bucket is empty
+	int* next;                    //next entry in the same chain as this entry, -1 at the end of a chain
+	uint64_t* hashes;             //key hash of each entry
+	int64_t* keys;                //normalized key of each entry as make_join_key gives it, one word per joined columb
+	int* rows;                    //csv2 row of each entry, NULL if entry l is csv2 row l
+	uint64_t mask;                //bucket count - 1, the bucket count is always a power of two
+	uint64_t* bloom;              //Bloom filter over the hashes of the entries' keys, NULL unless --bloom is set
+	uint64_t bloom_mask;          //word count of bloom - 1, always a power of two
+	int key_count;
+	int is_mapped;                //boolean, buckets, next, hashes, keys and bloom point into an --index file rather than being allocated
+	int** csv1_codes;             //for each joined columb dictionary encoded in both csvs, the csv2 code of each csv1 code (-1 if csv2 lacks the value)
+	int* csv1_null_codes;         //dictionary code of null in each joined columb of csv1, -1 if there is none
+	int* csv2_null_codes;         //dictionary code of null in each joined columb of csv2, -1 if there is none
+} Join_index;
+
+typedef struct JOIN_KEY
+{
+	uint64_t hash;
+	int has_null;          //boolean, a null key value never matches anything
+	int is_absent;         //boolean, a key value is missing from the dictionary of its csv2 columb so nothing can match
+	char** values;         //value of each joined columb
+	int64_t* words;        //normalized key, one word per joined columb: the binary value of a number or date, the csv2 dictionary
+	                       //code of a value whose csv2 columb is dictionary encoded, otherwise the hash of the value
+	long comparisons;      //index entries compared with the keys made in this struct, added to the run's stats when it is freed
+	long matches;          //matching csv2 rows found for those keys
+	long null_keys;        //keys holding a null, which are never looked up
+	long bloom_rejects;    //keys the index's Bloom filter showed could not match, so no chain was walked
+} Join_key;
+
+typedef struct JOIN_OUTPUTS
+{
+	Csv_writer* natural;    //output of each join, NULL if that join was not requested
+	Csv_writer* left;
+	Csv_writer* full_outer;
+	Join_cols* join_cols;
+	int csv1_col_count;
+	int csv2_col_count;
+	char** values;      //scratch space for the values of each output row
+	char** csv2_values; //scratch space for the values of a csv2 row
+} Join_outputs;
+
+typedef struct PARALLEL_JOIN
+{
+	Csv_table* csv1;
+	Csv_table* csv2;
+	Join_cols* join_cols;
+	Join_index* index;            //code maps of the joined columbs, shared by the index of every partition
+	Join_outputs* outputs;        //the output files, only written to by the worker whose partition is next in order
+	int join_types;
+	int thread_count;
+	int partition_bits;           //number of high bits of a key hash that choose its partition
+	int partition_count;
+	int* csv1_partitions;         //partition of each csv1 row
+	int* csv2_partitions;         //partition of each csv2 row
+	uint64_t* csv2_hashes;        //key hash of each csv2 row
+	int64_t* csv2_keys;           //normalized key of each csv2 row, one word per joined columb
+	char* csv2_has_null;          //boolean for each csv2 row, 1 if its key holds a null
+	int* csv1_counts;             //csv1 rows each thread found in each partition, then where its rows of each partition go in csv1_rows
+	int* csv2_counts;             //csv2 rows each thread found in each partition, then where its rows of each partition go in csv2_rows
+	int* csv1_start;              //position of each partition's first row in csv1_rows, with one more item holding the row count
+	int* csv2_start;              //position of each partition's first row in csv2_rows, with one more item holding the row count
+	int* csv1_rows;               //csv1 rows grouped by partition, in csv1 order within each partition
+	int* csv2_rows;               //csv2 rows grouped by partition, in csv2 order within each partition
+	uint64_t* csv2_row_hashes;    //key hash of each row in csv2_rows
+	char* csv2_row_has_null;      //null flag of each row in csv2_rows
+	atomic_char* csv2_matched;    //boolean for each csv2 row, 1 if any csv1 row matched it
+	int next_partition;           //next partition to be handed to a worker
+	int next_output;              //next partition to be written to the output files
+	pthread_mutex_t lock;         //guards next_partition and next_output
+	pthread_cond_t written;       //signalled each time a partition has been written to the output files
+} Parallel_join;
+
+typedef struct JOIN_WORKER
+{
+	Parallel_join* join;
+	int id;               //0 to thread_count - 1, chooses the rows the worker hashes and scatters
+} Join_worker;
+
+typedef struct SORTED_INPUT
+{
+	Csv_reader* runs[MERGE_WAY]; //sorted runs being merged, or the input itself if it was already sorted
+	int run_count;
+	char** values[MERGE_WAY];    //current record of each run split into its columbs
+	int has_record[MERGE_WAY];   //boolean, 0 once a run has no records left
+	int current;                 //run the last returned record came from, -1 before the first record
+	int* key_cols;
+	int key_count;
+	int col_count;
+} Sorted_input;
+
+typedef struct BATCH_RING
+{
+	void* items[RING_SIZE];
+	atomic_size_t head;   //number of items ever taken, only changed by the single consumer
+	atomic_size_t tail;   //number of items ever added, only changed by the single producer
+} Batch_ring;
+
+typedef struct ROW_BATCH
+{
+	char** values;        //values of each record, col_count per record, pointing into the reader's data
+	int row_count;
+	size_t end;           //position within the reader's data just after the batch's last record
+	Join_outputs rows;    //the batch's joined rows, gathered in memory until the writer reaches the batch
+} Row_batch;
+
+typedef struct STREAM_PIPELINE
+{
+	Csv_reader* input;        //the csv being streamed
+	int col_count;            //number of columbs of the streamed csv
+	Csv_table* csv2;
+	Join_cols* join_cols;
+	Join_index* index;
+	atomic_char* csv2_matched;
+	Join_outputs* outputs;    //the output files, only written to by the writer
+	int worker_count;
+	Batch_ring* to_workers;   //one ring per worker of batches waiting to be joined
+	Batch_ring* to_writer;    //one ring per worker of joined batches waiting to be written
+	Batch_ring free_batches;  //written batches handed back to the reader to be filled again
+} Stream_pipeline;
+
+typedef struct STREAM_WORKER
+{
+	Stream_pipeline* pipeline;
+	int id;               //the worker's ring in to_workers and to_writer
+} Stream_worker;
+
+typedef struct CHAIN_LEVEL
+{
+	Csv_table* csv2;              //table joined at this level
+	Join_cols join_cols;          //columbs shared by the rows reaching this level and csv2
+	Join_index* index;            //index over the rows of csv2
+	Join_key key;                 //key of the row being joined at this level
+	atomic_char* csv2_matched;    //boolean for each csv2 row, 1 if any row reaching this level matched it. NULL unless full outer
+	int csv1_col_count;           //number of columbs of the rows reaching this level
+	char** names;                 //name of each columb of the rows leaving this level
+	int col_count;                //number of columbs of the rows leaving this level
+	char** values;                //scratch space for the row leaving this level
+	char** csv2_values;           //scratch space for a csv2 row
+} Chain_level;
+
+typedef struct JOIN_CHAIN
+{
+	int join_type;        //JOIN_NATURAL, JOIN_LEFT or JOIN_FULL_OUTER, the join preformed at every level
+	Csv_writer* output;   //file the rows leaving the last level are written to
+	Chain_level* levels;  //one level for each table joined onto the streamed csv, in order
+	int level_count;
+} Join_chain;
+
+typedef struct CSV_CHUNK
+{
+	Csv_reader reader;     //the chunk's share of the input, pointing into the input's data and never closed
+	char** columbs;        //names of the input's columbs
+	int col_count;
+	int end_states[SCAN_STATE_COUNT]; //state of the scan at the end of the chunk for each state it may start in
+	Csv_table* table;      //rows parsed from the chunk
+} Csv_chunk;
+
+typedef struct CSV_LOAD
+{
+	Csv_reader* input;     //reader to load, closed once it is loaded
+	int thread_count;      //number of threads to parse it with
+	Csv_table* table;      //the loaded table
+} Csv_load;
+
+typedef struct CACHE_HEADER
+{
+	uint64_t magic;
+	int64_t source_size;   //bytes of the csv the image was made from
+	int64_t source_mtime;  //modification time of the csv in nanoseconds
+	uint64_t head_hash;    //hash of the first STATE_CHECK_BYTES of the csv
+	uint64_t tail_hash;    //hash of the last STATE_CHECK_BYTES of the csv
+	int64_t image_size;    //bytes of the whole image, so an image that was not completely written is noticed
+	int col_count;         //followed in the image by a Cache_column for each columb, then the columb names
+	int row_count;
+} Cache_header;
+
+typedef struct CACHE_COLUMN
+{
+	int64_t data_pos;         //position within the image of the columb's packed strings
+	int64_t data_size;
+	int64_t offsets_pos;      //position of each row's offset into the strings, -1 if the columb is dictionary encoded
+	int64_t codes_pos;        //position of each row's dictionary code, -1 if the columb is not dictionary encoded
+	int64_t dict_offsets_pos; //positions of the columb's dictionary, -1 if it is not dictionary encoded
+	int64_t dict_hashes_pos;
+	int64_t dict_buckets_pos;
+	int64_t dict_count;
+} Cache_column;
+
+typedef struct INDEX_HEADER
+{
+	uint64_t magic;
+	int64_t file_size;    //bytes of the whole --index file, the table image and the index after it
+	int64_t bucket_count; //buckets of the index's hash table, a power of two
+	int64_t bloom_count;  //64 bit words of its Bloom filter, a power of two
+	int64_t cols_pos;     //positions within the file of the position, type and scale of each indexed columb
+	int64_t types_pos;
+	int64_t scales_pos;
+	int64_t buckets_pos;  //positions within the file of the arrays of the Join_index
+	int64_t next_pos;
+	int64_t hashes_pos;
+	int64_t keys_pos;
+	int64_t bloom_pos;
+	int key_count;        //columbs the index is over
+	int row_count;
+} Index_header;
+
+typedef struct INCREMENTAL_ROW
+{
+	uint64_t hash;    //hash of the row's key as given by hash_record_key
+	int64_t offset;   //start of the row's record within its input
+	int64_t left_pos; //position of the row's null padded line within the left output, -1 if it has none there
+	int64_t full_pos; //position of the row's null padded line within the full outer output, -1 if it has none there
+	int pad_size;     //bytes in the padded line, counting the line feed before it
+	int has_null;     //boolean, the key holds a null or a value not of its columb's type so it matches nothing
+} Incremental_row;
+
+typedef struct INCREMENTAL_HEADER
+{
+	uint64_t magic;
+	int join_types;          //joins the outputs hold
+	int key_count;           //columbs shared by both inputs, followed in the file by the type, scale and seen flag of each
+	int64_t input_sizes[2];  //bytes of each input joined so far
+	uint64_t head_hashes[2]; //hash of the first STATE_CHECK_BYTES of those bytes
+	uint64_t tail_hashes[2]; //hash of the last STATE_CHECK_BYTES of those bytes
+	int64_t row_counts[2];   //rows of each input joined so far, followed in the file by an Incremental_row for each
+	int64_t output_sizes[3]; //bytes of the natural, left and full outer outputs when they were last written
+} Incremental_header;
+
+typedef struct OUTPUT_CUT
+{
+	int64_t pos;  //position of a line to cut from an output
+	int64_t size; //bytes in the line
+} Output_cut;
+
+typedef struct INCREMENTAL_JOIN
+{
+	Incremental_header header;
+	int* key_types;               //type, scale and seen flag of each shared columb, as the header's key_count items
+	int* key_scales;
+	int* key_seen;                //boolean, csv2 held a value other than null in the columb
+	Incremental_row* rows[2];     //every row of each input, those joined by earlier runs first
+	int64_t row_capacity[2];
+	int64_t old_rows[2];          //rows of each input joined by earlier runs
+	size_t new_start[2];          //position of each input's first record not yet joined
+	uint64_t new_head_hashes[2];  //head and tail hashes of each input as it is now, taken before any of it is parsed
+	uint64_t new_tail_hashes[2];
+	int64_t new_sizes[2];
+	Csv_reader* inputs[2];
+	char** names[2];              //columb names of each input
+	int col_counts[2];
+	char*** csv2_records;         //values of each csv2 row once read, NULL until then
+	char* csv2_matched;           //boolean for each csv2 row added this run, 1 once a csv1 row matches it
+	Join_cols join_cols;
+	Join_outputs outputs;
+	Output_cut* cuts[2];          //null padded lines to cut from the left and full outer outputs
+	int cut_counts[2];
+	int cut_capacity[2];
+	long comparisons;
+	long matches;
+} Incremental_join;
+
+typedef struct SPILL_PARTITION
+{
+	FILE* files[2];          //temporary file of the csv1 and of the csv2 rows whose keys hash to the partition, each starting
+	                         //with the csv's columb names
+	Csv_writer* writers[2];  //writes to a duplicate of each file's descriptor while the partition is filled, NULL after
+	long rows[2];            //rows in each file
+	size_t bytes[2];         //bytes those rows took in the csv they were read from
+} Spill_partition;
+
+typedef struct GRACE_JOIN
+{
+	char** names[2];         //columb names of each csv
+	int col_counts[2];
+	char** values;           //scratch space for a record of either csv
+	Join_cols join_cols;
+	Join_outputs outputs;
+	int thread_count;        //most threads to load and join each partition with
+} Grace_join;
+
+typedef struct KEY_PROFILE
+{
+	int count;            //non null values seen
+	int is_number;        //boolean, every value seen is a number
+	int is_date;          //boolean, every value seen is an ISO date
+	int int_digits;       //most significant digits before the decimal point of any number seen
+	int frac_digits;      //most digits after the decimal point of any number seen, not counting trailing zeros
+} Key_profile;
+
+typedef struct RUN_STATS
 {
-	char* value;
-} Csv_col;
+	atomic_long rows_read;          //records read from both inputs
+	atomic_long key_comparisons;    //csv2 keys compared against a csv1 key
+	atomic_long matches;            //pairs of matching rows found
+	atomic_long null_keys;          //rows of either csv whose key held a null and so were never matched
+	atomic_long bloom_rejects;      //csv1 keys turned away by a Bloom filter without probing the hash index
+	atomic_long bytes_written;      //bytes written to the output files
+	atomic_long write_nanoseconds;  //time spent writing the output files, summed over every thread
+	atomic_long allocations;        //allocations made growing tables, arenas and row buffers
+	double phase_seconds[PHASE_COUNT];
+	int phase;                      //phase the main thread is in
+	double phase_start;             //time the current phase started
+	double start;                   //time the run started
+} Run_stats;
+
+//context for compare_run_records since qsort has no way to pass it through
+char** sort_cells = NULL;
+int sort_col_count = 0;
+int* sort_key_cols = NULL;
+int sort_key_count = 0;
+int64_t* sort_words = NULL; //each record's key values parsed by their sort_key_types, NULL when every columb is text
+
+//types of the joined columbs compare_keys compares, set for the one --sort-merge or --incremental join a run preformes.
+//NULL compares every columb as text
+int* sort_key_types = NULL;
+int* sort_key_scales = NULL;
+
+//types given with --key-type for columbs of a given name, overriding the type worked out from their values
+char** key_type_names = NULL;
+int* key_type_types = NULL;
+int* key_type_scales = NULL;   //digits after the decimal point, -1 to work them out from the values
+int key_type_count = 0;
+
+//set by --direct-io, output files are written around the page cache
+int direct_io = 0; //boolean
+
+//set by --bloom, every hash index gets a Bloom filter so keys with no match are turned away before walking a chain
+int use_bloom = 0; //boolean
 
-typedef struct CSV_ROW
+//set by --cache, every loaded input is read from the table image kept next to it when the image is still current
+int use_cache = 0; //boolean
+
+//set by --index, the file written by --build-index that stands in for the second input
+char* index_file = NULL;
+
+//set by --memory-limit, bytes the loaded second input and its hash index may take before both inputs are split into
+//partitions on disk and joined a partition at a time. 0 for no limit
+size_t memory_limit = 0;
+
+//files the output of each join is written to, set by --natural, --left and --full-outer. "-" writes to stdout
+char* natural_output = NATURAL_OUTPUT;
+char* left_output = LEFT_OUTPUT;
+char* full_outer_output = FULL_OUTER_OUTPUT;
+
+//set by --stats, counters and timers are only kept when it is set and reported to stderr as JSON once the run is done
+int show_stats = 0; //boolean
+Run_stats stats;
+char* phase_names[PHASE_COUNT] = { "open", "load", "sort", "join_cols", "index", "join", "output", "cleanup" };
+
+/**
+ * PURPOSE: reads a clock for timing the phases of a run
+ * OUTPUT PARAMETERS:
+ *    returns the time in seconds since some fixed point
+ */
+double now_seconds(void)
 {
-	Csv_col* col[MAX_COL];
-} Csv_row;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
 
 /**
- * PURPOSE: uses assertions to ensure the values variable contains appropriate data
+ * PURPOSE: adds to one of the run's counters when --stats is set, safe to call from any thread
  * INPUT PARAMETERS:
- *    values: values variable to be validated
- *    values_size: number of items in the values array
+ *    counter: the counter within stats
+ *    amount: amount to add
  */
-void validate_values(char values[MAX_COL][MAX_LINE], int values_size)
+void count_stat(atomic_long* counter, long amount)
 {
-	for (int i = 0; i < values_size; i++)
+	if (show_stats)
 	{
-		assert(NULL != values[i]);
+		atomic_fetch_add_explicit(counter, amount, memory_order_relaxed);
 	}
 }
 
+/**
+ * PURPOSE: ends the phase the run is in and starts another when --stats is set, only called from the main thread
+ * INPUT PARAMETERS:
+ *    phase: the phase starting, PHASE_COUNT to only end the current phase
+ */
+void mark_phase(int phase)
+{
+	double now = 0;
+
+	if (show_stats)
+	{
+		now = now_seconds();
+		if (PHASE_COUNT > stats.phase)
+		{
+			stats.phase_seconds[stats.phase] += now - stats.phase_start;
+		}
+		stats.phase = phase;
+		stats.phase_start = now;
+	}
+}
 
 /**
- * PURPOSE: counts the number of lines in a file
+ * PURPOSE: prints the counters and phase times of the run to stderr as a single JSON object
  * INPUT PARAMETERS:
- *    filename: contains the name of the file that must be counted
- * OUTPUT PARAMETERS:
- *    returns an int representing the number of lines contained within the file
+ *    mode: name of the join algorithm used
+ *    thread_count: number of threads the run was allowed
  */
-int count_lines(char* filename)
+void print_stats(char* mode, int thread_count)
 {
-	FILE* input;
-	char line[MAX_LINE] = "\0";
-	int line_count = 0;
+	struct rusage usage;
 
-	input = fopen(filename, "r");
+	mark_phase(PHASE_COUNT);
+	getrusage(RUSAGE_SELF, &usage);
 
-	while (NULL != fgets(line, MAX_LINE, input))
+	fprintf(stderr, "{\"mode\":\"%s\",\"threads\":%d,\"seconds\":%.6f,\"phases\":{", mode, thread_count, now_seconds() - stats.start);
+	for (int i = 0; i < PHASE_COUNT; i++)
 	{
-		line_count++;
+		fprintf(stderr, "%s\"%s\":%.6f", (0 < i) ? "," : "", phase_names[i], stats.phase_seconds[i]);
 	}
-
-	fclose(input);
-	return line_count;
+	fprintf(stderr, "},\"write_seconds\":%.6f,\"rows_read\":%ld,\"key_comparisons\":%ld,\"matches\":%ld,\"null_keys\":%ld,"
+		"\"bloom_rejects\":%ld,\"bytes_written\":%ld,\"allocations\":%ld,\"peak_rss_kb\":%ld}\n",
+		(double)atomic_load(&stats.write_nanoseconds) / 1e9, atomic_load(&stats.rows_read), atomic_load(&stats.key_comparisons),
+		atomic_load(&stats.matches), atomic_load(&stats.null_keys), atomic_load(&stats.bloom_rejects),
+		atomic_load(&stats.bytes_written), atomic_load(&stats.allocations), usage.ru_maxrss);
 }
 
 /**
- * PURPOSE: counts the number of columbs in the first line of a csv
+ * PURPOSE: finds the end of an unquoted field, comparing a whole block of bytes at once where the cpu supports it.
+ *          blocks are only loaded while they lie before end, so bytes past it that another thread may be splitting are never read
  * INPUT PARAMETERS:
- *    filename: contains the name of the file that must be counted
- *    SEPERATORS: string of seperators to break up the line on
+ *    field: start of the field
+ *    end: end of the data holding the field, which must end in a line feed
  * OUTPUT PARAMETERS:
- *    returns an int representing the number of columbs contained within the file
+ *    returns a pointer to the first comma or line feed at or after field
  */
-int count_columbs(char* filename, char* SEPERATORS)
+char* find_field_end(char* field, char* end)
 {
-	FILE* input;
-	char line[MAX_LINE] = "\0";
-	int col_count = 0;
-	char* token;
+#if defined(__AVX2__)
+	const __m256i commas = _mm256_set1_epi8(',');
+	const __m256i line_feeds = _mm256_set1_epi8('\n');
+	__m256i block;
+	unsigned int mask = 0;
 
-	input = fopen(filename, "r");
+	while (field + sizeof(__m256i) <= end)
+	{
+		block = _mm256_loadu_si256((const __m256i*)field);
+		mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(block, commas), _mm256_cmpeq_epi8(block, line_feeds)));
+		if (0 != mask)
+		{
+			return field + __builtin_ctz(mask);
+		}
+		field += sizeof(__m256i);
+	}
+#elif defined(__SSE2__)
+	const __m128i commas = _mm_set1_epi8(',');
+	const __m128i line_feeds = _mm_set1_epi8('\n');
+	__m128i block;
+	unsigned int mask = 0;
 
-	if (NULL != fgets(line, MAX_LINE, input))
+	while (field + sizeof(__m128i) <= end)
 	{
-		token = strtok(line, SEPERATORS);
-		while (NULL != token)
+		block = _mm_loadu_si128((const __m128i*)field);
+		mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, commas), _mm_cmpeq_epi8(block, line_feeds)));
+		if (0 != mask)
 		{
-			col_count++;
-			token = strtok(NULL, SEPERATORS);
+			return field + __builtin_ctz(mask);
 		}
+		field += sizeof(__m128i);
 	}
-	else
+#endif
+	//the last few bytes, or every byte without vector instructions, are checked one at a time
+	while (',' != *field && '\n' != *field)
 	{
-		col_count = -1;
+		field++;
 	}
-
-	fclose(input);
-	return col_count;
+	return field;
 }
 
-
 /**
- * PURPOSE: creates a new Csv_col struct dynamically allocating memeory for it and containing the input information
+ * PURPOSE: removes the quotes around a quoted field in place, turning each pair of quotes inside it into a single quote.
+ *          anything between the closing quote and the end of the field is kept as part of the value
  * INPUT PARAMETERS:
- *    col: the name of the columb this item represents
+ *    field: start of the field, pointing at its opening quote
+ *    end: end of the data holding the field, which must end in a line feed
+ *    is_unclosed: set to 1 if the closing quote is missing, otherwise left alone
  * OUTPUT PARAMETERS:
- *    returns a Csv_col struct containing the input information
+ *    returns a pointer to the comma or line feed ending the field. the value is left starting at field and ending in '\0',
+ *    or ending at the line feed closing the data if the closing quote is missing
  */
-Csv_col* new_csv_col(char* col)
+char* unquote_field(char* field, char* end, int* is_unclosed)
 {
-	Csv_col* new_csv_col = NULL;
-	new_csv_col = malloc(sizeof(Csv_col));
+	char* read = field + 1;
+	char* write = field;
+	char* quote = NULL;
+	char* field_end = NULL;
+	size_t length = 0;
 
-	if (NULL != new_csv_col)
+	for (;;)
 	{
-		new_csv_col->value = malloc(strlen(col) + 1);
-		if (NULL != new_csv_col->value)
+		quote = memchr(read, '"', (size_t)(end - read));
+		if (NULL == quote)
 		{
-			strcpy(new_csv_col->value, col);
+			//an unclosed quote runs to the end of the data, which loses only the final line feed
+			length = (size_t)(end - 1 - read);
+			memmove(write, read, length);
+			write[length] = '\0';
+			*is_unclosed = 1;
+			return end - 1;
 		}
-		else
+
+		length = (size_t)(quote - read);
+		memmove(write, read, length);
+		write += length;
+		if ('"' != quote[1])
 		{
-			free(new_csv_col);
-			new_csv_col = NULL;
+			break;
 		}
+		*write = '"';
+		write++;
+		read = quote + 2;
 	}
-	return new_csv_col;
+
+	read = quote + 1;
+	field_end = find_field_end(read, end);
+	length = (size_t)(field_end - read);
+	if ('\n' == *field_end && 0 < length && '\r' == read[length - 1])
+	{
+		length--;
+	}
+	memmove(write, read, length);
+	write[length] = '\0';
+	return field_end;
 }
 
 /**
- * PURPOSE: creates a new Csv_row struct dynamically allocating memeory for it and containing the input information
+ * PURPOSE: moves a scan for the ends of records on by one byte. a quote only opens a quoted value at the start of a field,
+ *          as in split_csv_field, so a stray quote within an unquoted value does not throw the scan out of step
  * INPUT PARAMETERS:
- *    values: an array of strings to used as each columbs value
- *    value_count: The number of items contained in values
+ *    state: one of the SCAN_ states, the state before c
+ *    c: the byte
  * OUTPUT PARAMETERS:
- *    returns a Csv_row struct containing the input information
+ *    returns the state after c, SCAN_FIELD_START after a line feed that ends a record
  */
-Csv_row* new_csv_row(char values[MAX_COL][MAX_LINE], int value_count)
+int next_scan_state(int state, char c)
 {
-	Csv_row* new_csv_row = NULL;
-	new_csv_row = malloc(sizeof(Csv_row));
+	if (SCAN_QUOTED == state)
+	{
+		return ('"' == c) ? SCAN_QUOTE : SCAN_QUOTED;
+	}
+	if ((SCAN_FIELD_START == state || SCAN_QUOTE == state) && '"' == c)
+	{
+		//a quote opening a field, or the second of a pair standing for one quote within a quoted value
+		return SCAN_QUOTED;
+	}
+	return (',' == c || '\n' == c) ? SCAN_FIELD_START : SCAN_UNQUOTED;
+}
 
-	if (NULL != new_csv_row)
+/**
+ * PURPOSE: ends the data of a Csv_reader with a line feed if it does not already, so every record is ended by one.
+ *          there is always room for it since a byte is kept spare after the data
+ * INPUT PARAMETERS:
+ *    reader: the reader whose data is ended
+ */
+void end_csv_data(Csv_reader* reader)
+{
+	if (0 < reader->size && '\n' != reader->data[reader->size - 1])
 	{
-		for (int i = 0; i < value_count; i++)
-		{
-			new_csv_row->col[i] = new_csv_col(values[i]);
-		}
+		reader->data[reader->size] = '\n';
+		reader->size++;
 	}
-	return new_csv_row;
 }
 
 /**
- * PURPOSE: prints a columb out to the console for testing purposes
+ * PURPOSE: maps the file of a Csv_reader into memory followed by a page of zeroed memory, so the last line can always
+ *          be ended
  * INPUT PARAMETERS:
- *    col: columb to be printed
+ *    reader: the reader whose file is mapped
  * OUTPUT PARAMETERS:
- *    prints value contained in columb to console
+ *    returns 1 if the file was mapped or 0 if it is not a regular file or could not be mapped
  */
-void print_csv_col(Csv_col* col)
+int map_csv_reader(Csv_reader* reader)
 {
-	printf("[%s]", col->value);
-	fflush(stdout);
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	struct stat info;
+	char* region = NULL;
+
+	if (0 != fstat(fileno(reader->input), &info) || !S_ISREG(info.st_mode) || 0 == info.st_size)
+	{
+		return 0;
+	}
+
+	//reserves room for the file and the page after it, then maps the file over the start of that room
+	region = mmap(NULL, (size_t)info.st_size + page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED == region)
+	{
+		return 0;
+	}
+	if (MAP_FAILED == mmap(region, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fileno(reader->input), 0))
+	{
+		munmap(region, (size_t)info.st_size + page_size);
+		return 0;
+	}
+
+	reader->data = region;
+	reader->size = (size_t)info.st_size;
+	reader->map_size = (size_t)info.st_size + page_size;
+	reader->is_mapped = 1;
+	madvise(reader->data, reader->size, MADV_SEQUENTIAL);
+	end_csv_data(reader);
+	return 1;
 }
 
 /**
- * PURPOSE: prints a csv row out to the console for testing purposes
+ * PURPOSE: works out how a file is compressed from the bytes it starts with
  * INPUT PARAMETERS:
- *    row: row to be printed
- *    num_cols: number of columbs the row encompases
+ *    data: the first bytes of the file
+ *    size: number of bytes in data
  * OUTPUT PARAMETERS:
- *    prints values contained in row to console
+ *    returns FORMAT_GZIP or FORMAT_ZSTD if data starts with the magic number of either, otherwise FORMAT_PLAIN
  */
-void print_csv_row(Csv_row* row, int num_cols)
+int compression_of_bytes(const char* data, size_t size)
 {
-	for (int i = 0; i < num_cols; i++)
+	if (2 <= size && 0 == memcmp(data, "\x1f\x8b", 2))
 	{
-		print_csv_col(row->col[i]);
-		printf(", ");
-		fflush(stdout);
+		return FORMAT_GZIP;
 	}
-	printf("\n");
-	fflush(stdout);
+	return (4 <= size && 0 == memcmp(data, "\x28\xb5\x2f\xfd", 4)) ? FORMAT_ZSTD : FORMAT_PLAIN;
 }
 
 /**
- * PURPOSE: preformes a natural join on the two csvs represented by inputs and prints the resulting table as a csv named Natural_Join.txt
+ * PURPOSE: works out how an output file is to be compressed from its name
  * INPUT PARAMETERS:
- *    csv1_columbs: an array of Csv_col structs holding the names of the columbs in csv1
- *    csv1_rows: an array of Csv_row structs holding all rows of csv1
- *    csv1_col_count: number of columbs csv1 containes
- *    csv1_row_count: number of rows csv1 containes
- *    csv2_columbs: an array of Csv_col structs holding the names of the columbs in csv2
- *    csv2_rows: an array of Csv_row structs holding all rows of csv2
- *    csv2_col_count: number of columbs csv2 containes
- *    csv2_row_count: number of rows csv2 containes
+ *    filename: name of the file
  * OUTPUT PARAMETERS:
- *    creates a new file named Natural_Join.txt and puts the result of a natural joining the input csv values in it
+ *    returns FORMAT_GZIP for a name ending in .gz, FORMAT_ZSTD for one ending in .zst, otherwise FORMAT_PLAIN
  */
-void natural_join(Csv_col* csv1_columbs, Csv_row* csv1_rows, int csv1_col_count, int csv1_row_count, Csv_col* csv2_columbs, Csv_row* csv2_rows, int csv2_col_count, int csv2_row_count)
+int compression_of_name(const char* filename)
 {
-	const char* output_name = "Natural_Join.txt";
-	int joined_row_count = 0;
-	int joined_col_count = 0;
-	char joined_cols[MAX_COL][MAX_LINE];
-	Csv_row* joined_rows = calloc(csv1_row_count + csv2_row_count, sizeof(Csv_row));
-	char values[MAX_COL][MAX_LINE];
-	int values_size = 0;
-	char joined_values[MAX_COL][MAX_LINE];
-	int joined_values_size = 0;
-	int is_joined_col = 0;
-	FILE* output;
-	int equivilent_counter = 0;
+	size_t length = strlen(filename);
 
-
-	for (int i = 0; i < csv1_col_count; i++)
+	if (3 <= length && 0 == strcmp(filename + length - 3, ".gz"))
 	{
-		for (int j = 0; j < csv2_col_count; j++)
-		{
-			if (0 == strcmp(csv1_columbs[i].value, csv2_columbs[j].value) && 0 != strcmp(csv1_columbs[i].value, null))
-			{
-				strcpy(joined_cols[joined_col_count], csv1_columbs[i].value);
-				joined_col_count++;
-			}
-		}
+		return FORMAT_GZIP;
 	}
+	return (4 <= length && 0 == strcmp(filename + length - 4, ".zst")) ? FORMAT_ZSTD : FORMAT_PLAIN;
+}
 
-	for (int k = 0; k < csv1_row_count; k++)
+/**
+ * PURPOSE: reads the next block of a read ahead's file once every byte of the last one has been decoded
+ * INPUT PARAMETERS:
+ *    ahead: the read ahead
+ * OUTPUT PARAMETERS:
+ *    returns 1 if there are bytes left to decode, 0 at the end of the file, or -1 if the file could not be read
+ */
+int fill_read_ahead_block(Read_ahead* ahead)
+{
+	if (ahead->block_pos == ahead->block_size)
 	{
-		for (int l = 0; l < csv2_row_count;l++)
-		{
-			for (int i2 = 0; i2 < joined_col_count; i2++)
-			{
-				for (int j2 = 0; j2 < csv1_col_count; j2++)
-				{
-					if (0 == strcmp(csv1_columbs[j2].value, joined_cols[i2]))
-					{
-						for (int k2 = 0; k2 < csv2_col_count; k2++)
-						{
-							if (0 == strcmp(csv2_columbs[k2].value, joined_cols[i2]) && 0 != strcmp(csv2_columbs[k2].value, null))
-							{
-								if (0 == strcmp(csv1_rows[k].col[j2]->value, csv2_rows[l].col[k2]->value) && 0 != strcmp(csv1_rows[k].col[j2]->value, null))
-								{
-									equivilent_counter++;
-								}
-							}
-						}
-					}
-				}
-			}
-			if (equivilent_counter == joined_col_count)
-			{
-				for (int m = 0; m < csv1_col_count; m++)
-				{
-					is_joined_col = 0;
-					for (int n = 0; n < joined_col_count; n++)
-					{
-
-						if (0 == strcmp(csv1_columbs[m].value, joined_cols[n]) && 0 != strcmp(csv1_columbs[m].value, null))
-						{
-							is_joined_col = 1;
-							strcpy(joined_values[joined_values_size], csv1_rows[k].col[m]->value);
-							joined_values_size++;
-						}
-					}
-					if (!is_joined_col) {
-						assert(NULL != csv1_rows[k].col[m]->value);
-						strcpy(values[values_size], csv1_rows[k].col[m]->value);
-						assert(NULL != values[values_size]);
-						values_size++;
-					}
-				}
-
-				is_joined_col = 0;
-				for (int m = 0; m < csv2_col_count; m++)
-				{
-					is_joined_col = 0;
-					for (int n = 0; n < joined_col_count; n++)
-					{
-						if (0 == strcmp(csv2_columbs[m].value, joined_cols[n]) && 0 != strcmp(csv2_columbs[m].value, null))
-						{
-							is_joined_col = 1;
-						}
-					}
-					if (!is_joined_col)
-					{
-						assert(NULL != csv2_rows[l].col[m]->value);
-						strcpy(values[values_size], csv2_rows[l].col[m]->value);
-						assert(NULL != values[values_size]);
-						values_size++;
-					}
-				}
-
-				for (int m = 0; m < joined_values_size; m++)
-				{
-					assert(NULL != joined_values[m]);
-					strcpy(values[values_size], joined_values[m]);
-					assert(NULL != values[values_size]);
-					values_size++;
-				}
-				joined_values_size = 0;
+		ahead->block_size = fread(ahead->block, 1, READ_AHEAD_BLOCK, ahead->input);
+		ahead->block_pos = 0;
+	}
+	return ferror(ahead->input) ? -1 : (0 < ahead->block_size);
+}
 
-			}
-			equivilent_counter = 0;
+/**
+ * PURPOSE: decodes the next part of a read ahead's file
+ * INPUT PARAMETERS:
+ *    ahead: the read ahead
+ *    out: where to put the decoded bytes
+ *    room: most bytes to decode, no more than READ_AHEAD_BLOCK
+ * OUTPUT PARAMETERS:
+ *    returns the number of bytes decoded, 0 once the whole file is decoded, or -1 if the file could not be read or its
+ *    compressed data is corrupt or cut short
+ */
+long decode_read_ahead(Read_ahead* ahead, char* out, size_t room)
+{
+	size_t size = 0;
+	int is_filled = 0;
+#ifdef HAVE_ZLIB
+	int result = Z_OK;
+#endif
+#ifdef HAVE_ZSTD
+	ZSTD_inBuffer zstd_in;
+	ZSTD_outBuffer zstd_out = { out, room, 0 };
+	size_t remaining = 0;
+#endif
 
-			validate_values(values, values_size);
-			if (0 < values_size)
-			{
-				joined_rows[joined_row_count] = *new_csv_row(values, csv1_col_count + csv2_col_count - joined_col_count);
-				joined_row_count++;
-			}
-			values_size = 0;
+	if (FORMAT_PLAIN == ahead->format)
+	{
+		is_filled = fill_read_ahead_block(ahead);
+		size = (0 < is_filled && ahead->block_size - ahead->block_pos < room) ? ahead->block_size - ahead->block_pos : room;
+		if (0 < is_filled)
+		{
+			memcpy(out, ahead->block + ahead->block_pos, size);
+			ahead->block_pos += size;
 		}
+		return (0 < is_filled) ? (long)size : is_filled;
 	}
-	output = fopen(output_name, "w");
 
-	for (int i = 0; i < csv1_col_count; i++)
+#ifdef HAVE_ZLIB
+	//a file of several gzip members, as concatenated gzip files are, decodes to the members one after another
+	ahead->gzip.next_out = (Bytef*)out;
+	ahead->gzip.avail_out = (uInt)room;
+	while (FORMAT_GZIP == ahead->format && room == ahead->gzip.avail_out)
 	{
-		is_joined_col = 0;
-		for (int n = 0; n < joined_col_count; n++)
+		is_filled = fill_read_ahead_block(ahead);
+		if (0 >= is_filled)
 		{
-			if (0 == strcmp(csv1_columbs[i].value, joined_cols[n]))
-			{
-				is_joined_col = 1;
-			}
+			return (0 == is_filled && ahead->is_ended) ? 0 : -1;
 		}
-		if (!is_joined_col) {
-			fprintf(output, "%s", csv1_columbs[i].value);
+		if (ahead->is_ended && Z_OK != inflateReset(&ahead->gzip))
+		{
+			return -1;
 		}
-		if (((i < csv1_col_count - 1) || (0 < csv2_col_count - joined_col_count)) && (!is_joined_col))
+		ahead->gzip.next_in = (Bytef*)ahead->block + ahead->block_pos;
+		ahead->gzip.avail_in = (uInt)(ahead->block_size - ahead->block_pos);
+		result = inflate(&ahead->gzip, Z_NO_FLUSH);
+		ahead->block_pos = ahead->block_size - ahead->gzip.avail_in;
+		ahead->is_ended = (Z_STREAM_END == result);
+		if (Z_OK != result && Z_STREAM_END != result && Z_BUF_ERROR != result)
 		{
-			fprintf(output, ",");
+			return -1;
 		}
 	}
-
-	for (int j = 0; j < csv2_col_count; j++)
+	if (FORMAT_GZIP == ahead->format)
+	{
+		return (long)(room - ahead->gzip.avail_out);
+	}
+#endif
+#ifdef HAVE_ZSTD
+	//a file of several zstd frames decodes to the frames one after another
+	while (FORMAT_ZSTD == ahead->format && 0 == zstd_out.pos)
 	{
-		is_joined_col = 0;
-		for (int n = 0; n < joined_col_count; n++)
+		is_filled = fill_read_ahead_block(ahead);
+		if (0 >= is_filled)
 		{
-			if (0 == strcmp(csv2_columbs[j].value, joined_cols[n]))
-			{
-				is_joined_col = 1;
-			}
-		}
-		if (!is_joined_col) {
-			fprintf(output, "%s", csv2_columbs[j].value);
+			return (0 == is_filled && ahead->is_ended) ? 0 : -1;
 		}
-		if (((j < csv2_col_count - 1) || (0 < joined_col_count)) && (!is_joined_col))
+		zstd_in.src = ahead->block;
+		zstd_in.size = ahead->block_size;
+		zstd_in.pos = ahead->block_pos;
+		remaining = ZSTD_decompressStream(ahead->zstd, &zstd_out, &zstd_in);
+		ahead->block_pos = zstd_in.pos;
+		if (ZSTD_isError(remaining))
 		{
-			fprintf(output, ",");
+			return -1;
 		}
+		ahead->is_ended = (0 == remaining);
 	}
-
-	for (int i = 0; i < joined_col_count; i++)
+	if (FORMAT_ZSTD == ahead->format)
 	{
-		fprintf(output, "%s", joined_cols[i]);
-
-		if (i < joined_col_count - 1)
-		{
-			fprintf(output, ",");
-		}
+		return (long)zstd_out.pos;
 	}
+#endif
+	return -1;
+}
 
-	for (int i = 0; i < joined_row_count; i++)
+/**
+ * PURPOSE: scans newly decoded bytes for the ends of records, following next_scan_state
+ * INPUT PARAMETERS:
+ *    data: the decoded bytes
+ *    start: position of the first byte not yet scanned
+ *    end: position after the last byte to scan
+ *    state: SCAN_FIELD_START before the first byte of a file, carried over between calls
+ *    ready: position after the last record end found so far
+ * OUTPUT PARAMETERS:
+ *    returns the position after the last line feed that ends a record, ready if there is none from start to end
+ */
+size_t scan_csv_records(const char* data, size_t start, size_t end, int* state, size_t ready)
+{
+	for (size_t i = start; i < end; i++)
 	{
-		fprintf(output, "\n");
-		for (int j = 0; j < csv1_col_count + csv2_col_count - joined_col_count; j++)
-		{
-			fprintf(output, "%s", joined_rows[i].col[j]->value);
-			if (j < csv1_col_count + csv2_col_count - joined_col_count - 1)
-			{
-				fprintf(output, ",");
-			}
-		}
+		*state = next_scan_state(*state, data[i]);
+		ready = (SCAN_FIELD_START == *state && '\n' == data[i]) ? i + 1 : ready;
 	}
+	return ready;
+}
 
-	fclose(output);
+/**
+ * PURPOSE: decodes the file of a read ahead into its data on a thread of its own, handing the data over to the reader a
+ *          whole record at a time and staying at most READ_AHEAD_BYTES ahead of it
+ * INPUT PARAMETERS:
+ *    arg: the Read_ahead
+ * OUTPUT PARAMETERS:
+ *    sets ready as whole records are decoded, and is_done once the file is decoded or it could not be. a file that does
+ *    not end in a line feed has one added
+ */
+void* read_ahead_thread(void* arg)
+{
+	Read_ahead* ahead = arg;
+	size_t written = 0; //bytes of data decoded
+	size_t ready = 0;
+	long decoded = 0;
+	int state = SCAN_FIELD_START;
+	char last = '\n'; //last byte decoded, kept here since the reader may already have split the copy in data
+	int is_stopping = 0; //boolean
 
-	for (int i = 0; i < joined_row_count; i++)
+	do
 	{
-		for (int j = 0; j < csv1_col_count + csv2_col_count - joined_col_count; j++)
+		pthread_mutex_lock(&ahead->lock);
+		while (READ_AHEAD_BYTES <= ready - ahead->taken && !ahead->is_stopping)
 		{
-			free(joined_rows[i].col[j]);
+			pthread_cond_wait(&ahead->changed, &ahead->lock);
 		}
-	}
-	free(joined_rows);
-}
+		is_stopping = ahead->is_stopping;
+		pthread_mutex_unlock(&ahead->lock);
+
+		//room is kept for the line feed ending the data and the byte after it
+		decoded = (written + READ_AHEAD_BLOCK + 2 <= ahead->reserved) ? decode_read_ahead(ahead, ahead->data + written, READ_AHEAD_BLOCK) : -1;
+		if (0 < decoded)
+		{
+			ready = scan_csv_records(ahead->data, written, written + (size_t)decoded, &state, ready);
+			last = ahead->data[written + (size_t)decoded - 1];
+			written += (size_t)decoded;
+		}
+		if (0 == decoded && 0 < written && '\n' != last)
+		{
+			ahead->data[written] = '\n';
+			written++;
+		}
+		ready = (0 == decoded) ? written : ready;
 
+		pthread_mutex_lock(&ahead->lock);
+		ahead->ready = ready;
+		ahead->is_done = (0 >= decoded || is_stopping);
+		ahead->is_failed = (0 > decoded && !is_stopping);
+		pthread_cond_broadcast(&ahead->changed);
+		pthread_mutex_unlock(&ahead->lock);
+	} while (0 < decoded && !is_stopping);
+	return NULL;
+}
 
 /**
- * PURPOSE: preformes a left join on the two csvs represented by inputs and prints the resulting table as a csv named Left_Join.txt
+ * PURPOSE: waits for a Csv_reader's read ahead to decode more whole records and adds them to the reader's data
  * INPUT PARAMETERS:
- *    csv1_columbs: an array of Csv_col structs holding the names of the columbs in csv1
- *    csv1_rows: an array of Csv_row structs holding all rows of csv1
- *    csv1_col_count: number of columbs csv1 containes
- *    csv1_row_count: number of rows csv1 containes
- *    csv2_columbs: an array of Csv_col structs holding the names of the columbs in csv2
- *    csv2_rows: an array of Csv_row structs holding all rows of csv2
- *    csv2_col_count: number of columbs csv2 containes
- *    csv2_row_count: number of rows csv2 containes
+ *    reader: the reader, which has parsed all of its data so far
  * OUTPUT PARAMETERS:
- *    creates a new file named Left_Join.txt and puts the result of a left joining the input csv values in it
+ *    returns 1 if records were added, or 0 if the reader has no read ahead or its whole file has been handed over.
+ *    exits the program if the file could not be read or decoded
  */
-void left_join(Csv_col* csv1_columbs, Csv_row* csv1_rows, int csv1_col_count, int csv1_row_count, Csv_col* csv2_columbs, Csv_row* csv2_rows, int csv2_col_count, int csv2_row_count)
+int take_csv_data(Csv_reader* reader)
 {
-	const char* output_name = "Left_Join.txt";
-	int joined_row_count = 0;
-	int joined_col_count = 0;
-	char joined_cols[MAX_COL][MAX_LINE];
-	Csv_row* joined_rows = calloc(csv1_row_count + csv2_row_count, sizeof(Csv_row));
-	char values[MAX_COL][MAX_LINE];
-	int values_size = 0;
-	int is_joined_col = 0; //boolean
-	FILE* output;
-	int equivilent_counter = 0;
-	int row_matched = 0; //boolean
-	int row_completed = 0;//boolean
+	Read_ahead* ahead = reader->ahead;
+	size_t size = reader->size;
 
-
-	for (int i = 0; i < csv1_col_count; i++)
+	if (NULL == ahead)
 	{
-		for (int j = 0; j < csv2_col_count; j++)
-		{
-			if (0 == strcmp(csv1_columbs[i].value, csv2_columbs[j].value) && 0 != strcmp(csv1_columbs[i].value, null))
-			{
-				strcpy(joined_cols[joined_col_count], csv1_columbs[i].value);
-				joined_col_count++;
-			}
-		}
+		return 0;
 	}
 
-	for (int k = 0; k < csv1_row_count; k++)
+	pthread_mutex_lock(&ahead->lock);
+	while (ahead->ready == ahead->taken && !ahead->is_done)
 	{
-		row_completed = 0;
-		for (int l = 0; l < csv2_row_count;l++)
-		{
-			equivilent_counter = 0;
-			for (int i2 = 0; i2 < joined_col_count; i2++)
-			{
-				for (int j2 = 0; j2 < csv1_col_count; j2++)
-				{
-					if (0 == strcmp(csv1_columbs[j2].value, joined_cols[i2]))
-					{
-						for (int k2 = 0; k2 < csv2_col_count; k2++)
-						{
-							if (0 == strcmp(csv2_columbs[k2].value, joined_cols[i2]) && 0 != strcmp(csv2_columbs[k2].value, null))
-							{
-								if (0 == strcmp(csv1_rows[k].col[j2]->value, csv2_rows[l].col[k2]->value)
-									&& 0 != strcmp(csv1_rows[k].col[j2]->value, null)
-									&& 0 != strcmp(csv2_rows[l].col[k2]->value, null)
-									&& !(equivilent_counter == joined_col_count)
-									&& !(row_completed))
-								{
-
-									equivilent_counter++;
-								}
-							}
-						}
-					}
-				}
-			}
-			if (equivilent_counter == joined_col_count && !row_completed)
-			{
-				values_size = 0;
-				row_matched = 1;
-
-				for (int m = 0; m < csv1_col_count; m++)
-				{
-					for (int m2 = 0; m2 < joined_col_count; m2++)
-					{
-						if (0 == strcmp(csv1_columbs[m].value, joined_cols[m2]))
-						{
-							if (0 == strcmp(csv1_rows[k].col[m]->value, null))
-							{
-								row_matched = 0;
-							}
-						}
-					}
-					assert(NULL != csv1_rows[k].col[m]->value);
-					strcpy(values[values_size], csv1_rows[k].col[m]->value);
-					assert(NULL != values[values_size]);
-					values_size++;
-				}
+		pthread_cond_wait(&ahead->changed, &ahead->lock);
+	}
+	if (ahead->is_failed && ahead->ready == ahead->taken)
+	{
+		fprintf(stderr, "Unable to read %s, it is cut short, corrupt or too large once decompressed.\n", reader->name);
+		exit(EXIT_FAILURE);
+	}
+	ahead->taken = ahead->ready;
+	reader->size = ahead->ready;
+	pthread_cond_broadcast(&ahead->changed);
+	pthread_mutex_unlock(&ahead->lock);
+	return reader->size > size;
+}
 
-				is_joined_col = 0;
-				for (int m = 0; m < csv2_col_count; m++)
-				{
-					is_joined_col = 0;
-					for (int n = 0; n < joined_col_count; n++)
-					{
-						if (0 == strcmp(csv2_columbs[m].value, joined_cols[n]) && 0 != strcmp(csv2_columbs[m].value, null))
-						{
-							if (0 == strcmp(csv2_rows[l].col[m]->value, null))
-							{
-								row_matched = 0;
-							}
-							is_joined_col = 1;
-						}
-					}
-					if (!is_joined_col)
-					{
-						assert(NULL != csv2_rows[l].col[m]->value);
-						strcpy(values[values_size], csv2_rows[l].col[m]->value);
-						assert(NULL != values[values_size]);
-						values_size++;
-					}
-				}
+/**
+ * PURPOSE: stops the thread of a read ahead and frees it, along with the data it decoded into
+ * INPUT PARAMETERS:
+ *    ahead: the read ahead to stop
+ */
+void stop_read_ahead(Read_ahead* ahead)
+{
+	pthread_mutex_lock(&ahead->lock);
+	ahead->is_stopping = 1;
+	pthread_cond_broadcast(&ahead->changed);
+	pthread_mutex_unlock(&ahead->lock);
+	pthread_join(ahead->thread, NULL);
 
-				//creates a completed row
-				validate_values(values, values_size);
-				if (0 < values_size && row_matched && !row_completed)
-				{
-					joined_rows[joined_row_count] = *new_csv_row(values, csv1_col_count + csv2_col_count - joined_col_count);
-					joined_row_count++;
-					row_completed = 1;
-				}
-				values_size = 0;
+#ifdef HAVE_ZLIB
+	if (FORMAT_GZIP == ahead->format)
+	{
+		inflateEnd(&ahead->gzip);
+	}
+#endif
+#ifdef HAVE_ZSTD
+	ZSTD_freeDStream(ahead->zstd);
+#endif
+	pthread_mutex_destroy(&ahead->lock);
+	pthread_cond_destroy(&ahead->changed);
+	munmap(ahead->data, ahead->reserved);
+	free(ahead->block);
+	free(ahead);
+}
 
+/**
+ * PURPOSE: closes a Csv_reader, unmapping or freeing its copy of the file and closing the file itself
+ * INPUT PARAMETERS:
+ *    reader: the reader to close, may be NULL
+ */
+void close_csv_reader(Csv_reader* reader)
+{
+	if (NULL != reader)
+	{
+		if (NULL != reader->ahead)
+		{
+			stop_read_ahead(reader->ahead);
+		}
+		else if (reader->is_mapped)
+		{
+			munmap(reader->data, reader->map_size);
+		}
+		else
+		{
+			free(reader->data);
+		}
+		fclose(reader->input);
+		free(reader);
+	}
+}
+
+/**
+ * PURPOSE: wraps an open file in a Csv_reader, mapping the whole file into memory so it is only read once.
+ *          files that cannot be mapped, such as pipes, are read into memory in blocks instead
+ * INPUT PARAMETERS:
+ *    input: the file to read, the reader takes ownership of it and closes it in close_csv_reader
+ *    name: name of the file used in error messages
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_reader positioned at the start of the file, or NULL if the file could not be read
+ */
+Csv_reader* new_csv_reader(FILE* input, char* name)
+{
+	Csv_reader* reader = calloc(1, sizeof(Csv_reader));
+	size_t capacity = 0;
+	size_t read_size = 0;
+	char* data = NULL;
+
+	if (NULL == reader)
+	{
+		fclose(input);
+		return NULL;
+	}
+	reader->input = input;
+	reader->name = name;
+
+	//anything already written through input has to reach the file before it is mapped
+	fflush(input);
+	if (map_csv_reader(reader))
+	{
+		return reader;
+	}
+
+	rewind(input);
+	do
+	{
+		//keeps room for a closing line feed after the data, and for more to be read
+		if (capacity <= reader->size + 1)
+		{
+			capacity = (0 < capacity) ? capacity * 2 : READ_BLOCK_SIZE;
+			data = realloc(reader->data, capacity);
+			if (NULL == data)
+			{
+				close_csv_reader(reader);
+				return NULL;
+			}
+			reader->data = data;
+		}
+		read_size = fread(reader->data + reader->size, 1, capacity - reader->size - 1, input);
+		reader->size += read_size;
+	} while (0 < read_size);
+
+	if (ferror(input))
+	{
+		close_csv_reader(reader);
+		return NULL;
+	}
+	end_csv_data(reader);
+	return reader;
+}
+
+/**
+ * PURPOSE: readies a read ahead to decode its file in the format it was found to be in
+ * INPUT PARAMETERS:
+ *    ahead: the read ahead, its format set
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the file can be decoded, or 0 if it is compressed in a format this build cannot decode
+ */
+int start_read_ahead_codec(Read_ahead* ahead)
+{
+	if (FORMAT_GZIP == ahead->format)
+	{
+#ifdef HAVE_ZLIB
+		//15 + 32 takes the largest window and skips the gzip header
+		return Z_OK == inflateInit2(&ahead->gzip, 15 + 32);
+#else
+		return 0;
+#endif
+	}
+	if (FORMAT_ZSTD == ahead->format)
+	{
+#ifdef HAVE_ZSTD
+		ahead->zstd = ZSTD_createDStream();
+		return NULL != ahead->zstd && !ZSTD_isError(ZSTD_initDStream(ahead->zstd));
+#else
+		return 0;
+#endif
+	}
+	return 1;
+}
+
+/**
+ * PURPOSE: wraps a file that cannot be mapped as it is, a compressed file or a pipe, in a Csv_reader that decodes it on
+ *          a thread of its own while its records are parsed. gzip and zstd files are recognised by the bytes they start with
+ * INPUT PARAMETERS:
+ *    input: the file to read, the reader takes ownership of it and closes it in close_csv_reader
+ *    name: name of the file used in error messages
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_reader positioned at the start of the file, or NULL if the file could not be read. exits the program
+ *    if the file is compressed in a format this build cannot decode
+ */
+Csv_reader* new_read_ahead_reader(FILE* input, char* name)
+{
+	Csv_reader* reader = calloc(1, sizeof(Csv_reader));
+	Read_ahead* ahead = calloc(1, sizeof(Read_ahead));
+	char* data = MAP_FAILED;
+	size_t reserved = READ_AHEAD_RESERVE;
+
+	assert(NULL != reader && NULL != ahead);
+	ahead->block = malloc(READ_AHEAD_BLOCK);
+	assert(NULL != ahead->block);
+
+	//only the pages decoded into are ever backed by memory, so the reservation can be far larger than the file
+	while (MAP_FAILED == data && READ_AHEAD_BYTES < reserved)
+	{
+		data = mmap(NULL, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		reserved = (MAP_FAILED == data) ? reserved / 2 : reserved;
+	}
+	ahead->block_size = fread(ahead->block, 1, READ_AHEAD_BLOCK, input);
+	if (MAP_FAILED == data || ferror(input))
+	{
+		if (MAP_FAILED != data)
+		{
+			munmap(data, reserved);
+		}
+		free(ahead->block);
+		free(ahead);
+		free(reader);
+		fclose(input);
+		return NULL;
+	}
+
+	ahead->input = input;
+	ahead->data = data;
+	ahead->reserved = reserved;
+	ahead->format = compression_of_bytes(ahead->block, ahead->block_size);
+	if (!start_read_ahead_codec(ahead))
+	{
+		fprintf(stderr, "Unable to read %s, csv_merge was built without %s.\n", name,
+			(FORMAT_GZIP == ahead->format) ? "gzip" : "zstd");
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_init(&ahead->lock, NULL);
+	pthread_cond_init(&ahead->changed, NULL);
+	if (0 != pthread_create(&ahead->thread, NULL, read_ahead_thread, ahead))
+	{
+		fprintf(stderr, "Unable to start a worker thread.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	reader->input = input;
+	reader->name = name;
+	reader->ahead = ahead;
+	reader->data = data;
+	reader->map_size = reserved;
+	return reader;
+}
+
+/**
+ * PURPOSE: opens a csv file for reading with a Csv_reader. a regular file is mapped, while a gzip or zstd compressed
+ *          file or a pipe is decoded on a thread of its own as it is parsed
+ * INPUT PARAMETERS:
+ *    filename: name of the csv to open, "-" reads stdin
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_reader positioned at the start of the file, or NULL if the file could not be opened
+ */
+Csv_reader* open_csv_reader(char* filename)
+{
+	FILE* input = (0 == strcmp(filename, "-")) ? stdin : fopen(filename, "r");
+	struct stat info;
+	char magic[4];
+	ssize_t magic_size = 0;
+
+	if (NULL == input)
+	{
+		return NULL;
+	}
+	if (0 != fstat(fileno(input), &info) || !S_ISREG(info.st_mode))
+	{
+		return new_read_ahead_reader(input, filename);
+	}
+	magic_size = pread(fileno(input), magic, sizeof(magic), 0);
+	if (0 < magic_size && FORMAT_PLAIN != compression_of_bytes(magic, (size_t)magic_size))
+	{
+		return new_read_ahead_reader(input, filename);
+	}
+	return new_csv_reader(input, filename);
+}
+
+/**
+ * PURPOSE: splits the next field off a record in place
+ * INPUT PARAMETERS:
+ *    field: start of the field
+ *    end: end of the reader's data
+ *    is_last: set to 1 if the field ends its record, otherwise set to 0
+ *    is_unclosed: set to 1 if the field is a quoted value whose closing quote is missing, otherwise left alone
+ * OUTPUT PARAMETERS:
+ *    returns the start of whatever follows the field, the field itself is left as a string starting at field
+ */
+char* split_csv_field(char* field, char* end, int* is_last, int* is_unclosed)
+{
+	char* field_end = NULL;
+
+	if ('"' == *field)
+	{
+		field_end = unquote_field(field, end, is_unclosed);
+	}
+	else
+	{
+		field_end = find_field_end(field, end);
+		if ('\n' == *field_end && field < field_end && '\r' == field_end[-1])
+		{
+			field_end[-1] = '\0';
+		}
+	}
+	*is_last = ('\n' == *field_end);
+	*field_end = '\0';
+	return field_end + 1;
+}
+
+/**
+ * PURPOSE: checks if a line is blank, handling both \n and \r\n line endings
+ * INPUT PARAMETERS:
+ *    line: start of the line
+ * OUTPUT PARAMETERS:
+ *    returns the number of bytes in the blank line including its line ending, or 0 if the line is not blank
+ */
+int blank_line_length(char* line)
+{
+	if ('\n' == line[0])
+	{
+		return 1;
+	}
+	return ('\r' == line[0] && '\n' == line[1]) ? 2 : 0;
+}
+
+/**
+ * PURPOSE: reads the next record of a csv and splits it into its columbs following RFC 4180, so quoted fields may hold
+ *          commas, quotes and line breaks and empty fields are kept. the record is split in place so every value points
+ *          straight into the reader's copy of the file rather than being copied out of it
+ * INPUT PARAMETERS:
+ *    reader: the reader to read from
+ *    values: array to put a pointer to each columb's value in, with room for col_count items
+ *    col_count: number of columbs expected in the record
+ * OUTPUT PARAMETERS:
+ *    returns the number of columbs found in the record or -1 at the end of the file, any expected columbs that are
+ *    missing are set to null and a blank line has no columbs. the values stay valid until release_csv_reader is called
+ *    after a later record is read
+ */
+int next_csv_record(Csv_reader* reader, char** values, int col_count)
+{
+	char* field = NULL;
+	char* end = NULL;
+	char* value = NULL;
+	int found = 0;
+	int is_last = 0; //boolean
+
+	if (reader->pos == reader->size && !take_csv_data(reader))
+	{
+		return -1;
+	}
+	field = reader->data + reader->pos;
+	end = reader->data + reader->size;
+	reader->record_start = reader->pos;
+
+	if (0 < blank_line_length(field))
+	{
+		field += blank_line_length(field);
+		is_last = 1;
+	}
+	while (!is_last)
+	{
+		value = field;
+		field = split_csv_field(field, end, &is_last, &reader->is_unclosed);
+		if (found < col_count)
+		{
+			values[found] = value;
+			found++;
+		}
+	}
+
+	reader->pos = (size_t)(field - reader->data);
+	for (int i = found; i < col_count; i++)
+	{
+		values[i] = null;
+	}
+	return found;
+}
+
+/**
+ * PURPOSE: hands the part of a mapped or decoded file before a position back to the system. pages are only released
+ *          READ_BLOCK_SIZE at a time
+ * INPUT PARAMETERS:
+ *    reader: the reader to release memory from, no value before pos may still be in use
+ *    pos: position within the reader's data everything before which is no longer needed
+ */
+void release_csv_data(Csv_reader* reader, size_t pos)
+{
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	size_t end = pos / page_size * page_size;
+
+	if ((reader->is_mapped || NULL != reader->ahead) && end > reader->released && READ_BLOCK_SIZE <= end - reader->released)
+	{
+		madvise(reader->data + reader->released, end - reader->released, MADV_DONTNEED);
+		reader->released = end;
+	}
+}
+
+/**
+ * PURPOSE: hands the part of a mapped file before the most recently read record back to the system, so reading a file
+ *          much larger than memory does not keep all of it resident
+ * INPUT PARAMETERS:
+ *    reader: the reader to release memory from, any values read before its most recent record must no longer be in use
+ */
+void release_csv_reader(Csv_reader* reader)
+{
+	release_csv_data(reader, reader->record_start);
+}
+
+/**
+ * PURPOSE: moves a Csv_reader back to an earlier record, remapping the file so records already split in place can be
+ *          read again
+ * INPUT PARAMETERS:
+ *    reader: the reader to move, it must be mapped
+ *    pos: position of the record to move back to, as held in pos before the record was read
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the reader was moved or 0 if the file could not be mapped again
+ */
+int seek_csv_reader(Csv_reader* reader, size_t pos)
+{
+	assert(reader->is_mapped);
+
+	munmap(reader->data, reader->map_size);
+	reader->is_mapped = map_csv_reader(reader);
+	if (!reader->is_mapped)
+	{
+		reader->data = NULL;
+		reader->size = 0;
+		reader->pos = 0;
+		return 0;
+	}
+
+	reader->pos = pos;
+	reader->record_start = pos;
+	reader->released = 0;
+	return 1;
+}
+
+/**
+ * PURPOSE: copies a string into an arena, allocating a new block when the newest block is full
+ * INPUT PARAMETERS:
+ *    arena: the newest block of the arena, updated when a new block is allocated
+ *    value: the string to copy
+ * OUTPUT PARAMETERS:
+ *    returns the copy of value, or NULL if memory could not be allocated
+ */
+char* arena_strdup(Arena_block** arena, const char* value)
+{
+	size_t size = strlen(value) + 1;
+	Arena_block* block = *arena;
+	char* copy = NULL;
+
+	if (NULL == block || block->size - block->used < size)
+	{
+		block = malloc(sizeof(Arena_block) + ((size < ARENA_BLOCK_SIZE) ? ARENA_BLOCK_SIZE : size));
+		count_stat(&stats.allocations, 1);
+		if (NULL != block)
+		{
+			block->next = *arena;
+			block->size = (size < ARENA_BLOCK_SIZE) ? ARENA_BLOCK_SIZE : size;
+			block->used = 0;
+			*arena = block;
+		}
+	}
+
+	if (NULL != block)
+	{
+		copy = memcpy(block->data + block->used, value, size);
+		block->used += size;
+	}
+	return copy;
+}
+
+/**
+ * PURPOSE: frees every block of an arena
+ * INPUT PARAMETERS:
+ *    arena: the newest block of the arena, may be NULL
+ */
+void free_arena(Arena_block* arena)
+{
+	Arena_block* next = NULL;
+
+	while (NULL != arena)
+	{
+		next = arena->next;
+		free(arena);
+		arena = next;
+	}
+}
+
+/**
+ * PURPOSE: hashes a single value using 64 bit FNV-1a
+ * INPUT PARAMETERS:
+ *    value: the string to hash
+ * OUTPUT PARAMETERS:
+ *    returns the hash of value
+ */
+uint64_t hash_value(const char* value)
+{
+	uint64_t hash = FNV_OFFSET;
+	const unsigned char* byte = (const unsigned char*)value;
+
+	while ('\0' != *byte)
+	{
+		hash = (hash ^ *byte) * FNV_PRIME;
+		byte++;
+	}
+	return hash;
+}
+
+/**
+ * PURPOSE: hashes a block of bytes with the same 64 bit FNV-1a hash_value uses
+ * INPUT PARAMETERS:
+ *    data: the bytes to hash
+ *    size: number of bytes in data
+ * OUTPUT PARAMETERS:
+ *    returns the hash of the bytes
+ */
+uint64_t hash_bytes(const char* data, size_t size)
+{
+	uint64_t hash = FNV_OFFSET;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ (unsigned char)data[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+/**
+ * PURPOSE: hashes the binary value of a number or date key using 64 bit FNV-1a over its bytes
+ * INPUT PARAMETERS:
+ *    word: the value to hash
+ * OUTPUT PARAMETERS:
+ *    returns the hash of word
+ */
+uint64_t hash_word(int64_t word)
+{
+	uint64_t hash = FNV_OFFSET;
+	uint64_t bits = (uint64_t)word;
+
+	for (int i = 0; i < 8; i++)
+	{
+		hash = (hash ^ (bits & 0xff)) * FNV_PRIME;
+		bits >>= 8;
+	}
+	return hash;
+}
+
+/**
+ * PURPOSE: checks if a value is a number, an optional sign followed by digits and optionally a decimal point and more digits
+ * INPUT PARAMETERS:
+ *    value: the string to check
+ *    int_digits: set to the number of digits before the decimal point, not counting leading zeros
+ *    frac_digits: set to the number of digits after the decimal point, not counting trailing zeros
+ * OUTPUT PARAMETERS:
+ *    returns 1 if value is a number, otherwise 0
+ */
+int scan_number(const char* value, int* int_digits, int* frac_digits)
+{
+	const char* c = value + ('-' == *value || '+' == *value);
+	const char* first = c;
+	int trailing_zeros = 0;
+
+	*int_digits = 0;
+	*frac_digits = 0;
+	while ('0' == *c)
+	{
+		c++;
+	}
+	for (; isdigit((unsigned char)*c); c++)
+	{
+		(*int_digits)++;
+	}
+	if (c == first)
+	{
+		return 0;
+	}
+
+	if ('.' == *c)
+	{
+		c++;
+		first = c;
+		for (; isdigit((unsigned char)*c); c++)
+		{
+			(*frac_digits)++;
+			trailing_zeros = ('0' == *c) ? trailing_zeros + 1 : 0;
+		}
+		if (c == first)
+		{
+			return 0;
+		}
+		*frac_digits -= trailing_zeros;
+	}
+	return '\0' == *c;
+}
+
+/**
+ * PURPOSE: converts a key value to the binary value it is compared by
+ * INPUT PARAMETERS:
+ *    value: the string to convert
+ *    type: KEY_NUMBER or KEY_DATE
+ *    scale: digits after the decimal point a KEY_NUMBER value is scaled by
+ * OUTPUT PARAMETERS:
+ *    returns the value as a whole number of 10^-scale units for KEY_NUMBER, or as YYYYMMDD for KEY_DATE.
+ *    returns INVALID_WORD if value is not of the type or does not fit, which includes null
+ */
+int64_t parse_key_word(const char* value, int type, int scale)
+{
+	const char* c = value + ('-' == *value || '+' == *value);
+	int64_t word = 0;
+	int int_digits = 0;
+	int frac_digits = 0;
+	int month = 0;
+	int day = 0;
+
+	if (KEY_DATE == type)
+	{
+		for (int i = 0; i < 10; i++)
+		{
+			if ((4 == i || 7 == i) ? '-' != value[i] : !isdigit((unsigned char)value[i]))
+			{
+				return INVALID_WORD;
+			}
+		}
+		month = (value[5] - '0') * 10 + (value[6] - '0');
+		day = (value[8] - '0') * 10 + (value[9] - '0');
+		if ('\0' != value[10] || 1 > month || 12 < month || 1 > day || 31 < day)
+		{
+			return INVALID_WORD;
+		}
+		return (int64_t)atoi(value) * 10000 + month * 100 + day;
+	}
+
+	if (!scan_number(value, &int_digits, &frac_digits) || frac_digits > scale || int_digits + scale > MAX_KEY_DIGITS)
+	{
+		return INVALID_WORD;
+	}
+	for (; '.' != *c && '\0' != *c; c++)
+	{
+		word = word * 10 + (*c - '0');
+	}
+	c += ('.' == *c);
+	for (int f = 0; f < scale; f++)
+	{
+		word = word * 10 + (('\0' != *c) ? *c - '0' : 0);
+		c += ('\0' != *c);
+	}
+	return ('-' == *value) ? -word : word;
+}
+
+/**
+ * PURPOSE: appends bytes to the end of a columb's data buffer, growing the buffer if needed
+ * INPUT PARAMETERS:
+ *    column: the columb to add the bytes to
+ *    value: the bytes to add
+ *    size: number of bytes in value
+ * OUTPUT PARAMETERS:
+ *    returns the offset of the copy within the columb's data, or (size_t)-1 if memory could not be allocated
+ */
+size_t append_column_bytes(Csv_column* column, const char* value, size_t size)
+{
+	size_t offset = column->data_size;
+	size_t capacity = (0 < column->data_capacity) ? column->data_capacity : 4096;
+	char* data = column->data;
+
+	while (capacity - column->data_size < size)
+	{
+		capacity *= 2;
+	}
+	if (capacity != column->data_capacity)
+	{
+		data = realloc(column->data, capacity);
+		count_stat(&stats.allocations, 1);
+		if (NULL == data)
+		{
+			return (size_t)-1;
+		}
+		column->data = data;
+		column->data_capacity = capacity;
+	}
+
+	memcpy(column->data + offset, value, size);
+	column->data_size += size;
+	return offset;
+}
+
+/**
+ * PURPOSE: appends a string to the end of a columb's data buffer, growing the buffer if needed
+ * INPUT PARAMETERS:
+ *    column: the columb to add the string to
+ *    value: the string to add
+ * OUTPUT PARAMETERS:
+ *    returns the offset of the copy within the columb's data, or (size_t)-1 if memory could not be allocated
+ */
+size_t append_column_data(Csv_column* column, const char* value)
+{
+	return append_column_bytes(column, value, strlen(value) + 1);
+}
+
+/**
+ * PURPOSE: looks a value up in a dictionary encoded columb
+ * INPUT PARAMETERS:
+ *    column: the columb to search, must be dictionary encoded
+ *    value: the value to look for
+ *    hash: the hash of value as returned by hash_value
+ * OUTPUT PARAMETERS:
+ *    returns the dictionary code of value, or -1 if the columb does not hold it
+ */
+int dict_lookup(Csv_column* column, const char* value, uint64_t hash)
+{
+	uint64_t slot = hash & (DICT_BUCKETS - 1);
+	int code = column->dict_buckets[slot];
+
+	while (-1 != code && !(column->dict_hashes[code] == hash && 0 == strcmp(column->data + column->dict_offsets[code], value)))
+	{
+		slot = (slot + 1) & (DICT_BUCKETS - 1);
+		code = column->dict_buckets[slot];
+	}
+	return code;
+}
+
+/**
+ * PURPOSE: adds a value missing from a columb's dictionary to it
+ * INPUT PARAMETERS:
+ *    column: the columb to add the value to, must be dictionary encoded with fewer than DICT_MAX_SIZE entries
+ *    value: the value to add
+ *    hash: the hash of value as returned by hash_value
+ * OUTPUT PARAMETERS:
+ *    returns the dictionary code of the new entry, or -1 if memory could not be allocated
+ */
+int add_dict_value(Csv_column* column, const char* value, uint64_t hash)
+{
+	uint64_t slot = hash & (DICT_BUCKETS - 1);
+	size_t offset = append_column_data(column, value);
+	int code = column->dict_count;
+
+	if ((size_t)-1 == offset)
+	{
+		return -1;
+	}
+	column->dict_offsets[code] = offset;
+	column->dict_hashes[code] = hash;
+	column->dict_count++;
+
+	while (-1 != column->dict_buckets[slot])
+	{
+		slot = (slot + 1) & (DICT_BUCKETS - 1);
+	}
+	column->dict_buckets[slot] = code;
+	return code;
+}
+
+/**
+ * PURPOSE: stops dictionary encoding a columb once it holds too many distinct values, every row is pointed directly at
+ *          its dictionary entry's string so nothing has to be copied
+ * INPUT PARAMETERS:
+ *    column: the columb to convert
+ *    row_count: number of rows already in the columb
+ *    row_capacity: number of rows the columb has room for
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the columb was converted or 0 if memory could not be allocated
+ */
+int drop_column_dict(Csv_column* column, int row_count, int row_capacity)
+{
+	column->offsets = malloc((size_t)row_capacity * sizeof(size_t));
+	if (NULL == column->offsets)
+	{
+		return 0;
+	}
+
+	for (int r = 0; r < row_count; r++)
+	{
+		column->offsets[r] = column->dict_offsets[column->codes[r]];
+	}
+
+	free(column->codes);
+	free(column->dict_offsets);
+	free(column->dict_hashes);
+	free(column->dict_buckets);
+	column->codes = NULL;
+	column->dict_offsets = NULL;
+	column->dict_hashes = NULL;
+	column->dict_buckets = NULL;
+	column->dict_count = 0;
+	return 1;
+}
+
+/**
+ * PURPOSE: stores a row's value in a columb, adding it to the columb's dictionary if it is dictionary encoded
+ * INPUT PARAMETERS:
+ *    column: the columb to store the value in
+ *    row: position of the row within the table
+ *    row_capacity: number of rows the columb has room for
+ *    value: the value to store
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the value was stored or 0 if memory could not be allocated
+ */
+int set_column_value(Csv_column* column, int row, int row_capacity, const char* value)
+{
+	uint64_t hash = 0;
+	size_t offset = 0;
+	int code = -1;
+
+	if (NULL != column->codes)
+	{
+		hash = hash_value(value);
+		code = dict_lookup(column, value, hash);
+		if (-1 == code && DICT_MAX_SIZE > column->dict_count)
+		{
+			code = add_dict_value(column, value, hash);
+			if (-1 == code)
+			{
+				return 0;
+			}
+		}
+
+		if (-1 != code)
+		{
+			column->codes[row] = code;
+			return 1;
+		}
+		if (!drop_column_dict(column, row, row_capacity))
+		{
+			return 0;
+		}
+	}
+
+	offset = append_column_data(column, value);
+	if ((size_t)-1 == offset)
+	{
+		return 0;
+	}
+	column->offsets[row] = offset;
+	return 1;
+}
+
+/**
+ * PURPOSE: gets the value a row holds in one columb of a Csv_table
+ * INPUT PARAMETERS:
+ *    table: the table holding the row
+ *    row: position of the row within the table
+ *    col: position of the columb within the table
+ * OUTPUT PARAMETERS:
+ *    returns the value, which stays valid until another row is added to the table
+ */
+char* csv_value(Csv_table* table, int row, int col)
+{
+	Csv_column* column = &table->columns[col];
+
+	return column->data + ((NULL != column->codes) ? column->dict_offsets[column->codes[row]] : column->offsets[row]);
+}
+
+/**
+ * PURPOSE: gathers the values of a row of a Csv_table
+ * INPUT PARAMETERS:
+ *    table: the table holding the row
+ *    row: position of the row within the table
+ *    values: array to put the value of each columb in
+ * OUTPUT PARAMETERS:
+ *    returns values
+ */
+char** csv_row(Csv_table* table, int row, char** values)
+{
+	for (int i = 0; i < table->col_count; i++)
+	{
+		values[i] = csv_value(table, row, i);
+	}
+	return values;
+}
+
+/**
+ * PURPOSE: frees a Csv_table struct and every columb it holds in a single call, unmapping the table image it was read
+ *          from if it came from --cache
+ * INPUT PARAMETERS:
+ *    table: the table to be freed, may be NULL
+ */
+void free_csv_table(Csv_table* table)
+{
+	if (NULL != table && NULL != table->image)
+	{
+		for (int i = 0; i < table->col_count; i++)
+		{
+			free(table->columns[i].words);
+		}
+		munmap(table->image, table->image_size);
+		free(table->columns);
+		free(table->columbs);
+		free(table);
+	}
+	else if (NULL != table)
+	{
+		for (int i = 0; i < table->col_count && NULL != table->columns; i++)
+		{
+			free(table->columns[i].data);
+			free(table->columns[i].offsets);
+			free(table->columns[i].codes);
+			free(table->columns[i].dict_offsets);
+			free(table->columns[i].dict_hashes);
+			free(table->columns[i].dict_buckets);
+			free(table->columns[i].words);
+		}
+		free(table->columns);
+		free_arena(table->arena);
+		free(table->columbs);
+		free(table);
+	}
+}
+
+/**
+ * PURPOSE: creates a new empty Csv_table dynamically allocating memeory for it. every columb starts out dictionary encoded
+ *          and switches to storing each row's value once it holds more than DICT_MAX_SIZE distinct values
+ * INPUT PARAMETERS:
+ *    columbs: the name of each columb of the table
+ *    col_count: The number of items contained in columbs
+ *    row_capacity: number of rows to make room for up front, the table still grows past this if needed
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_table struct holding a copy of the columb names, or NULL if memory could not be allocated
+ */
+Csv_table* new_csv_table(char** columbs, int col_count, int row_capacity)
+{
+	Csv_table* table = calloc(1, sizeof(Csv_table));
+	Csv_column* column = NULL;
+	int is_valid = (NULL != table); //boolean
+
+	if (is_valid)
+	{
+		table->col_count = col_count;
+		table->row_capacity = (0 < row_capacity) ? row_capacity : 1;
+		table->columbs = malloc((col_count + 1) * sizeof(char*));
+		table->columns = calloc(col_count + 1, sizeof(Csv_column));
+		is_valid = (NULL != table->columbs && NULL != table->columns);
+
+		for (int i = 0; i < col_count && is_valid; i++)
+		{
+			table->columbs[i] = arena_strdup(&table->arena, columbs[i]);
+			column = &table->columns[i];
+			column->codes = malloc((size_t)table->row_capacity * sizeof(int));
+			column->dict_offsets = malloc(DICT_MAX_SIZE * sizeof(size_t));
+			column->dict_hashes = malloc(DICT_MAX_SIZE * sizeof(uint64_t));
+			column->dict_buckets = malloc(DICT_BUCKETS * sizeof(int));
+			is_valid = (NULL != table->columbs[i] && NULL != column->codes && NULL != column->dict_offsets
+				&& NULL != column->dict_hashes && NULL != column->dict_buckets);
+
+			for (int b = 0; b < DICT_BUCKETS && is_valid; b++)
+			{
+				column->dict_buckets[b] = -1;
+			}
+		}
+	}
+
+	if (!is_valid)
+	{
+		free_csv_table(table);
+		table = NULL;
+	}
+	return table;
+}
+
+/**
+ * PURPOSE: makes room for more rows in every columb of a Csv_table
+ * INPUT PARAMETERS:
+ *    table: the table to grow
+ *    new_capacity: number of rows the table should have room for, at least its current capacity
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the table was grown or 0 if memory could not be allocated
+ */
+int grow_csv_table(Csv_table* table, int new_capacity)
+{
+	Csv_column* column = NULL;
+	int is_grown = 1; //boolean
+
+	//grows the per row array of every columb together so they always have the same capacity
+	for (int i = 0; i < table->col_count && is_grown; i++)
+	{
+		column = &table->columns[i];
+		if (NULL != column->codes)
+		{
+			int* codes = realloc(column->codes, (size_t)new_capacity * sizeof(int));
+			is_grown = (NULL != codes);
+			column->codes = is_grown ? codes : column->codes;
+		}
+		else
+		{
+			size_t* offsets = realloc(column->offsets, (size_t)new_capacity * sizeof(size_t));
+			is_grown = (NULL != offsets);
+			column->offsets = is_grown ? offsets : column->offsets;
+		}
+	}
+	if (is_grown)
+	{
+		table->row_capacity = new_capacity;
+	}
+	count_stat(&stats.allocations, table->col_count);
+	return is_grown;
+}
+
+/**
+ * PURPOSE: appends a row to a Csv_table, copying each value into its columb
+ * INPUT PARAMETERS:
+ *    table: the table to add the row to
+ *    values: the value of each columb of the row
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the row was added or 0 if memory could not be allocated
+ */
+int add_csv_row(Csv_table* table, char** values)
+{
+	int is_added = 1; //boolean
+
+	if (table->row_count == table->row_capacity && !grow_csv_table(table, table->row_capacity * 2))
+	{
+		return 0;
+	}
+
+	for (int i = 0; i < table->col_count && is_added; i++)
+	{
+		is_added = set_column_value(&table->columns[i], table->row_count, table->row_capacity, values[i]);
+	}
+	if (is_added)
+	{
+		table->row_count++;
+	}
+	return is_added;
+}
+
+/**
+ * PURPOSE: appends every row of one columb to the end of another, merging their dictionaries while the values still fit
+ *          in one. otherwise the rows are pointed into a single copy of the other columb's strings
+ * INPUT PARAMETERS:
+ *    column: the columb to append to
+ *    row_count: number of rows already in column
+ *    row_capacity: number of rows column has room for, enough to hold the appended rows
+ *    rows: the columb whose rows are appended
+ *    rows_count: number of rows in rows
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the rows were appended or 0 if memory could not be allocated
+ */
+int append_column(Csv_column* column, int row_count, int row_capacity, Csv_column* rows, int rows_count)
+{
+	int* code_map = NULL;
+	const char* value = NULL;
+	size_t base = 0;
+
+	if (NULL != column->codes && NULL != rows->codes)
+	{
+		code_map = malloc((rows->dict_count + 1) * sizeof(int));
+		if (NULL == code_map)
+		{
+			return 0;
+		}
+		for (int code = 0; code < rows->dict_count && NULL != column->codes; code++)
+		{
+			value = rows->data + rows->dict_offsets[code];
+			code_map[code] = dict_lookup(column, value, rows->dict_hashes[code]);
+			if (-1 == code_map[code] && DICT_MAX_SIZE > column->dict_count)
+			{
+				code_map[code] = add_dict_value(column, value, rows->dict_hashes[code]);
+				if (-1 == code_map[code])
+				{
+					free(code_map);
+					return 0;
+				}
+			}
+			else if (-1 == code_map[code] && !drop_column_dict(column, row_count, row_capacity))
+			{
+				free(code_map);
+				return 0;
+			}
+		}
+
+		for (int r = 0; r < rows_count && NULL != column->codes; r++)
+		{
+			column->codes[row_count + r] = code_map[rows->codes[r]];
+		}
+		free(code_map);
+		if (NULL != column->codes)
+		{
+			return 1;
+		}
+	}
+
+	if (NULL != column->codes && !drop_column_dict(column, row_count, row_capacity))
+	{
+		return 0;
+	}
+	base = append_column_bytes(column, rows->data, rows->data_size);
+	if ((size_t)-1 == base)
+	{
+		return 0;
+	}
+	for (int r = 0; r < rows_count; r++)
+	{
+		column->offsets[row_count + r] = base + ((NULL != rows->codes) ? rows->dict_offsets[rows->codes[r]] : rows->offsets[r]);
+	}
+	return 1;
+}
+
+/**
+ * PURPOSE: appends every row of one Csv_table to the end of another with the same columbs
+ * INPUT PARAMETERS:
+ *    table: the table to append to
+ *    rows: the table whose rows are appended, left unchanged
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the rows were appended or 0 if memory could not be allocated
+ */
+int append_csv_table(Csv_table* table, Csv_table* rows)
+{
+	int row_count = table->row_count + rows->row_count;
+	int is_added = 1; //boolean
+
+	if (row_count > table->row_capacity && !grow_csv_table(table, row_count))
+	{
+		return 0;
+	}
+	for (int i = 0; i < table->col_count && is_added; i++)
+	{
+		is_added = append_column(&table->columns[i], table->row_count, table->row_capacity, &rows->columns[i], rows->row_count);
+	}
+	if (is_added)
+	{
+		table->row_count = row_count;
+	}
+	return is_added;
+}
+
+/**
+ * PURPOSE: finds the columbs that both csvs share, rows are joined on the values held in these columbs
+ * INPUT PARAMETERS:
+ *    csv1_names: the names of the columbs in csv1
+ *    csv1_col_count: number of columbs csv1 containes
+ *    csv2_names: the names of the columbs in csv2
+ *    csv2_col_count: number of columbs csv2 containes
+ *    join_cols: Join_cols struct to be filled in
+ * OUTPUT PARAMETERS:
+ *    fills join_cols with the name and position of every shared columb, freed with free_join_cols
+ */
+void find_joined_cols(char** csv1_names, int csv1_col_count, char** csv2_names, int csv2_col_count, Join_cols* join_cols)
+{
+	int n = 0;
+	int shared_count = 0;
+
+	//counts the shared columbs first so each array is allocated once at its final size
+	for (int i = 0; i < csv1_col_count; i++)
+	{
+		for (int j = 0; j < csv2_col_count; j++)
+		{
+			shared_count += (0 == strcmp(csv1_names[i], csv2_names[j]) && 0 != strcmp(csv1_names[i], null));
+		}
+	}
+
+	join_cols->count = 0;
+	join_cols->names = malloc((shared_count + 1) * sizeof(char*));
+	join_cols->csv1_index = malloc((shared_count + 1) * sizeof(int));
+	join_cols->csv2_index = malloc((shared_count + 1) * sizeof(int));
+	join_cols->csv1_key_pos = malloc((csv1_col_count + 1) * sizeof(int));
+	join_cols->csv2_key_pos = malloc((csv2_col_count + 1) * sizeof(int));
+	join_cols->key_types = malloc((shared_count + 1) * sizeof(int));
+	join_cols->key_scales = malloc((shared_count + 1) * sizeof(int));
+	join_cols->string_keys = malloc((shared_count + 1) * sizeof(int));
+	join_cols->string_key_count = 0;
+	assert(NULL != join_cols->names && NULL != join_cols->csv1_index && NULL != join_cols->csv2_index
+		&& NULL != join_cols->csv1_key_pos && NULL != join_cols->csv2_key_pos && NULL != join_cols->key_types
+		&& NULL != join_cols->key_scales && NULL != join_cols->string_keys);
+
+	for (int i = 0; i < csv1_col_count; i++)
+	{
+		join_cols->csv1_key_pos[i] = -1;
+	}
+	for (int j = 0; j < csv2_col_count; j++)
+	{
+		join_cols->csv2_key_pos[j] = -1;
+	}
+
+	for (int i = 0; i < csv1_col_count; i++)
+	{
+		for (int j = 0; j < csv2_col_count; j++)
+		{
+			if (0 == strcmp(csv1_names[i], csv2_names[j]) && 0 != strcmp(csv1_names[i], null))
+			{
+				n = join_cols->count;
+				join_cols->names[n] = csv1_names[i];
+				join_cols->csv1_index[n] = i;
+				join_cols->csv2_index[n] = j;
+				join_cols->key_types[n] = KEY_TEXT;
+				join_cols->key_scales[n] = 0;
+				if (-1 == join_cols->csv1_key_pos[i])
+				{
+					join_cols->csv1_key_pos[i] = n;
+				}
+				if (-1 == join_cols->csv2_key_pos[j])
+				{
+					join_cols->csv2_key_pos[j] = n;
+				}
+				join_cols->count++;
+			}
+		}
+	}
+}
+
+/**
+ * PURPOSE: frees the arrays held by a Join_cols struct
+ * INPUT PARAMETERS:
+ *    join_cols: the Join_cols filled in by find_joined_cols
+ */
+void free_join_cols(Join_cols* join_cols)
+{
+	free(join_cols->names);
+	free(join_cols->csv1_index);
+	free(join_cols->csv2_index);
+	free(join_cols->csv1_key_pos);
+	free(join_cols->csv2_key_pos);
+	free(join_cols->key_types);
+	free(join_cols->key_scales);
+	free(join_cols->string_keys);
+}
+
+/**
+ * PURPOSE: adds a value to a Key_profile, narrowing down which types every value of a columb could be
+ * INPUT PARAMETERS:
+ *    profile: the profile of the columb, zeroed before its first value
+ *    value: the value to add
+ */
+void profile_key_value(Key_profile* profile, const char* value)
+{
+	int int_digits = 0;
+	int frac_digits = 0;
+
+	if (0 != strcmp(value, null))
+	{
+		if (0 == profile->count)
+		{
+			profile->is_number = 1;
+			profile->is_date = 1;
+		}
+		profile->count++;
+		if (profile->is_number && scan_number(value, &int_digits, &frac_digits))
+		{
+			profile->int_digits = (int_digits > profile->int_digits) ? int_digits : profile->int_digits;
+			profile->frac_digits = (frac_digits > profile->frac_digits) ? frac_digits : profile->frac_digits;
+		}
+		else
+		{
+			profile->is_number = 0;
+		}
+		profile->is_date = profile->is_date && INVALID_WORD != parse_key_word(value, KEY_DATE, 0);
+	}
+}
+
+/**
+ * PURPOSE: finds the type given with --key-type for columbs of a given name
+ * INPUT PARAMETERS:
+ *    name: name of the columb
+ * OUTPUT PARAMETERS:
+ *    returns the position of the type within key_type_names, or -1 if none was given
+ */
+int find_key_type(char* name)
+{
+	for (int t = 0; t < key_type_count; t++)
+	{
+		if (0 == strcmp(name, key_type_names[t]))
+		{
+			return t;
+		}
+	}
+	return -1;
+}
+
+/**
+ * PURPOSE: decides the type a joined columb is compared as from the profile of its csv2 values, unless --key-type gave one
+ * INPUT PARAMETERS:
+ *    profile: the profile of every value of the csv2 columb
+ *    name: name of the columb
+ *    scale: set to the digits after the decimal point a KEY_NUMBER columb is scaled by
+ * OUTPUT PARAMETERS:
+ *    returns KEY_NUMBER if every non null value is a number that fits, KEY_DATE if every one is an ISO date, otherwise KEY_TEXT
+ */
+int decide_key_type(Key_profile* profile, char* name, int* scale)
+{
+	int t = find_key_type(name);
+
+	*scale = profile->frac_digits;
+	if (-1 != t)
+	{
+		*scale = (0 <= key_type_scales[t]) ? key_type_scales[t] : profile->frac_digits;
+		return key_type_types[t];
+	}
+
+	if (0 < profile->count && profile->is_number && MAX_KEY_DIGITS >= profile->int_digits + profile->frac_digits)
+	{
+		return KEY_NUMBER;
+	}
+	*scale = 0;
+	return (0 < profile->count && profile->is_date) ? KEY_DATE : KEY_TEXT;
+}
+
+/**
+ * PURPOSE: works out the type a csv2 columb is compared as when joined on and converts each of its values to binary once,
+ *          a dictionary encoded columb only has each distinct value looked at
+ * INPUT PARAMETERS:
+ *    table: the table holding the columb
+ *    col: position of the columb within the table
+ * OUTPUT PARAMETERS:
+ *    sets the columb's key_type and key_scale, and fills its words unless it is KEY_TEXT. does nothing if already done
+ */
+void type_key_column(Csv_table* table, int col)
+{
+	Csv_column* column = &table->columns[col];
+	Key_profile profile;
+	int64_t* dict_words = NULL;
+
+	if (KEY_UNKNOWN != column->key_type)
+	{
+		return;
+	}
+
+	memset(&profile, 0, sizeof(Key_profile));
+	for (int i = 0; i < ((NULL != column->codes) ? column->dict_count : table->row_count); i++)
+	{
+		profile_key_value(&profile, (NULL != column->codes) ? column->data + column->dict_offsets[i] : column->data + column->offsets[i]);
+	}
+	column->key_type = decide_key_type(&profile, table->columbs[col], &column->key_scale);
+	if (KEY_TEXT == column->key_type)
+	{
+		return;
+	}
+
+	column->words = malloc(((size_t)table->row_count + 1) * sizeof(int64_t));
+	dict_words = (NULL != column->codes) ? malloc((column->dict_count + 1) * sizeof(int64_t)) : NULL;
+	assert(NULL != column->words && (NULL == column->codes || NULL != dict_words));
+	for (int code = 0; NULL != dict_words && code < column->dict_count; code++)
+	{
+		dict_words[code] = parse_key_word(column->data + column->dict_offsets[code], column->key_type, column->key_scale);
+	}
+	for (int l = 0; l < table->row_count; l++)
+	{
+		column->words[l] = (NULL != dict_words) ? dict_words[column->codes[l]]
+			: parse_key_word(column->data + column->offsets[l], column->key_type, column->key_scale);
+	}
+	free(dict_words);
+}
+
+/**
+ * PURPOSE: sets the type each shared columb is compared as, taken from the values csv2 holds in it
+ * INPUT PARAMETERS:
+ *    join_cols: the columbs shared by both csvs
+ *    csv2: the table holding all rows of csv2
+ * OUTPUT PARAMETERS:
+ *    fills the key_types, key_scales and string_keys of join_cols, converting the csv2 columbs compared as numbers or dates
+ *    to binary
+ */
+void find_key_types(Join_cols* join_cols, Csv_table* csv2)
+{
+	Csv_column* column = NULL;
+
+	join_cols->string_key_count = 0;
+	for (int n = 0; n < join_cols->count; n++)
+	{
+		type_key_column(csv2, join_cols->csv2_index[n]);
+		column = &csv2->columns[join_cols->csv2_index[n]];
+		join_cols->key_types[n] = column->key_type;
+		join_cols->key_scales[n] = column->key_scale;
+		if (KEY_TEXT == column->key_type && NULL == column->codes)
+		{
+			join_cols->string_keys[join_cols->string_key_count] = n;
+			join_cols->string_key_count++;
+		}
+	}
+}
+
+/**
+ * PURPOSE: hashes the values a row of a Csv_table holds in its joined columbs, using the hashes stored in the dictionary
+ *          of any dictionary encoded columb rather than rehashing the value
+ * INPUT PARAMETERS:
+ *    table: the table holding the row
+ *    row: position of the row within the table
+ *    key_cols: positions of the joined columbs within the table
+ *    key_count: number of items in key_cols
+ *    join_cols: the columbs shared by both csvs, giving the type each joined columb is compared as
+ *    null_codes: dictionary code of null in each joined columb, -1 if the columb is not dictionary encoded or lacks null
+ *    has_null: set to 1 if any of the key values is null or not of its columb's type, otherwise set to 0
+ *    words: key_count items set to the row's normalized key, which is only comparable to those of make_join_key for csv2
+ *           rows. may be NULL
+ * OUTPUT PARAMETERS:
+ *    returns the hash of the rows key, equal to the hash make_join_key gives the same values
+ */
+uint64_t hash_table_key(Csv_table* table, int row, int* key_cols, int key_count, Join_cols* join_cols, int* null_codes, int* has_null, int64_t* words)
+{
+	uint64_t hash = FNV_OFFSET;
+	uint64_t value_hash = 0;
+	Csv_column* column = NULL;
+	char* value = NULL;
+	int64_t word = 0;
+
+	*has_null = 0;
+	for (int n = 0; n < key_count; n++)
+	{
+		column = &table->columns[key_cols[n]];
+		if (KEY_TEXT != join_cols->key_types[n])
+		{
+			word = (NULL != column->words) ? column->words[row] : parse_key_word(csv_value(table, row, key_cols[n]), join_cols->key_types[n], join_cols->key_scales[n]);
+			value_hash = hash_word(word);
+			*has_null |= (INVALID_WORD == word);
+		}
+		else if (NULL != column->codes)
+		{
+			word = column->codes[row];
+			value_hash = column->dict_hashes[column->codes[row]];
+			*has_null |= (column->codes[row] == null_codes[n]);
+		}
+		else
+		{
+			value = column->data + column->offsets[row];
+			value_hash = hash_value(value);
+			word = (int64_t)value_hash;
+			*has_null |= (0 == strcmp(value, null));
+		}
+		hash = (hash ^ value_hash) * FNV_PRIME;
+		if (NULL != words)
+		{
+			words[n] = word;
+		}
+	}
+	return hash;
+}
+
+/**
+ * PURPOSE: frees a Join_index struct and everything it holds, apart from arrays mapped from an --index file, which are
+ *          unmapped with the table they were stored with
+ * INPUT PARAMETERS:
+ *    index: the index to be freed, may be NULL
+ */
+void free_join_index(Join_index* index)
+{
+	if (NULL != index)
+	{
+		for (int n = 0; n < index->key_count && NULL != index->csv1_codes; n++)
+		{
+			free(index->csv1_codes[n]);
+		}
+		free(index->csv1_codes);
+		free(index->csv1_null_codes);
+		free(index->csv2_null_codes);
+		if (!index->is_mapped)
+		{
+			free(index->buckets);
+			free(index->next);
+			free(index->hashes);
+			free(index->keys);
+			free(index->bloom);
+		}
+		free(index);
+	}
+}
+
+/**
+ * PURPOSE: maps the joined columbs that are dictionary encoded in both csvs from csv1 dictionary codes to the csv2 code of
+ *          the same value, so those columbs are compared as integers rather than strings, and finds the code of null in each
+ * INPUT PARAMETERS:
+ *    index: Join_index to fill in, with key_count set and the code arrays allocated
+ *    csv1: the table holding all rows of csv1, or NULL if csv1 is being streamed rather than loaded
+ *    csv2: the table holding all rows of csv2
+ *    join_cols: the columbs shared by both csvs
+ * OUTPUT PARAMETERS:
+ *    returns 1 on success or 0 if memory could not be allocated
+ */
+int map_join_codes(Join_index* index, Csv_table* csv1, Csv_table* csv2, Join_cols* join_cols)
+{
+	Csv_column* column1 = NULL;
+	Csv_column* column2 = NULL;
+	uint64_t null_hash = hash_value(null);
+	int is_valid = 1; //boolean
+
+	for (int n = 0; n < join_cols->count && is_valid; n++)
+	{
+		column2 = &csv2->columns[join_cols->csv2_index[n]];
+		column1 = (NULL != csv1) ? &csv1->columns[join_cols->csv1_index[n]] : NULL;
+		index->csv2_null_codes[n] = (NULL != column2->codes) ? dict_lookup(column2, null, null_hash) : -1;
+		index->csv1_null_codes[n] = (NULL != column1 && NULL != column1->codes) ? dict_lookup(column1, null, null_hash) : -1;
+
+		//columbs compared as numbers or dates are matched on their binary values rather than their dictionary codes
+		if (NULL != column1 && NULL != column1->codes && NULL != column2->codes && KEY_TEXT == join_cols->key_types[n])
+		{
+			index->csv1_codes[n] = malloc((column1->dict_count + 1) * sizeof(int));
+			is_valid = (NULL != index->csv1_codes[n]);
+			for (int code = 0; code < column1->dict_count && is_valid; code++)
+			{
+				index->csv1_codes[n][code] = dict_lookup(column2, column1->data + column1->dict_offsets[code], column1->dict_hashes[code]);
+			}
+		}
+	}
+	return is_valid;
+}
+
+/**
+ * PURPOSE: creates a Join_index holding only the code maps of the joined columbs, with no rows indexed yet
+ * INPUT PARAMETERS:
+ *    csv1: the table holding all rows of csv1, or NULL if csv1 is being streamed rather than loaded
+ *    csv2: the table holding all rows of csv2
+ *    join_cols: the columbs shared by both csvs
+ * OUTPUT PARAMETERS:
+ *    returns the new Join_index, or NULL if memory could not be allocated
+ */
+Join_index* new_join_index(Csv_table* csv1, Csv_table* csv2, Join_cols* join_cols)
+{
+	Join_index* index = calloc(1, sizeof(Join_index));
+
+	if (NULL != index)
+	{
+		index->key_count = join_cols->count;
+		index->csv1_codes = calloc(join_cols->count + 1, sizeof(int*));
+		index->csv1_null_codes = malloc((join_cols->count + 1) * sizeof(int));
+		index->csv2_null_codes = malloc((join_cols->count + 1) * sizeof(int));
+		if (NULL == index->csv1_codes || NULL == index->csv1_null_codes || NULL == index->csv2_null_codes
+			|| !map_join_codes(index, csv1, csv2, join_cols))
+		{
+			free_join_index(index);
+			index = NULL;
+		}
+	}
+	return index;
+}
+
+/**
+ * PURPOSE: gives the bits a key sets in its word of a Bloom filter, 4 bits chosen by the low bits of its hash
+ * INPUT PARAMETERS:
+ *    hash: the key's hash
+ * OUTPUT PARAMETERS:
+ *    returns a word with the key's bits set
+ */
+uint64_t bloom_bits(uint64_t hash)
+{
+	return (1ULL << (hash & 63)) | (1ULL << ((hash >> 6) & 63)) | (1ULL << ((hash >> 12) & 63)) | (1ULL << ((hash >> 18) & 63));
+}
+
+/**
+ * PURPOSE: checks a key against the Bloom filter of a Join_index, which only needs the one word of the filter the key
+ *          falls in
+ * INPUT PARAMETERS:
+ *    index: the index, whose bloom must not be NULL
+ *    hash: the key's hash
+ * OUTPUT PARAMETERS:
+ *    returns 0 if no entry of the index can have the key, 1 if one might
+ */
+int bloom_may_contain(Join_index* index, uint64_t hash)
+{
+	uint64_t bits = bloom_bits(hash);
+
+	return bits == (index->bloom[(hash >> BLOOM_WORD_SHIFT) & index->bloom_mask] & bits);
+}
+
+/**
+ * PURPOSE: chains csv2 rows into the buckets of a Join_index by the hash of their keys
+ * INPUT PARAMETERS:
+ *    index: the index to fill in, any rows it already held are replaced
+ *    rows: csv2 row of each entry, kept by the index rather than copied, or NULL if entry l is csv2 row l
+ *    row_count: number of entries to index
+ *    hashes: key hash of each entry as given by hash_table_key
+ *    has_null: boolean for each entry, 1 if its key holds a null
+ *    keys: normalized key of every csv2 row as given by hash_table_key, key_count words per row, looked up by row rather than
+ *          by entry. each entry's key is copied next to those of the other entries
+ *    key_count: number of joined columbs
+ * OUTPUT PARAMETERS:
+ *    returns 1 on success or 0 if memory could not be allocated. builds the index's Bloom filter too if --bloom is set.
+ *    entries with a null key value are left out of the chains since null never matches anything
+ */
+int chain_join_rows(Join_index* index, int* rows, int row_count, uint64_t* hashes, char* has_null, int64_t* keys, int key_count)
+{
+	uint64_t bucket_count = 16;
+	uint64_t bucket = 0;
+	uint64_t bloom_count = 1;
+	long null_keys = 0;
+
+	while (bucket_count < (uint64_t)row_count * 2)
+	{
+		bucket_count *= 2;
+	}
+	while (use_bloom && bloom_count * BLOOM_KEYS_PER_WORD < (uint64_t)row_count)
+	{
+		bloom_count *= 2;
+	}
+
+	free(index->buckets);
+	free(index->next);
+	free(index->hashes);
+	free(index->keys);
+	free(index->bloom);
+	index->mask = bucket_count - 1;
+	index->rows = rows;
+	index->buckets = malloc(bucket_count * sizeof(int));
+	index->next = malloc((row_count + 1) * sizeof(int));
+	index->hashes = malloc((row_count + 1) * sizeof(uint64_t));
+	index->keys = malloc(((size_t)row_count * key_count + 1) * sizeof(int64_t));
+	index->bloom = use_bloom ? calloc(bloom_count, sizeof(uint64_t)) : NULL;
+	index->bloom_mask = bloom_count - 1;
+	if (NULL == index->buckets || NULL == index->next || NULL == index->hashes || NULL == index->keys || (use_bloom && NULL == index->bloom))
+	{
+		return 0;
+	}
+
+	for (uint64_t i = 0; i < bucket_count; i++)
+	{
+		index->buckets[i] = -1;
+	}
+
+	//entries are inserted last to first so each chain lists its rows in the order they appear in csv2
+	for (int l = row_count - 1; l >= 0; l--)
+	{
+		index->next[l] = -1;
+		index->hashes[l] = hashes[l];
+		memcpy(&index->keys[(size_t)l * key_count], &keys[(size_t)((NULL != rows) ? rows[l] : l) * key_count], key_count * sizeof(int64_t));
+		if (!has_null[l])
+		{
+			bucket = hashes[l] & index->mask;
+			index->next[l] = index->buckets[bucket];
+			index->buckets[bucket] = l;
+			if (NULL != index->bloom)
+			{
+				index->bloom[(hashes[l] >> BLOOM_WORD_SHIFT) & index->bloom_mask] |= bloom_bits(hashes[l]);
+			}
+		}
+		null_keys += has_null[l];
+	}
+	count_stat(&stats.null_keys, null_keys);
+	return 1;
+}
+
+/**
+ * PURPOSE: builds a hash table over the joined columbs of every csv2 row so matching rows can be found without scanning csv2.
+ *          for every joined columb that is dictionary encoded in both csvs it also maps each csv1 dictionary code to the
+ *          csv2 code of the same value, so those columbs are compared as integers rather than strings
+ * INPUT PARAMETERS:
+ *    csv1: the table holding all rows of csv1, or NULL if csv1 is being streamed rather than loaded
+ *    csv2: the table holding all rows of csv2
+ *    join_cols: the columbs shared by both csvs
+ * OUTPUT PARAMETERS:
+ *    returns a Join_index struct over the rows of csv2, or NULL if memory could not be allocated.
+ *    rows with a null key value are left out of the index since null never matches anything
+ */
+Join_index* build_join_index(Csv_table* csv1, Csv_table* csv2, Join_cols* join_cols)
+{
+	Join_index* index = new_join_index(csv1, csv2, join_cols);
+	uint64_t* hashes = malloc((csv2->row_count + 1) * sizeof(uint64_t));
+	char* has_null = malloc((csv2->row_count + 1) * sizeof(char));
+	int64_t* keys = malloc(((size_t)csv2->row_count * join_cols->count + 1) * sizeof(int64_t));
+	int row_has_null = 0;
+
+	if (NULL != index && NULL != hashes && NULL != has_null && NULL != keys)
+	{
+		for (int l = 0; l < csv2->row_count; l++)
+		{
+			hashes[l] = hash_table_key(csv2, l, join_cols->csv2_index, join_cols->count, join_cols, index->csv2_null_codes, &row_has_null,
+				&keys[(size_t)l * join_cols->count]);
+			has_null[l] = (char)row_has_null;
+		}
+	}
+	if (NULL == hashes || NULL == has_null || NULL == keys
+		|| (NULL != index && !chain_join_rows(index, NULL, csv2->row_count, hashes, has_null, keys, join_cols->count)))
+	{
+		free_join_index(index);
+		index = NULL;
+	}
+
+	free(hashes);
+	free(has_null);
+	free(keys);
+	return index;
+}
+
+/**
+ * PURPOSE: allocates the arrays of a Join_key
+ * INPUT PARAMETERS:
+ *    key: Join_key struct to be set up
+ *    key_count: number of joined columbs the key holds
+ */
+void init_join_key(Join_key* key, int key_count)
+{
+	key->values = malloc((key_count + 1) * sizeof(char*));
+	key->words = malloc((key_count + 1) * sizeof(int64_t));
+	key->comparisons = 0;
+	key->matches = 0;
+	key->null_keys = 0;
+	key->bloom_rejects = 0;
+	assert(NULL != key->values && NULL != key->words);
+}
+
+/**
+ * PURPOSE: frees the arrays of a Join_key, adding the comparisons and matches made with it to the run's stats
+ * INPUT PARAMETERS:
+ *    key: Join_key set up by init_join_key
+ */
+void free_join_key(Join_key* key)
+{
+	count_stat(&stats.key_comparisons, key->comparisons);
+	count_stat(&stats.matches, key->matches);
+	count_stat(&stats.null_keys, key->null_keys);
+	count_stat(&stats.bloom_rejects, key->bloom_rejects);
+	free(key->values);
+	free(key->words);
+}
+
+/**
+ * PURPOSE: prepares the key of a csv1 row for probing a Join_index, normalizing it the same way as the keys of the
+ *          index's csv2 rows so a match needs only their hashes and one memcmp
+ * INPUT PARAMETERS:
+ *    key: Join_key struct to be filled in
+ *    index: Join_index built over csv2
+ *    csv2: the table holding all rows of csv2
+ *    join_cols: the columbs shared by both csvs
+ *    csv1_values: value of each columb of the csv1 row
+ *    csv1: the table holding the csv1 row so its dictionary codes can be used, or NULL if the row was streamed
+ *    csv1_row: position of the row within csv1, ignored if csv1 is NULL
+ * OUTPUT PARAMETERS:
+ *    fills key with the row's key values, their hash and their normalized key
+ */
+void make_join_key(Join_key* key, Join_index* index, Csv_table* csv2, Join_cols* join_cols, char** csv1_values, Csv_table* csv1, int csv1_row)
+{
+	Csv_column* column1 = NULL;
+	Csv_column* column2 = NULL;
+	uint64_t value_hash = 0;
+	int code1 = -1;
+
+	key->hash = FNV_OFFSET;
+	key->has_null = 0;
+	key->is_absent = 0;
+	for (int n = 0; n < join_cols->count; n++)
+	{
+		column1 = (NULL != csv1) ? &csv1->columns[join_cols->csv1_index[n]] : NULL;
+		column2 = &csv2->columns[join_cols->csv2_index[n]];
+		key->values[n] = csv1_values[join_cols->csv1_index[n]];
+
+		if (KEY_TEXT != join_cols->key_types[n])
+		{
+			//a value that is not of the columb's type cannot equal any csv2 value, which all are
+			key->words[n] = parse_key_word(key->values[n], join_cols->key_types[n], join_cols->key_scales[n]);
+			value_hash = hash_word(key->words[n]);
+			key->has_null |= (0 == strcmp(key->values[n], null));
+			key->is_absent |= (INVALID_WORD == key->words[n]);
+		}
+		else
+		{
+			if (NULL != column1 && NULL != column1->codes)
+			{
+				code1 = column1->codes[csv1_row];
+				value_hash = column1->dict_hashes[code1];
+				key->has_null |= (code1 == index->csv1_null_codes[n]);
+			}
+			else
+			{
+				value_hash = hash_value(key->values[n]);
+				key->has_null |= (0 == strcmp(key->values[n], null));
+			}
+
+			key->words[n] = (int64_t)value_hash;
+			if (NULL != column2->codes)
+			{
+				key->words[n] = (NULL != index->csv1_codes[n]) ? index->csv1_codes[n][code1] : dict_lookup(column2, key->values[n], value_hash);
+				key->is_absent |= (-1 == key->words[n]);
+			}
+		}
+		key->hash = (key->hash ^ value_hash) * FNV_PRIME;
+	}
+}
+
+/**
+ * PURPOSE: finds the next csv2 row whose joined columbs hold the same values as a csv1 row
+ * INPUT PARAMETERS:
+ *    index: Join_index built over csv2
+ *    csv2: the table holding all rows of csv2
+ *    key: the key of the csv1 row as prepared by make_join_key
+ *    join_cols: the columbs shared by both csvs
+ *    prev_match: the previous match returned for the csv1 row, or -1 to find the first match
+ * OUTPUT PARAMETERS:
+ *    returns the index entry of the next matching csv2 row, or -1 if there are no more matches. the entry is the csv2 row
+ *    itself unless the index has a rows array mapping entries to rows. matches are returned in the order they appear in csv2
+ */
+int find_join_match(Join_index* index, Csv_table* csv2, Join_key* key, Join_cols* join_cols, int prev_match)
+{
+	int l = (-1 == prev_match) ? index->buckets[key->hash & index->mask] : index->next[prev_match];
+	int row = 0;
+	int is_match = 0;
+	int n = 0;
+	size_t key_size = join_cols->count * sizeof(int64_t);
+	Csv_column* column2 = NULL;
+
+	//the filter is far smaller than the buckets and chains, so a key it turns away costs one word from cache
+	if (-1 == prev_match && NULL != index->bloom && !bloom_may_contain(index, key->hash))
+	{
+		key->bloom_rejects++;
+		return -1;
+	}
+
+	while (-1 != l && !is_match)
+	{
+		is_match = (index->hashes[l] == key->hash && 0 == memcmp(&index->keys[(size_t)l * join_cols->count], key->words, key_size));
+		key->comparisons++;
+
+		//only the hashes of columbs csv2 holds without a dictionary are in the normalized key, so their strings are checked too
+		for (int i = 0; i < join_cols->string_key_count && is_match; i++)
+		{
+			n = join_cols->string_keys[i];
+			row = (NULL != index->rows) ? index->rows[l] : l;
+			column2 = &csv2->columns[join_cols->csv2_index[n]];
+			is_match = (0 == strcmp(key->values[n], column2->data + column2->offsets[row]));
+		}
+		if (!is_match)
+		{
+			l = index->next[l];
+		}
+	}
+	return l;
+}
+
+/**
+ * PURPOSE: writes a block of bytes straight to a file descriptor, retrying until all of it is written
+ * INPUT PARAMETERS:
+ *    fd: file descriptor to write to
+ *    parts: the blocks of bytes to write, in order
+ *    part_count: number of items in parts
+ * OUTPUT PARAMETERS:
+ *    writes every byte of parts to fd, exiting the program if the file cannot be written to
+ */
+void write_all(int fd, struct iovec* parts, int part_count)
+{
+	ssize_t written = 0;
+	double start = show_stats ? now_seconds() : 0;
+
+	while (0 < part_count)
+	{
+		written = writev(fd, parts, part_count);
+		if (0 > written && EINTR == errno)
+		{
+			continue;
+		}
+		if (0 > written)
+		{
+			fprintf(stderr, "Unable to write to an output file.\n");
+			exit(EXIT_FAILURE);
+		}
+		count_stat(&stats.bytes_written, (long)written);
+
+		//skips past whatever was written, which may end part way through a block
+		while (0 < part_count && (size_t)written >= parts->iov_len)
+		{
+			written -= (ssize_t)parts->iov_len;
+			parts++;
+			part_count--;
+		}
+		if (0 < part_count)
+		{
+			parts->iov_base = (char*)parts->iov_base + written;
+			parts->iov_len -= (size_t)written;
+		}
+	}
+	count_stat(&stats.write_nanoseconds, show_stats ? (long)((now_seconds() - start) * 1e9) : 0);
+}
+
+/**
+ * PURPOSE: writes out the compressed bytes gathered in a Csv_writer's packed buffer
+ * INPUT PARAMETERS:
+ *    writer: the writer, its output compressed
+ *    size: number of bytes at the start of packed
+ */
+void write_packed_bytes(Csv_writer* writer, size_t size)
+{
+	struct iovec part;
+
+	if (0 == size)
+	{
+		return;
+	}
+	part.iov_base = writer->packed;
+	part.iov_len = size;
+	write_all(writer->fd, &part, 1);
+	writer->written += (off_t)size;
+}
+
+/**
+ * PURPOSE: compresses bytes of a Csv_writer's output, writing the compressed bytes out each time its packed buffer fills
+ * INPUT PARAMETERS:
+ *    writer: the writer, its output compressed
+ *    data: the bytes to compress, may be NULL if size is 0
+ *    size: number of bytes in data
+ *    is_end: boolean, 1 to end the compressed stream, which can then have nothing more written to it. data must be empty
+ * OUTPUT PARAMETERS:
+ *    exits the program if the bytes cannot be compressed
+ */
+void pack_csv_bytes(Csv_writer* writer, const char* data, size_t size, int is_end)
+{
+	int is_failed = 0; //boolean
+#ifdef HAVE_ZLIB
+	int result = Z_OK;
+#endif
+#ifdef HAVE_ZSTD
+	ZSTD_inBuffer in = { data, size, 0 };
+	ZSTD_outBuffer out = { writer->packed, WRITE_BUFFER_SIZE, 0 };
+	size_t remaining = 0;
+#endif
+#if !defined(HAVE_ZLIB) && !defined(HAVE_ZSTD)
+	//a build without either library never has a compressed output to write to
+	(void)writer;
+	(void)data;
+	(void)size;
+	(void)is_end;
+#endif
+
+#ifdef HAVE_ZLIB
+	if (NULL != writer->gzip)
+	{
+		writer->gzip->next_in = (Bytef*)data;
+		writer->gzip->avail_in = (uInt)size;
+		do
+		{
+			writer->gzip->next_out = (Bytef*)writer->packed;
+			writer->gzip->avail_out = WRITE_BUFFER_SIZE;
+			result = deflate(writer->gzip, is_end ? Z_FINISH : Z_NO_FLUSH);
+			is_failed = (Z_STREAM_ERROR == result);
+			write_packed_bytes(writer, WRITE_BUFFER_SIZE - writer->gzip->avail_out);
+		} while (!is_failed && (is_end ? Z_STREAM_END != result : 0 == writer->gzip->avail_out));
+	}
+#endif
+#ifdef HAVE_ZSTD
+	//zstd keeps compressing until everything given is taken in, and on ending until nothing remains to be written
+	while (NULL != writer->zstd && !is_failed && (is_end || in.pos < in.size))
+	{
+		out.pos = 0;
+		remaining = is_end ? ZSTD_endStream(writer->zstd, &out) : ZSTD_compressStream(writer->zstd, &out, &in);
+		is_failed = ZSTD_isError(remaining);
+		write_packed_bytes(writer, is_failed ? 0 : out.pos);
+		is_end = is_end && !is_failed && 0 < remaining;
+	}
+#endif
+	if (is_failed)
+	{
+		fprintf(stderr, "Unable to compress an output file.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * PURPOSE: writes out the rows buffered in a Csv_writer. a direct writer only writes whole WRITE_ALIGNMENT blocks
+ *          until it is closed, keeping any partial block at the start of its buffer
+ * INPUT PARAMETERS:
+ *    writer: the writer to flush
+ *    extra: bytes to write after the buffer without copying them into it, ignored by a direct writer, may be NULL
+ *    extra_size: number of bytes in extra
+ */
+void flush_csv_writer(Csv_writer* writer, const char* extra, size_t extra_size)
+{
+	struct iovec parts[2];
+	size_t flushed = writer->is_direct ? writer->used / WRITE_ALIGNMENT * WRITE_ALIGNMENT : writer->used;
+
+	//a writer without a file keeps everything, so its buffer is doubled instead
+	if (-1 == writer->fd)
+	{
+		writer->capacity *= 2;
+		writer->buffer = realloc(writer->buffer, writer->capacity);
+		assert(NULL != writer->buffer);
+		count_stat(&stats.allocations, 1);
+		return;
+	}
+
+#ifdef __linux__
+	//reserves the file's blocks well ahead of the writes so a large output is laid out contiguously
+	if (writer->is_direct && writer->allocated < writer->written + (off_t)flushed)
+	{
+		fallocate(writer->fd, FALLOC_FL_KEEP_SIZE, writer->allocated, FALLOCATE_BYTES);
+		writer->allocated += FALLOCATE_BYTES;
+	}
+#endif
+
+	parts[0].iov_base = writer->buffer;
+	parts[0].iov_len = flushed;
+	parts[1].iov_base = (void*)extra;
+	parts[1].iov_len = (NULL != extra && !writer->is_direct) ? extra_size : 0;
+	if (NULL != writer->packed)
+	{
+		pack_csv_bytes(writer, parts[0].iov_base, parts[0].iov_len, 0);
+		pack_csv_bytes(writer, parts[1].iov_base, parts[1].iov_len, 0);
+	}
+	else
+	{
+		write_all(writer->fd, parts, 2);
+		writer->written += (off_t)(parts[0].iov_len + parts[1].iov_len);
+	}
+
+	memmove(writer->buffer, writer->buffer + flushed, writer->used - flushed);
+	writer->used -= flushed;
+}
+
+/**
+ * PURPOSE: wraps a file descriptor in a Csv_writer which gathers rows in a buffer of a given size and writes them out in bulk
+ * INPUT PARAMETERS:
+ *    fd: file descriptor to write to, the writer takes ownership of it and closes it in close_csv_writer.
+ *        -1 creates a writer that gathers rows in memory until they are handed to another writer with put_csv_bytes
+ *    is_direct: boolean, 1 if fd was opened with O_DIRECT so every write must be a whole number of aligned blocks
+ *    capacity: bytes of the buffer, a multiple of WRITE_ALIGNMENT
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_writer with an empty buffer
+ */
+Csv_writer* new_sized_csv_writer(int fd, int is_direct, size_t capacity)
+{
+	Csv_writer* writer = calloc(1, sizeof(Csv_writer));
+	void* buffer = NULL;
+
+	if (0 != posix_memalign(&buffer, WRITE_ALIGNMENT, capacity))
+	{
+		buffer = NULL;
+	}
+	assert(NULL != writer && NULL != buffer);
+	count_stat(&stats.allocations, 2);
+	writer->fd = fd;
+	writer->buffer = buffer;
+	writer->capacity = capacity;
+	writer->is_direct = is_direct;
+	return writer;
+}
+
+/**
+ * PURPOSE: wraps a file descriptor in a Csv_writer which gathers rows in a large buffer and writes them out in bulk
+ * INPUT PARAMETERS:
+ *    fd: file descriptor to write to, the writer takes ownership of it and closes it in close_csv_writer.
+ *        -1 creates a writer that gathers rows in memory until they are handed to another writer with put_csv_bytes
+ *    is_direct: boolean, 1 if fd was opened with O_DIRECT so every write must be a whole number of aligned blocks
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_writer with an empty buffer of WRITE_BUFFER_SIZE
+ */
+Csv_writer* new_csv_writer(int fd, int is_direct)
+{
+	return new_sized_csv_writer(fd, is_direct, WRITE_BUFFER_SIZE);
+}
+
+/**
+ * PURPOSE: sets a Csv_writer up to compress everything it writes
+ * INPUT PARAMETERS:
+ *    writer: the writer, nothing written to it yet
+ *    format: FORMAT_GZIP or FORMAT_ZSTD
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the writer now compresses its output, or 0 if this build cannot write the format
+ */
+int pack_csv_writer(Csv_writer* writer, int format)
+{
+	int is_packed = 0; //boolean
+
+	writer->packed = malloc(WRITE_BUFFER_SIZE);
+	assert(NULL != writer->packed);
+#ifdef HAVE_ZLIB
+	if (FORMAT_GZIP == format)
+	{
+		writer->gzip = calloc(1, sizeof(z_stream));
+		assert(NULL != writer->gzip);
+		//15 + 16 takes the largest window and writes a gzip header rather than a zlib one
+		is_packed = (Z_OK == deflateInit2(writer->gzip, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY));
+	}
+#endif
+#ifdef HAVE_ZSTD
+	if (FORMAT_ZSTD == format)
+	{
+		writer->zstd = ZSTD_createCStream();
+		is_packed = (NULL != writer->zstd && !ZSTD_isError(ZSTD_initCStream(writer->zstd, ZSTD_LEVEL)));
+	}
+#endif
+#if !defined(HAVE_ZLIB) && !defined(HAVE_ZSTD)
+	(void)format;
+#endif
+	return is_packed;
+}
+
+/**
+ * PURPOSE: creates an output file and a Csv_writer for it. a file named .gz or .zst is compressed with gzip or zstd
+ * INPUT PARAMETERS:
+ *    filename: name of the file to create, any existing file is replaced. "-" writes to stdout
+ *    is_direct: boolean, 1 to write around the page cache with O_DIRECT where the file system allows it, ignored for a
+ *               compressed file
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_writer for the file, or NULL if it could not be created. exits the program if the file is to be
+ *    compressed in a format this build cannot write
+ */
+Csv_writer* open_csv_writer(char* filename, int is_direct)
+{
+	int fd = -1;
+	int format = compression_of_name(filename);
+	Csv_writer* writer = NULL;
+
+	if (0 == strcmp(filename, "-"))
+	{
+		return new_csv_writer(STDOUT_FILENO, 0);
+	}
+#ifdef O_DIRECT
+	if (is_direct && FORMAT_PLAIN == format)
+	{
+		fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+	}
+#endif
+	//falls back to buffered writes if O_DIRECT is unavailable or the file system refuses it
+	if (-1 == fd)
+	{
+		is_direct = 0;
+		fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	writer = (-1 != fd) ? new_csv_writer(fd, is_direct) : NULL;
+	if (NULL != writer && FORMAT_PLAIN != format && !pack_csv_writer(writer, format))
+	{
+		fprintf(stderr, "Unable to write %s, csv_merge was built without %s.\n", filename, (FORMAT_GZIP == format) ? "gzip" : "zstd");
+		exit(EXIT_FAILURE);
+	}
+	return writer;
+}
+
+/**
+ * PURPOSE: writes out everything left in a Csv_writer, closes its file and frees it
+ * INPUT PARAMETERS:
+ *    writer: the writer to close, may be NULL
+ */
+void close_csv_writer(Csv_writer* writer)
+{
+	if (NULL != writer && -1 != writer->fd)
+	{
+		flush_csv_writer(writer, NULL, 0);
+
+#ifdef O_DIRECT
+		//the last partial block can only be written once O_DIRECT is turned off
+		if (writer->is_direct && 0 < writer->used)
+		{
+			fcntl(writer->fd, F_SETFL, fcntl(writer->fd, F_GETFL) & ~O_DIRECT);
+			writer->is_direct = 0;
+			flush_csv_writer(writer, NULL, 0);
+		}
+#endif
+		if (NULL != writer->packed)
+		{
+			pack_csv_bytes(writer, NULL, 0, 1);
+		}
+		//hands back any blocks reserved past the end of the output
+		if (writer->allocated > writer->written)
+		{
+			ftruncate(writer->fd, writer->written);
+		}
+		close(writer->fd);
+	}
+	if (NULL != writer)
+	{
+#ifdef HAVE_ZLIB
+		if (NULL != writer->gzip)
+		{
+			deflateEnd(writer->gzip);
+			free(writer->gzip);
+		}
+#endif
+#ifdef HAVE_ZSTD
+		ZSTD_freeCStream(writer->zstd);
+#endif
+		free(writer->packed);
+		free(writer->buffer);
+		free(writer);
+	}
+}
+
+/**
+ * PURPOSE: appends bytes to a Csv_writer's buffer, writing the buffer out when it fills
+ * INPUT PARAMETERS:
+ *    writer: the writer to append to
+ *    data: the bytes to append
+ *    size: number of bytes in data
+ */
+void put_csv_bytes(Csv_writer* writer, const char* data, size_t size)
+{
+	size_t part = 0;
+
+	if (size <= writer->capacity - writer->used)
+	{
+		memcpy(writer->buffer + writer->used, data, size);
+		writer->used += size;
+		return;
+	}
+
+	//a value bigger than the buffer is written straight from where it is rather than copied
+	if (!writer->is_direct && -1 != writer->fd && writer->capacity <= size)
+	{
+		flush_csv_writer(writer, data, size);
+		return;
+	}
+
+	while (0 < size)
+	{
+		if (writer->capacity == writer->used)
+		{
+			flush_csv_writer(writer, NULL, 0);
+		}
+		part = (size < writer->capacity - writer->used) ? size : writer->capacity - writer->used;
+		memcpy(writer->buffer + writer->used, data, part);
+		writer->used += part;
+		data += part;
+		size -= part;
+	}
+}
+
+/**
+ * PURPOSE: appends a single character to a Csv_writer's buffer
+ * INPUT PARAMETERS:
+ *    writer: the writer to append to
+ *    c: the character to append
+ */
+void put_csv_char(Csv_writer* writer, char c)
+{
+	if (writer->capacity == writer->used)
+	{
+		flush_csv_writer(writer, NULL, 0);
+	}
+	writer->buffer[writer->used] = c;
+	writer->used++;
+}
+
+/**
+ * PURPOSE: writes a single value to a csv, quoting it if it holds a comma, quote or line break so it reads back as the same
+ *          value. an empty value that is alone on its line is quoted too so the line is not read back as a blank line
+ * INPUT PARAMETERS:
+ *    output: writer to write the value to
+ *    value: the value to write
+ *    is_only_value: boolean, 1 if the value is the only one on its line
+ * OUTPUT PARAMETERS:
+ *    appends the value to output
+ */
+void write_csv_field(Csv_writer* output, char* value, int is_only_value)
+{
+	if (NULL == strpbrk(value, ",\"\r\n") && !(is_only_value && '\0' == value[0]))
+	{
+		put_csv_bytes(output, value, strlen(value));
+		return;
+	}
+
+	put_csv_char(output, '"');
+	for (char* c = value; '\0' != *c; c++)
+	{
+		if ('"' == *c)
+		{
+			put_csv_char(output, '"');
+		}
+		put_csv_char(output, *c);
+	}
+	put_csv_char(output, '"');
+}
+
+/**
+ * PURPOSE: writes a single row of values to an output csv
+ * INPUT PARAMETERS:
+ *    output: writer to write the row to
+ *    values: the value of each columb in the row
+ *    values_size: number of items in values
+ *    is_header: 1 if this is the first line of the file, otherwise the row is started on a new line
+ * OUTPUT PARAMETERS:
+ *    appends the row to output
+ */
+void write_csv_values(Csv_writer* output, char** values, int values_size, int is_header)
+{
+	if (!is_header)
+	{
+		put_csv_char(output, '\n');
+	}
+	for (int j = 0; j < values_size; j++)
+	{
+		write_csv_field(output, values[j], 1 == values_size);
+		if (j < values_size - 1)
+		{
+			put_csv_char(output, ',');
+		}
+	}
+}
+
+/**
+ * PURPOSE: collects the values of a natural join output row, being the unshared columbs of csv1, then those of csv2, then the shared columbs
+ * INPUT PARAMETERS:
+ *    csv1_values: value of each columb of the csv1 row (or the csv1 columb names when building the header)
+ *    csv1_col_count: number of columbs csv1 containes
+ *    csv2_values: value of each columb of the matching csv2 row (or the csv2 columb names)
+ *    csv2_col_count: number of columbs csv2 containes
+ *    join_cols: the columbs shared by both csvs
+ *    values: array to put the output row's values in
+ * OUTPUT PARAMETERS:
+ *    returns the number of items put in values
+ */
+int fill_natural_values(char** csv1_values, int csv1_col_count, char** csv2_values, int csv2_col_count, Join_cols* join_cols, char** values)
+{
+	int values_size = 0;
+
+	for (int m = 0; m < csv1_col_count; m++)
+	{
+		if (-1 == join_cols->csv1_key_pos[m])
+		{
+			values[values_size] = csv1_values[m];
+			values_size++;
+		}
+	}
+	for (int m = 0; m < csv2_col_count; m++)
+	{
+		if (-1 == join_cols->csv2_key_pos[m])
+		{
+			values[values_size] = csv2_values[m];
+			values_size++;
+		}
+	}
+	for (int n = 0; n < join_cols->count; n++)
+	{
+		values[values_size] = csv1_values[join_cols->csv1_index[n]];
+		values_size++;
+	}
+	return values_size;
+}
+
+/**
+ * PURPOSE: collects the values of a left or full outer join output row, being every columb of csv1 followed by the unshared columbs of csv2
+ * INPUT PARAMETERS:
+ *    csv1_values: value of each columb of the csv1 row (or the csv1 columb names), NULL if the csv2 row has no csv1 counterpart
+ *    csv1_col_count: number of columbs csv1 containes
+ *    csv2_values: value of each columb of the csv2 row (or the csv2 columb names), NULL if the csv1 row has no csv2 counterpart
+ *    csv2_col_count: number of columbs csv2 containes
+ *    join_cols: the columbs shared by both csvs
+ *    values: array to put the output row's values in
+ * OUTPUT PARAMETERS:
+ *    returns the number of items put in values, the missing side of an unmatched row is filled with null
+ *    except for the shared columbs which are taken from csv2
+ */
+int fill_outer_values(char** csv1_values, int csv1_col_count, char** csv2_values, int csv2_col_count, Join_cols* join_cols, char** values)
+{
+	int values_size = 0;
+	int key_pos = -1;
+
+	for (int m = 0; m < csv1_col_count; m++)
+	{
+		key_pos = join_cols->csv1_key_pos[m];
+		if (NULL != csv1_values)
+		{
+			values[values_size] = csv1_values[m];
+		}
+		else
+		{
+			values[values_size] = (-1 != key_pos) ? csv2_values[join_cols->csv2_index[key_pos]] : null;
+		}
+		values_size++;
+	}
+	for (int m = 0; m < csv2_col_count; m++)
+	{
+		if (-1 == join_cols->csv2_key_pos[m])
+		{
+			values[values_size] = (NULL != csv2_values) ? csv2_values[m] : null;
+			values_size++;
+		}
+	}
+	return values_size;
+}
+
+/**
+ * PURPOSE: sets up a Join_outputs struct with no outputs open and allocates its scratch space
+ * INPUT PARAMETERS:
+ *    outputs: Join_outputs struct to be filled in
+ *    csv1_col_count: number of columbs csv1 containes
+ *    csv2_col_count: number of columbs csv2 containes
+ *    join_cols: the columbs shared by both csvs
+ */
+void init_join_outputs(Join_outputs* outputs, int csv1_col_count, int csv2_col_count, Join_cols* join_cols)
+{
+	outputs->natural = NULL;
+	outputs->left = NULL;
+	outputs->full_outer = NULL;
+	outputs->join_cols = join_cols;
+	outputs->csv1_col_count = csv1_col_count;
+	outputs->csv2_col_count = csv2_col_count;
+
+	//no output row has more values than both csvs' columbs plus each shared columb once more
+	outputs->values = malloc((csv1_col_count + csv2_col_count + join_cols->count + 1) * sizeof(char*));
+	outputs->csv2_values = malloc((csv2_col_count + 1) * sizeof(char*));
+	assert(NULL != outputs->values && NULL != outputs->csv2_values);
+}
+
+/**
+ * PURPOSE: creates the output file of every requested join and prints the columbs to each
+ * INPUT PARAMETERS:
+ *    outputs: Join_outputs struct to be filled in
+ *    join_types: JOIN_NATURAL, JOIN_LEFT and JOIN_FULL_OUTER or'ed together to select which output files are created
+ *    csv1_names: the names of the columbs in csv1
+ *    csv1_col_count: number of columbs csv1 containes
+ *    csv2_names: the names of the columbs in csv2
+ *    csv2_col_count: number of columbs csv2 containes
+ *    join_cols: the columbs shared by both csvs
+ * OUTPUT PARAMETERS:
+ *    creates the output file of each requested join, named by natural_output, left_output and full_outer_output.
+ *    the file of any join that was not requested is left as NULL in outputs
+ */
+void open_join_outputs(Join_outputs* outputs, int join_types, char** csv1_names, int csv1_col_count, char** csv2_names, int csv2_col_count, Join_cols* join_cols)
+{
+	char** values = NULL;
+	int values_size = 0;
+
+	init_join_outputs(outputs, csv1_col_count, csv2_col_count, join_cols);
+	values = outputs->values;
+
+	if (join_types & JOIN_NATURAL)
+	{
+		outputs->natural = open_csv_writer(natural_output, direct_io);
+		if (NULL == outputs->natural)
+		{
+			fprintf(stderr, "Unable to create %s.\n", natural_output);
+			exit(EXIT_FAILURE);
+		}
+		values_size = fill_natural_values(csv1_names, csv1_col_count, csv2_names, csv2_col_count, join_cols, values);
+		write_csv_values(outputs->natural, values, values_size, 1);
+	}
+	if (join_types & JOIN_LEFT)
+	{
+		outputs->left = open_csv_writer(left_output, direct_io);
+		if (NULL == outputs->left)
+		{
+			fprintf(stderr, "Unable to create %s.\n", left_output);
+			exit(EXIT_FAILURE);
+		}
+		values_size = fill_outer_values(csv1_names, csv1_col_count, csv2_names, csv2_col_count, join_cols, values);
+		write_csv_values(outputs->left, values, values_size, 1);
+	}
+	if (join_types & JOIN_FULL_OUTER)
+	{
+		outputs->full_outer = open_csv_writer(full_outer_output, direct_io);
+		if (NULL == outputs->full_outer)
+		{
+			fprintf(stderr, "Unable to create %s.\n", full_outer_output);
+			exit(EXIT_FAILURE);
+		}
+		values_size = fill_outer_values(csv1_names, csv1_col_count, csv2_names, csv2_col_count, join_cols, values);
+		write_csv_values(outputs->full_outer, values, values_size, 1);
+	}
+}
+
+/**
+ * PURPOSE: writes a matching pair of rows to every open join output
+ * INPUT PARAMETERS:
+ *    outputs: the open join outputs
+ *    csv1_values: value of each columb of the csv1 row
+ *    csv2_values: value of each columb of the csv2 row it matched
+ *    is_first_match: 1 if this is the first csv2 row the csv1 row has matched, left join only keeps the first match
+ * OUTPUT PARAMETERS:
+ *    appends the joined row to the natural and full outer outputs, and to the left output if it is the first match
+ */
+void write_join_match(Join_outputs* outputs, char** csv1_values, char** csv2_values, int is_first_match)
+{
+	char** values = outputs->values;
+	int values_size = 0;
+
+	if (NULL != outputs->natural)
+	{
+		values_size = fill_natural_values(csv1_values, outputs->csv1_col_count, csv2_values, outputs->csv2_col_count, outputs->join_cols, values);
+		write_csv_values(outputs->natural, values, values_size, 0);
+	}
+	if ((NULL != outputs->left && is_first_match) || NULL != outputs->full_outer)
+	{
+		values_size = fill_outer_values(csv1_values, outputs->csv1_col_count, csv2_values, outputs->csv2_col_count, outputs->join_cols, values);
+		if (NULL != outputs->left && is_first_match)
+		{
+			write_csv_values(outputs->left, values, values_size, 0);
+		}
+		if (NULL != outputs->full_outer)
+		{
+			write_csv_values(outputs->full_outer, values, values_size, 0);
+		}
+	}
+}
+
+/**
+ * PURPOSE: writes a csv1 row that matched no csv2 row to the left and full outer outputs, padding the csv2 columbs with null
+ * INPUT PARAMETERS:
+ *    outputs: the open join outputs
+ *    csv1_values: value of each columb of the csv1 row
+ * OUTPUT PARAMETERS:
+ *    appends the padded row to the left and full outer outputs
+ */
+void write_csv1_unmatched(Join_outputs* outputs, char** csv1_values)
+{
+	char** values = outputs->values;
+	int values_size = 0;
+
+	if (NULL != outputs->left || NULL != outputs->full_outer)
+	{
+		values_size = fill_outer_values(csv1_values, outputs->csv1_col_count, NULL, outputs->csv2_col_count, outputs->join_cols, values);
+		if (NULL != outputs->left)
+		{
+			write_csv_values(outputs->left, values, values_size, 0);
+		}
+		if (NULL != outputs->full_outer)
+		{
+			write_csv_values(outputs->full_outer, values, values_size, 0);
+		}
+	}
+}
+
+/**
+ * PURPOSE: writes a csv2 row that matched no csv1 row to the full outer output, padding the csv1 columbs with null
+ * INPUT PARAMETERS:
+ *    outputs: the open join outputs
+ *    csv2_values: value of each columb of the csv2 row
+ * OUTPUT PARAMETERS:
+ *    appends the padded row to the full outer output
+ */
+void write_csv2_unmatched(Join_outputs* outputs, char** csv2_values)
+{
+	char** values = outputs->values;
+	int values_size = 0;
+
+	if (NULL != outputs->full_outer)
+	{
+		values_size = fill_outer_values(NULL, outputs->csv1_col_count, csv2_values, outputs->csv2_col_count, outputs->join_cols, values);
+		write_csv_values(outputs->full_outer, values, values_size, 0);
+	}
+}
+
+/**
+ * PURPOSE: finds every csv2 row matching a csv1 row and writes the results to each open join output
+ * INPUT PARAMETERS:
+ *    index: Join_index built over csv2
+ *    csv2: the table holding all rows of csv2
+ *    csv2_matched: boolean for each csv2 row, set to 1 for every row the csv1 row matches. several threads may set it at once
+ *    key: the key of the csv1 row as prepared by make_join_key
+ *    csv1_values: value of each columb of the csv1 row
+ *    outputs: the open join outputs
+ * OUTPUT PARAMETERS:
+ *    appends a row to each output for every match, or the null padded csv1 row to the left and full outer outputs if there are none
+ */
+void probe_join_index(Join_index* index, Csv_table* csv2, atomic_char* csv2_matched, Join_key* key, char** csv1_values, Join_outputs* outputs)
+{
+	char** csv2_values = outputs->csv2_values;
+	int row_matched = 0; //boolean
+	int row = 0;
+	int is_first_only = (NULL == outputs->natural && NULL == outputs->full_outer); //boolean, left join alone only needs the first match
+
+	for (int l = (key->has_null || key->is_absent) ? -1 : find_join_match(index, csv2, key, outputs->join_cols, -1); -1 != l;
+		l = is_first_only ? -1 : find_join_match(index, csv2, key, outputs->join_cols, l))
+	{
+		row = (NULL != index->rows) ? index->rows[l] : l;
+		atomic_store_explicit(&csv2_matched[row], 1, memory_order_relaxed);
+		write_join_match(outputs, csv1_values, csv_row(csv2, row, csv2_values), !row_matched);
+		row_matched = 1;
+		key->matches++;
+	}
+	key->null_keys += key->has_null;
+
+	if (!row_matched) //handles if left row had no right counterpart
+	{
+		write_csv1_unmatched(outputs, csv1_values);
+	}
+}
+
+/**
+ * PURPOSE: writes every csv2 row that matched no csv1 row to the full outer output
+ * INPUT PARAMETERS:
+ *    outputs: the open join outputs
+ *    csv2: the table holding all rows of csv2
+ *    csv2_matched: boolean for each csv2 row, 1 if any csv1 row matched it
+ * OUTPUT PARAMETERS:
+ *    appends each unmatched csv2 row padded with null to the full outer output
+ */
+void write_csv2_unmatched_rows(Join_outputs* outputs, Csv_table* csv2, atomic_char* csv2_matched)
+{
+	char** csv2_values = outputs->csv2_values;
+
+	if (NULL != outputs->full_outer)
+	{
+		for (int l = 0; l < csv2->row_count; l++)
+		{
+			if (!atomic_load_explicit(&csv2_matched[l], memory_order_relaxed))
+			{
+				write_csv2_unmatched(outputs, csv_row(csv2, l, csv2_values));
+			}
+		}
+	}
+}
+
+/**
+ * PURPOSE: closes every open join output and frees its scratch space
+ * INPUT PARAMETERS:
+ *    outputs: the open join outputs
+ */
+void close_join_outputs(Join_outputs* outputs)
+{
+	close_csv_writer(outputs->natural);
+	close_csv_writer(outputs->left);
+	close_csv_writer(outputs->full_outer);
+	free(outputs->values);
+	free(outputs->csv2_values);
+}
+
+/**
+ * PURPOSE: preformes any combination of natural, left and full outer joins on the two csvs represented by inputs in a single pass,
+ *          matching rows once and printing each requested result as a csv named after its join
+ * INPUT PARAMETERS:
+ *    csv1: the table holding the columbs and rows of csv1
+ *    csv2: the table holding the columbs and rows of csv2
+ *    join_types: JOIN_NATURAL, JOIN_LEFT and JOIN_FULL_OUTER or'ed together to select which joins are preformed
+ * OUTPUT PARAMETERS:
+ *    creates Natural_Join.txt, Left_Join.txt and Full_Outer_Join.txt for the requested joins and puts their results in them.
+ *    natural and full outer joins keep every csv2 row a csv1 row matches while left join keeps only the first,
+ *    a null key value never matches anything
+ */
+void join_csvs(Csv_table* csv1, Csv_table* csv2, int join_types)
+{
+	Join_cols join_cols;
+	Join_outputs outputs;
+	Join_index* index = NULL;
+	Join_key key;
+	char** csv1_values = malloc((csv1->col_count + 1) * sizeof(char*));
+	atomic_char* csv2_matched = calloc(csv2->row_count + 1, sizeof(atomic_char)); //boolean for each csv2 row
+
+	assert(NULL != csv1_values && NULL != csv2_matched);
+	mark_phase(PHASE_JOIN_COLS);
+	find_joined_cols(csv1->columbs, csv1->col_count, csv2->columbs, csv2->col_count, &join_cols);
+	find_key_types(&join_cols, csv2);
+	mark_phase(PHASE_INDEX);
+	index = build_join_index(csv1, csv2, &join_cols);
+	assert(NULL != index);
+	init_join_key(&key, join_cols.count);
+	mark_phase(PHASE_JOIN);
+	open_join_outputs(&outputs, join_types, csv1->columbs, csv1->col_count, csv2->columbs, csv2->col_count, &join_cols);
+
+	//probes the index once per csv1 row and hands every match to each requested join
+	for (int k = 0; k < csv1->row_count; k++)
+	{
+		csv_row(csv1, k, csv1_values);
+		make_join_key(&key, index, csv2, &join_cols, csv1_values, csv1, k);
+		probe_join_index(index, csv2, csv2_matched, &key, csv1_values, &outputs);
+	}
+	write_csv2_unmatched_rows(&outputs, csv2, csv2_matched);
+
+	mark_phase(PHASE_OUTPUT);
+	close_join_outputs(&outputs);
+	mark_phase(PHASE_CLEANUP);
+	free_join_key(&key);
+	free_join_index(index);
+	free_join_cols(&join_cols);
+	free(csv1_values);
+	free(csv2_matched);
+}
+
+/**
+ * PURPOSE: finds the partition of a parallel join a key hash belongs to
+ * INPUT PARAMETERS:
+ *    hash: the key hash
+ *    partition_bits: number of high bits of the hash that choose its partition
+ * OUTPUT PARAMETERS:
+ *    returns the partition, from 0 to (1 << partition_bits) - 1. the low bits of the hash are left to choose its bucket
+ *    within the partition's hash table
+ */
+int hash_partition(uint64_t hash, int partition_bits)
+{
+	return (0 < partition_bits) ? (int)(hash >> (64 - partition_bits)) : 0;
+}
+
+/**
+ * PURPOSE: starts thread_count threads running the same work on a parallel join and waits for all of them to finish
+ * INPUT PARAMETERS:
+ *    join: the parallel join, each thread is handed a Join_worker pointing to it
+ *    work: function each thread runs
+ */
+void run_join_workers(Parallel_join* join, void* (*work)(void*))
+{
+	pthread_t* threads = malloc((join->thread_count + 1) * sizeof(pthread_t));
+	Join_worker* workers = malloc((join->thread_count + 1) * sizeof(Join_worker));
+
+	assert(NULL != threads && NULL != workers);
+	for (int i = 0; i < join->thread_count; i++)
+	{
+		workers[i].join = join;
+		workers[i].id = i;
+		if (0 != pthread_create(&threads[i], NULL, work, &workers[i]))
+		{
+			fprintf(stderr, "Unable to start a worker thread.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (int i = 0; i < join->thread_count; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	free(threads);
+	free(workers);
+}
+
+/**
+ * PURPOSE: hashes the keys of one thread's share of the rows of both csvs and counts how many fall in each partition
+ * INPUT PARAMETERS:
+ *    arg: the thread's Join_worker, which hashes the id-th of thread_count equal slices of each csv
+ * OUTPUT PARAMETERS:
+ *    fills in the partition of each row in the slices, the hashes of the csv2 rows and the thread's counts
+ */
+void* hash_join_rows(void* arg)
+{
+	Join_worker* worker = arg;
+	Parallel_join* join = worker->join;
+	Join_cols* join_cols = join->join_cols;
+	int* csv1_counts = join->csv1_counts + (size_t)worker->id * join->partition_count;
+	int* csv2_counts = join->csv2_counts + (size_t)worker->id * join->partition_count;
+	int first = (int)((int64_t)join->csv1->row_count * worker->id / join->thread_count);
+	int last = (int)((int64_t)join->csv1->row_count * (worker->id + 1) / join->thread_count);
+	uint64_t hash = 0;
+	int has_null = 0;
+
+	for (int k = first; k < last; k++)
+	{
+		hash = hash_table_key(join->csv1, k, join_cols->csv1_index, join_cols->count, join_cols, join->index->csv1_null_codes, &has_null, NULL);
+		join->csv1_partitions[k] = hash_partition(hash, join->partition_bits);
+		csv1_counts[join->csv1_partitions[k]]++;
+	}
+
+	first = (int)((int64_t)join->csv2->row_count * worker->id / join->thread_count);
+	last = (int)((int64_t)join->csv2->row_count * (worker->id + 1) / join->thread_count);
+	for (int l = first; l < last; l++)
+	{
+		join->csv2_hashes[l] = hash_table_key(join->csv2, l, join_cols->csv2_index, join_cols->count, join_cols, join->index->csv2_null_codes, &has_null,
+			&join->csv2_keys[(size_t)l * join_cols->count]);
+		join->csv2_has_null[l] = (char)has_null;
+		join->csv2_partitions[l] = hash_partition(join->csv2_hashes[l], join->partition_bits);
+		csv2_counts[join->csv2_partitions[l]]++;
+	}
+	return NULL;
+}
+
+/**
+ * PURPOSE: turns the per thread partition counts of a csv into the position each thread's rows of each partition start at,
+ *          so threads can scatter their rows without sharing anything and every partition keeps its rows in csv order
+ * INPUT PARAMETERS:
+ *    counts: rows each thread found in each partition, thread_count * partition_count items
+ *    start: partition_count + 1 items to be filled in
+ *    thread_count: number of threads the rows were counted by
+ *    partition_count: number of partitions
+ * OUTPUT PARAMETERS:
+ *    replaces each count with the position of the thread's first row of that partition, and sets the position of each
+ *    partition's first row in start, with its last item holding the total row count
+ */
+void sum_partition_counts(int* counts, int* start, int thread_count, int partition_count)
+{
+	int pos = 0;
+	int count = 0;
+
+	for (int p = 0; p < partition_count; p++)
+	{
+		start[p] = pos;
+		for (int i = 0; i < thread_count; i++)
+		{
+			count = counts[(size_t)i * partition_count + p];
+			counts[(size_t)i * partition_count + p] = pos;
+			pos += count;
+		}
+	}
+	start[partition_count] = pos;
+}
+
+/**
+ * PURPOSE: moves one thread's share of the rows of both csvs into their partitions
+ * INPUT PARAMETERS:
+ *    arg: the thread's Join_worker, covering the same slices of each csv hash_join_rows gave it
+ * OUTPUT PARAMETERS:
+ *    fills in the thread's part of csv1_rows, csv2_rows and the csv2 row hashes and null flags
+ */
+void* scatter_join_rows(void* arg)
+{
+	Join_worker* worker = arg;
+	Parallel_join* join = worker->join;
+	int* csv1_pos = join->csv1_counts + (size_t)worker->id * join->partition_count;
+	int* csv2_pos = join->csv2_counts + (size_t)worker->id * join->partition_count;
+	int first = (int)((int64_t)join->csv1->row_count * worker->id / join->thread_count);
+	int last = (int)((int64_t)join->csv1->row_count * (worker->id + 1) / join->thread_count);
+	int pos = 0;
+
+	for (int k = first; k < last; k++)
+	{
+		join->csv1_rows[csv1_pos[join->csv1_partitions[k]]++] = k;
+	}
+
+	first = (int)((int64_t)join->csv2->row_count * worker->id / join->thread_count);
+	last = (int)((int64_t)join->csv2->row_count * (worker->id + 1) / join->thread_count);
+	for (int l = first; l < last; l++)
+	{
+		pos = csv2_pos[join->csv2_partitions[l]]++;
+		join->csv2_rows[pos] = l;
+		join->csv2_row_hashes[pos] = join->csv2_hashes[l];
+		join->csv2_row_has_null[pos] = join->csv2_has_null[l];
+	}
+	return NULL;
+}
+
+/**
+ * PURPOSE: moves every row gathered in memory by one writer to the end of another
+ * INPUT PARAMETERS:
+ *    output: the writer to append to, may be NULL if rows is too
+ *    rows: a writer without a file holding the rows, emptied afterwards, may be NULL
+ */
+void append_csv_rows(Csv_writer* output, Csv_writer* rows)
+{
+	if (NULL != output && NULL != rows)
+	{
+		put_csv_bytes(output, rows->buffer, rows->used);
+		rows->used = 0;
+	}
+}
+
+/**
+ * PURPOSE: waits until every earlier partition of a parallel join has been written out, then writes out one partition's rows
+ * INPUT PARAMETERS:
+ *    join: the parallel join
+ *    partition: the partition the rows belong to
+ *    rows: the worker's outputs holding the partition's rows in memory
+ * OUTPUT PARAMETERS:
+ *    appends the rows to the output files and empties the worker's outputs, so partitions are written in order
+ */
+void write_join_partition(Parallel_join* join, int partition, Join_outputs* rows)
+{
+	pthread_mutex_lock(&join->lock);
+	while (join->next_output != partition)
+	{
+		pthread_cond_wait(&join->written, &join->lock);
+	}
+	pthread_mutex_unlock(&join->lock);
+
+	//only the worker holding the next partition gets here, so it has the output files to itself
+	append_csv_rows(join->outputs->natural, rows->natural);
+	append_csv_rows(join->outputs->left, rows->left);
+	append_csv_rows(join->outputs->full_outer, rows->full_outer);
+
+	pthread_mutex_lock(&join->lock);
+	join->next_output++;
+	pthread_cond_broadcast(&join->written);
+	pthread_mutex_unlock(&join->lock);
+}
+
+/**
+ * PURPOSE: takes partitions of a parallel join one at a time until none are left, joining each with a hash table built
+ *          over only its own csv2 rows
+ * INPUT PARAMETERS:
+ *    arg: the thread's Join_worker
+ * OUTPUT PARAMETERS:
+ *    writes the joined rows of every partition it takes, followed by the partition's unmatched csv2 rows for full outer join
+ */
+void* join_partitions(void* arg)
+{
+	Join_worker* worker = arg;
+	Parallel_join* join = worker->join;
+	Csv_table* csv1 = join->csv1;
+	Csv_table* csv2 = join->csv2;
+	Join_outputs rows; //rows of the current partition, gathered in memory until it is the partition's turn to be written
+	Join_index* index = calloc(1, sizeof(Join_index));
+	Join_key key;
+	char** csv1_values = malloc((csv1->col_count + 1) * sizeof(char*));
+	int partition = 0;
+	int first = 0;
+	int last = 0;
+	int l = 0;
+
+	assert(NULL != index && NULL != csv1_values);
+	init_join_outputs(&rows, csv1->col_count, csv2->col_count, join->join_cols);
+	rows.natural = (join->join_types & JOIN_NATURAL) ? new_csv_writer(-1, 0) : NULL;
+	rows.left = (join->join_types & JOIN_LEFT) ? new_csv_writer(-1, 0) : NULL;
+	rows.full_outer = (join->join_types & JOIN_FULL_OUTER) ? new_csv_writer(-1, 0) : NULL;
+	init_join_key(&key, join->join_cols->count);
+
+	for (;;)
+	{
+		pthread_mutex_lock(&join->lock);
+		partition = join->next_partition;
+		join->next_partition++;
+		pthread_mutex_unlock(&join->lock);
+		if (partition >= join->partition_count)
+		{
+			break;
+		}
+
+		first = join->csv2_start[partition];
+		last = join->csv2_start[partition + 1];
+		if (!chain_join_rows(index, join->csv2_rows + first, last - first, join->csv2_row_hashes + first, join->csv2_row_has_null + first,
+			join->csv2_keys, join->join_cols->count))
+		{
+			fprintf(stderr, "Unable to allocate memory for a partition's hash table.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		for (int i = join->csv1_start[partition]; i < join->csv1_start[partition + 1]; i++)
+		{
+			csv_row(csv1, join->csv1_rows[i], csv1_values);
+			make_join_key(&key, join->index, csv2, join->join_cols, csv1_values, csv1, join->csv1_rows[i]);
+			probe_join_index(index, csv2, join->csv2_matched, &key, csv1_values, &rows);
+		}
+
+		//each csv2 row belongs to a single partition, so once the partition is probed its unmatched rows are known
+		for (int i = first; i < last && NULL != rows.full_outer; i++)
+		{
+			l = join->csv2_rows[i];
+			if (!atomic_load_explicit(&join->csv2_matched[l], memory_order_relaxed))
+			{
+				write_csv2_unmatched(&rows, csv_row(csv2, l, rows.csv2_values));
+			}
+		}
+
+		write_join_partition(join, partition, &rows);
+	}
+
+	close_join_outputs(&rows);
+	free_join_key(&key);
+	free_join_index(index);
+	free(csv1_values);
+	return NULL;
+}
+
+/**
+ * PURPOSE: preformes the same joins as join_csvs using several threads. both csvs are radix partitioned on the high bits of
+ *          their key hashes so each partition's hash table fits in cache, then a pool of threads joins the partitions
+ * INPUT PARAMETERS:
+ *    csv1: the table holding the columbs and rows of csv1
+ *    csv2: the table holding the columbs and rows of csv2
+ *    join_types: JOIN_NATURAL, JOIN_LEFT and JOIN_FULL_OUTER or'ed together to select which joins are preformed
+ *    thread_count: number of threads to use
+ * OUTPUT PARAMETERS:
+ *    creates Natural_Join.txt, Left_Join.txt and Full_Outer_Join.txt for the requested joins with the same rows join_csvs
+ *    gives. rows are written partition by partition, in csv1 order within each partition followed by its unmatched csv2
+ *    rows, which does not depend on the thread count
+ */
+void parallel_join_csvs(Csv_table* csv1, Csv_table* csv2, int join_types, int thread_count)
+{
+	Join_cols join_cols;
+	Join_outputs outputs;
+	Parallel_join join;
+	size_t counts_size = 0;
+
+	memset(&join, 0, sizeof(Parallel_join));
+	join.csv1 = csv1;
+	join.csv2 = csv2;
+	join.join_cols = &join_cols;
+	join.outputs = &outputs;
+	join.join_types = join_types;
+	join.thread_count = thread_count;
+
+	//enough partitions to share evenly between the threads, and more if csv2 is too big for their hash tables to stay in cache
+	join.partition_bits = MIN_PARTITION_BITS;
+	while (join.partition_bits < MAX_PARTITION_BITS && (csv2->row_count >> join.partition_bits) > PARTITION_ROWS)
+	{
+		join.partition_bits++;
+	}
+	join.partition_count = 1 << join.partition_bits;
+	counts_size = (size_t)thread_count * join.partition_count;
+
+	mark_phase(PHASE_JOIN_COLS);
+	find_joined_cols(csv1->columbs, csv1->col_count, csv2->columbs, csv2->col_count, &join_cols);
+	find_key_types(&join_cols, csv2);
+	mark_phase(PHASE_INDEX);
+	join.index = new_join_index(csv1, csv2, &join_cols);
+	join.csv1_partitions = malloc((csv1->row_count + 1) * sizeof(int));
+	join.csv2_partitions = malloc((csv2->row_count + 1) * sizeof(int));
+	join.csv2_hashes = malloc((csv2->row_count + 1) * sizeof(uint64_t));
+	join.csv2_keys = malloc(((size_t)csv2->row_count * join_cols.count + 1) * sizeof(int64_t));
+	join.csv2_has_null = malloc((csv2->row_count + 1) * sizeof(char));
+	join.csv1_counts = calloc(counts_size, sizeof(int));
+	join.csv2_counts = calloc(counts_size, sizeof(int));
+	join.csv1_start = malloc((join.partition_count + 1) * sizeof(int));
+	join.csv2_start = malloc((join.partition_count + 1) * sizeof(int));
+	join.csv1_rows = malloc((csv1->row_count + 1) * sizeof(int));
+	join.csv2_rows = malloc((csv2->row_count + 1) * sizeof(int));
+	join.csv2_row_hashes = malloc((csv2->row_count + 1) * sizeof(uint64_t));
+	join.csv2_row_has_null = malloc((csv2->row_count + 1) * sizeof(char));
+	join.csv2_matched = calloc(csv2->row_count + 1, sizeof(atomic_char));
+	assert(NULL != join.index && NULL != join.csv1_partitions && NULL != join.csv2_partitions && NULL != join.csv2_hashes
+		&& NULL != join.csv2_keys && NULL != join.csv2_has_null && NULL != join.csv1_counts && NULL != join.csv2_counts && NULL != join.csv1_start
+		&& NULL != join.csv2_start && NULL != join.csv1_rows && NULL != join.csv2_rows && NULL != join.csv2_row_hashes
+		&& NULL != join.csv2_row_has_null && NULL != join.csv2_matched);
+	pthread_mutex_init(&join.lock, NULL);
+	pthread_cond_init(&join.written, NULL);
+
+	run_join_workers(&join, hash_join_rows);
+	sum_partition_counts(join.csv1_counts, join.csv1_start, thread_count, join.partition_count);
+	sum_partition_counts(join.csv2_counts, join.csv2_start, thread_count, join.partition_count);
+	run_join_workers(&join, scatter_join_rows);
+
+	//each partition's own hash table is built by the worker joining it, so that time counts towards the join
+	mark_phase(PHASE_JOIN);
+	open_join_outputs(&outputs, join_types, csv1->columbs, csv1->col_count, csv2->columbs, csv2->col_count, &join_cols);
+	run_join_workers(&join, join_partitions);
+
+	mark_phase(PHASE_OUTPUT);
+	close_join_outputs(&outputs);
+	mark_phase(PHASE_CLEANUP);
+	pthread_mutex_destroy(&join.lock);
+	pthread_cond_destroy(&join.written);
+	free_join_index(join.index);
+	free_join_cols(&join_cols);
+	free(join.csv1_partitions);
+	free(join.csv2_partitions);
+	free(join.csv2_hashes);
+	free(join.csv2_keys);
+	free(join.csv2_has_null);
+	free(join.csv1_counts);
+	free(join.csv2_counts);
+	free(join.csv1_start);
+	free(join.csv2_start);
+	free(join.csv1_rows);
+	free(join.csv2_rows);
+	free(join.csv2_row_hashes);
+	free(join.csv2_row_has_null);
+	free(join.csv2_matched);
+}
+
+
+/**
+ * PURPOSE: compares the join keys of two rows columb by columb, comparing the columbs sort_key_types marks as numbers or
+ *          dates by value
+ * INPUT PARAMETERS:
+ *    values1: value of each columb of the first row
+ *    key_cols1: positions of the joined columbs within the first row
+ *    values2: value of each columb of the second row
+ *    key_cols2: positions of the joined columbs within the second row
+ *    key_count: number of joined columbs
+ * OUTPUT PARAMETERS:
+ *    returns a negative number, zero or a positive number if the first key sorts before, equal to or after the second
+ */
+int compare_keys(char** values1, int* key_cols1, char** values2, int* key_cols2, int key_count)
+{
+	int result = 0;
+	int64_t word1 = 0;
+	int64_t word2 = 0;
+
+	for (int i = 0; i < key_count && 0 == result; i++)
+	{
+		if (NULL != sort_key_types && KEY_TEXT != sort_key_types[i])
+		{
+			word1 = parse_key_word(values1[key_cols1[i]], sort_key_types[i], sort_key_scales[i]);
+			word2 = parse_key_word(values2[key_cols2[i]], sort_key_types[i], sort_key_scales[i]);
+			result = (word1 > word2) - (word1 < word2);
+		}
+		else
+		{
+			result = strcmp(values1[key_cols1[i]], values2[key_cols2[i]]);
+		}
+	}
+	return result;
+}
+
+/**
+ * PURPOSE: checks if any of a row's join key values are null, or are not of the type sort_key_types compares their columb as
+ * INPUT PARAMETERS:
+ *    values: value of each columb of the row
+ *    key_cols: positions of the joined columbs within the row
+ *    key_count: number of joined columbs
+ * OUTPUT PARAMETERS:
+ *    returns 1 if a key value is null or of the wrong type so the row can match nothing, otherwise 0
+ */
+int has_null_key(char** values, int* key_cols, int key_count)
+{
+	int has_null = 0;
+
+	for (int i = 0; i < key_count && !has_null; i++)
+	{
+		has_null = (0 == strcmp(values[key_cols[i]], null));
+		if (NULL != sort_key_types && KEY_TEXT != sort_key_types[i])
+		{
+			has_null = has_null || INVALID_WORD == parse_key_word(values[key_cols[i]], sort_key_types[i], sort_key_scales[i]);
+		}
+	}
+	return has_null;
+}
+
+/**
+ * PURPOSE: sets the type each shared columb is compared as from the values csv2 holds in it, reading csv2 through once
+ *          and returning to where it started. a csv2 that is not mapped cannot be read twice, so its columbs stay text
+ *          unless --key-type gives their type
+ * INPUT PARAMETERS:
+ *    join_cols: the columbs shared by both csvs
+ *    input2: reader for csv2, positioned after its columb names
+ *    col_count: number of columbs csv2 containes
+ * OUTPUT PARAMETERS:
+ *    fills the key_types and key_scales of join_cols
+ */
+void find_sorted_key_types(Join_cols* join_cols, Csv_reader* input2, int col_count)
+{
+	size_t start = input2->pos;
+	Key_profile* profiles = calloc(join_cols->count + 1, sizeof(Key_profile));
+	char** values = malloc((col_count + 1) * sizeof(char*));
+	int t = 0;
+
+	assert(NULL != profiles && NULL != values);
+	if (input2->is_mapped)
+	{
+		while (-1 != next_csv_record(input2, values, col_count))
+		{
+			for (int n = 0; n < join_cols->count; n++)
+			{
+				profile_key_value(&profiles[n], values[join_cols->csv2_index[n]]);
+			}
+			release_csv_reader(input2);
+		}
+		if (!seek_csv_reader(input2, start))
+		{
+			fprintf(stderr, "Unable to map %s.\n", input2->name);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (int n = 0; n < join_cols->count; n++)
+	{
+		join_cols->key_types[n] = decide_key_type(&profiles[n], join_cols->names[n], &join_cols->key_scales[n]);
+
+		//without any values to profile, a decimal given with --key-type has no scale to use
+		t = find_key_type(join_cols->names[n]);
+		if (!input2->is_mapped && -1 != t && 0 > key_type_scales[t])
+		{
+			join_cols->key_types[n] = KEY_TEXT;
+		}
+	}
+	free(profiles);
+	free(values);
+}
+
+/**
+ * PURPOSE: writes a record to a sorted run file, one record per line
+ * INPUT PARAMETERS:
+ *    run: writer for the run file
+ *    values: value of each columb of the record
+ *    col_count: number of items in values
+ * OUTPUT PARAMETERS:
+ *    appends the record to run
+ */
+void write_run_record(Csv_writer* run, char** values, int col_count)
+{
+	for (int i = 0; i < col_count; i++)
+	{
+		write_csv_field(run, values[i], 1 == col_count);
+		put_csv_char(run, (i < col_count - 1) ? ',' : '\n');
+	}
+}
+
+/**
+ * PURPOSE: qsort comparison function ordering the records of a run by their join key, records with equal keys
+ *          keep the order they were read in so the sort is stable
+ * INPUT PARAMETERS:
+ *    a, b: pointers to the positions of the two records being compared
+ * OUTPUT PARAMETERS:
+ *    returns a negative number, zero or a positive number if record a sorts before, equal to or after record b
+ */
+int compare_run_records(const void* a, const void* b)
+{
+	int record_a = *(const int*)a;
+	int record_b = *(const int*)b;
+	int64_t word_a = 0;
+	int64_t word_b = 0;
+	int result = 0;
+
+	if (NULL == sort_words)
+	{
+		result = compare_keys(&sort_cells[(size_t)record_a * sort_col_count], sort_key_cols, &sort_cells[(size_t)record_b * sort_col_count], sort_key_cols, sort_key_count);
+	}
+	//typed columbs were parsed once when the run was read instead of at every comparison
+	for (int i = 0; i < sort_key_count && NULL != sort_words && 0 == result; i++)
+	{
+		if (KEY_TEXT != sort_key_types[i])
+		{
+			word_a = sort_words[(size_t)record_a * sort_key_count + i];
+			word_b = sort_words[(size_t)record_b * sort_key_count + i];
+			result = (word_a > word_b) - (word_a < word_b);
+		}
+		else
+		{
+			result = strcmp(sort_cells[(size_t)record_a * sort_col_count + sort_key_cols[i]], sort_cells[(size_t)record_b * sort_col_count + sort_key_cols[i]]);
+		}
+	}
+
+	if (0 == result)
+	{
+		result = (record_a > record_b) - (record_a < record_b);
+	}
+	return result;
+}
+
+/**
+ * PURPOSE: sets up a Sorted_input to merge a set of sorted runs, every run must already be positioned at its first record
+ * INPUT PARAMETERS:
+ *    sorted: Sorted_input struct to be filled in
+ *    runs: the sorted runs to merge, at most MERGE_WAY of them
+ *    run_count: number of items in runs
+ *    key_cols: positions of the joined columbs within each record
+ *    key_count: number of joined columbs
+ *    col_count: number of columbs in each record
+ */
+void open_sorted_input(Sorted_input* sorted, Csv_reader** runs, int run_count, int* key_cols, int key_count, int col_count)
+{
+	assert(run_count <= MERGE_WAY);
+
+	sorted->run_count = run_count;
+	sorted->current = -1;
+	sorted->key_cols = key_cols;
+	sorted->key_count = key_count;
+	sorted->col_count = col_count;
+
+	for (int r = 0; r < run_count; r++)
+	{
+		sorted->runs[r] = runs[r];
+		sorted->values[r] = malloc((col_count + 1) * sizeof(char*));
+		assert(NULL != sorted->values[r]);
+		sorted->has_record[r] = (-1 != next_csv_record(runs[r], sorted->values[r], col_count));
+	}
+}
+
+/**
+ * PURPOSE: gets the next record in key order from a Sorted_input, records with equal keys come out in the order of their runs
+ * INPUT PARAMETERS:
+ *    sorted: the Sorted_input to read from
+ * OUTPUT PARAMETERS:
+ *    returns the value of each columb of the next record, or NULL once every run is exhausted.
+ *    the returned values are only valid until the next call
+ */
+char** next_sorted_record(Sorted_input* sorted)
+{
+	int smallest = -1;
+	int r = sorted->current;
+
+	//the run the previous record came from is only advanced now so that record stayed valid until this call
+	if (-1 != r)
+	{
+		sorted->has_record[r] = (-1 != next_csv_record(sorted->runs[r], sorted->values[r], sorted->col_count));
+		release_csv_reader(sorted->runs[r]);
+	}
+
+	for (r = 0; r < sorted->run_count; r++)
+	{
+		if (sorted->has_record[r] && (-1 == smallest || 0 > compare_keys(sorted->values[r], sorted->key_cols, sorted->values[smallest], sorted->key_cols, sorted->key_count)))
+		{
+			smallest = r;
+		}
+	}
+
+	sorted->current = smallest;
+	return (-1 != smallest) ? sorted->values[smallest] : NULL;
+}
+
+/**
+ * PURPOSE: closes every run of a Sorted_input and frees the arrays holding their records
+ * INPUT PARAMETERS:
+ *    sorted: the Sorted_input to close
+ */
+void close_sorted_input(Sorted_input* sorted)
+{
+	for (int r = 0; r < sorted->run_count; r++)
+	{
+		close_csv_reader(sorted->runs[r]);
+		free(sorted->values[r]);
+	}
+	sorted->run_count = 0;
+}
+
+/**
+ * PURPOSE: checks if the records of a csv are already in join key order, then moves the reader back to where it started
+ * INPUT PARAMETERS:
+ *    input: reader positioned at the first record to check, it must be mapped so it can be moved back
+ *    key_cols: positions of the joined columbs within each record
+ *    key_count: number of joined columbs
+ *    col_count: number of columbs in each record
+ * OUTPUT PARAMETERS:
+ *    returns 1 if no record has a smaller key than the record before it, otherwise 0.
+ *    stops reading at the first record found out of order
+ */
+int is_sorted_csv(Csv_reader* input, int* key_cols, int key_count, int col_count)
+{
+	size_t start = input->pos;
+	char** values[2] = { malloc((col_count + 1) * sizeof(char*)), malloc((col_count + 1) * sizeof(char*)) };
+	int is_sorted = 1; //boolean
+	int prev = 0;
+
+	assert(NULL != values[0] && NULL != values[1]);
+
+	if (-1 != next_csv_record(input, values[prev], col_count))
+	{
+		while (is_sorted && -1 != next_csv_record(input, values[!prev], col_count))
+		{
+			is_sorted = (0 >= compare_keys(values[prev], key_cols, values[!prev], key_cols, key_count));
+			prev = !prev;
+			release_csv_reader(input);
+		}
+	}
+
+	if (!seek_csv_reader(input, start))
+	{
+		fprintf(stderr, "Unable to map %s.\n", input->name);
+		exit(EXIT_FAILURE);
+	}
+	free(values[0]);
+	free(values[1]);
+	return is_sorted;
+}
+
+/**
+ * PURPOSE: sorts a csv by its join key, spilling sorted runs of at most SORT_RUN_BYTES to temporary files and merging
+ *          them down until few enough remain to be merged while joining. if the csv is already sorted the sort is skipped
+ * INPUT PARAMETERS:
+ *    sorted: Sorted_input struct to be filled in
+ *    input: reader positioned after the columb names of the csv, sorted takes ownership of it
+ *    key_cols: positions of the joined columbs within each record
+ *    key_count: number of joined columbs
+ *    col_count: number of columbs in each record
+ * OUTPUT PARAMETERS:
+ *    sets up sorted to return the records of the csv, excluding its columb names, in key order
+ */
+void open_sorted_csv(Sorted_input* sorted, Csv_reader* input, int* key_cols, int key_count, int col_count)
+{
+	Csv_reader** runs = NULL;
+	Csv_reader** merged_runs = NULL;
+	FILE* run = NULL;
+	Csv_writer* run_writer = NULL; //writes to a duplicate of run's descriptor, so run is left open for reading
+	int run_count = 0;
+	int merged_count = 0;
+	size_t run_start = 0;
+	size_t word_count = (NULL != sort_key_types) ? (size_t)key_count : 0; //parsed key values kept per record
+	int record_limit = (int)(SORT_RUN_BYTES / 4 / ((size_t)col_count * sizeof(char*) + sizeof(int) + word_count * sizeof(int64_t)));
+	int record_count = 0;
+	char** cells = NULL;
+	int* order = NULL;
+	int64_t* words = NULL;
+	char** record = NULL;
+	int more_records = 1; //boolean
+
+	assert(0 < record_limit);
+
+	//an unmapped input cannot be read twice, so it is sorted without checking its order first
+	if (input->is_mapped && is_sorted_csv(input, key_cols, key_count, col_count))
+	{
+		open_sorted_input(sorted, &input, 1, key_cols, key_count, col_count);
+		return;
+	}
+
+	cells = malloc((size_t)record_limit * col_count * sizeof(char*));
+	order = malloc((size_t)record_limit * sizeof(int));
+	words = malloc((size_t)record_limit * word_count * sizeof(int64_t) + 1);
+	assert(NULL != cells && NULL != order && NULL != words);
+
+	//reads the csv a run at a time, sorting each run in memory and spilling it to a temporary file.
+	//the records of a run are split in place within the reader so about 3/4 of SORT_RUN_BYTES of the file is held at once
+	run_start = input->pos;
+	while (more_records)
+	{
+		more_records = (-1 != next_csv_record(input, &cells[(size_t)record_count * col_count], col_count));
+		if (more_records)
+		{
+			for (size_t i = 0; i < word_count; i++)
+			{
+				words[record_count * word_count + i] = (KEY_TEXT != sort_key_types[i])
+					? parse_key_word(cells[(size_t)record_count * col_count + key_cols[i]], sort_key_types[i], sort_key_scales[i]) : 0;
+			}
+			order[record_count] = record_count;
+			record_count++;
+		}
+
+		if (0 < record_count && (!more_records || record_count == record_limit || SORT_RUN_BYTES / 4 * 3 <= input->pos - run_start))
+		{
+			sort_cells = cells;
+			sort_col_count = col_count;
+			sort_key_cols = key_cols;
+			sort_key_count = key_count;
+			sort_words = (0 < word_count) ? words : NULL;
+			qsort(order, record_count, sizeof(int), compare_run_records);
+			sort_words = NULL;
+
+			run = tmpfile();
+			assert(NULL != run);
+			run_writer = new_csv_writer(dup(fileno(run)), 0);
+			for (int i = 0; i < record_count; i++)
+			{
+				write_run_record(run_writer, &cells[(size_t)order[i] * col_count], col_count);
+			}
+			close_csv_writer(run_writer);
+
+			runs = realloc(runs, (run_count + 1) * sizeof(Csv_reader*));
+			assert(NULL != runs);
+			runs[run_count] = new_csv_reader(run, "a temporary run");
+			assert(NULL != runs[run_count]);
+			run_count++;
+			record_count = 0;
+			release_csv_reader(input);
+			run_start = input->pos;
+		}
+	}
+
+	close_csv_reader(input);
+	free(cells);
+	free(order);
+	free(words);
+
+	//merges groups of runs into longer runs until they can all be merged at once
+	while (MERGE_WAY < run_count)
+	{
+		merged_count = 0;
+		merged_runs = malloc(((run_count + MERGE_WAY - 1) / MERGE_WAY) * sizeof(Csv_reader*));
+		assert(NULL != merged_runs);
+
+		for (int r = 0; r < run_count; r += MERGE_WAY)
+		{
+			open_sorted_input(sorted, &runs[r], (run_count - r < MERGE_WAY) ? run_count - r : MERGE_WAY, key_cols, key_count, col_count);
+			run = tmpfile();
+			assert(NULL != run);
+			run_writer = new_csv_writer(dup(fileno(run)), 0);
+			for (record = next_sorted_record(sorted); NULL != record; record = next_sorted_record(sorted))
+			{
+				write_run_record(run_writer, record, col_count);
+			}
+			close_csv_writer(run_writer);
+			close_sorted_input(sorted);
+			merged_runs[merged_count] = new_csv_reader(run, "a temporary run");
+			assert(NULL != merged_runs[merged_count]);
+			merged_count++;
+		}
+
+		free(runs);
+		runs = merged_runs;
+		run_count = merged_count;
+	}
+
+	open_sorted_input(sorted, runs, run_count, key_cols, key_count, col_count);
+	free(runs);
+}
+
+/**
+ * PURPOSE: copies a record into a single allocation so it outlives the buffer it was read into
+ * INPUT PARAMETERS:
+ *    values: value of each columb of the record
+ *    col_count: number of items in values
+ * OUTPUT PARAMETERS:
+ *    returns the copied values, which are freed with a single call to free
+ */
+char** copy_record(char** values, int col_count)
+{
+	size_t size = col_count * sizeof(char*);
+	char** copy = NULL;
+	char* text = NULL;
+
+	for (int i = 0; i < col_count; i++)
+	{
+		size += strlen(values[i]) + 1;
+	}
+
+	copy = malloc(size);
+	assert(NULL != copy);
+	text = (char*)(copy + col_count);
+	for (int i = 0; i < col_count; i++)
+	{
+		copy[i] = strcpy(text, values[i]);
+		text += strlen(text) + 1;
+	}
+	return copy;
+}
+
+/**
+ * PURPOSE: reads the columb names at the start of a csv, however many there are
+ * INPUT PARAMETERS:
+ *    reader: reader positioned at the start of the csv
+ *    col_count: set to the number of columbs found
+ * OUTPUT PARAMETERS:
+ *    returns a copy of the columb names, freed with a single call to free, or NULL if the csv is empty
+ */
+char** read_csv_header(Csv_reader* reader, int* col_count)
+{
+	char* field = NULL;
+	char* end = NULL;
+	char** names = NULL;
+	char** copy = NULL;
+	int capacity = 0;
+	int is_last = 0; //boolean
+
+	*col_count = 0;
+	if (reader->pos == reader->size && !take_csv_data(reader))
+	{
+		return NULL;
+	}
+	field = reader->data + reader->pos;
+	end = reader->data + reader->size;
+	reader->record_start = reader->pos;
+
+	if (0 < blank_line_length(field))
+	{
+		field += blank_line_length(field);
+		is_last = 1;
+	}
+	while (!is_last)
+	{
+		if (*col_count == capacity)
+		{
+			capacity = (0 < capacity) ? capacity * 2 : 16;
+			names = realloc(names, capacity * sizeof(char*));
+			assert(NULL != names);
+		}
+		names[*col_count] = field;
+		(*col_count)++;
+		field = split_csv_field(field, end, &is_last, &reader->is_unclosed);
+	}
+	reader->pos = (size_t)(field - reader->data);
+
+	copy = copy_record(names, *col_count);
+	free(names);
+	return copy;
+}
+
+/**
+ * PURPOSE: preformes the requested joins on two csv files by sorting both on their join key and merging the sorted streams,
+ *          only holding a run of records and the csv2 rows sharing a single key in memory at any time
+ * INPUT PARAMETERS:
+ *    input1: reader for the first csv, closed once the join is done
+ *    input2: reader for the second csv, closed once the join is done
+ *    join_types: JOIN_NATURAL, JOIN_LEFT and JOIN_FULL_OUTER or'ed together to select which joins are preformed
+ * OUTPUT PARAMETERS:
+ *    creates the output file of each requested join, the same rows are produced as join_csvs
+ *    but they come out in join key order rather than csv1 order
+ */
+void sort_merge_join_files(Csv_reader* input1, Csv_reader* input2, int join_types)
+{
+	int csv1_col_count = 0;
+	int csv2_col_count = 0;
+	char** csv1_names = NULL;
+	char** csv2_names = NULL;
+	Join_cols join_cols;
+	Join_outputs outputs;
+	Sorted_input sorted1;
+	Sorted_input sorted2;
+	char*** group = NULL; //csv2 records sharing the current key
+	int group_size = 0;
+	int group_capacity = 0;
+	char** record1 = NULL;
+	char** record2 = NULL;
+	long rows_read = 0;
+	long comparisons = 0;
+	long matches = 0;
+	long null_keys = 0;
+
+	mark_phase(PHASE_SORT);
+	csv1_names = read_csv_header(input1, &csv1_col_count);
+	csv2_names = read_csv_header(input2, &csv2_col_count);
+	assert(0 < csv1_col_count && 0 < csv2_col_count);
+	if (0 == csv1_col_count || 0 == csv2_col_count)
+	{
+		close_csv_reader(input1);
+		close_csv_reader(input2);
+		free(csv1_names);
+		free(csv2_names);
+		return;
+	}
+
+	mark_phase(PHASE_JOIN_COLS);
+	find_joined_cols(csv1_names, csv1_col_count, csv2_names, csv2_col_count, &join_cols);
+	find_sorted_key_types(&join_cols, input2, csv2_col_count);
+	sort_key_types = join_cols.key_types;
+	sort_key_scales = join_cols.key_scales;
+	mark_phase(PHASE_SORT);
+	open_join_outputs(&outputs, join_types, csv1_names, csv1_col_count, csv2_names, csv2_col_count, &join_cols);
+	open_sorted_csv(&sorted1, input1, join_cols.csv1_index, join_cols.count, csv1_col_count);
+	open_sorted_csv(&sorted2, input2, join_cols.csv2_index, join_cols.count, csv2_col_count);
+
+	mark_phase(PHASE_JOIN);
+	record1 = next_sorted_record(&sorted1);
+	record2 = next_sorted_record(&sorted2);
+	rows_read += (NULL != record1) + (NULL != record2);
+	while (NULL != record1 || NULL != record2)
+	{
+		//a null key value never matches, and skipping those rows leaves the rest of each stream in order
+		if (NULL != record1 && has_null_key(record1, join_cols.csv1_index, join_cols.count))
+		{
+			write_csv1_unmatched(&outputs, record1);
+			record1 = next_sorted_record(&sorted1);
+			rows_read += (NULL != record1);
+			null_keys++;
+		}
+		else if (NULL != record2 && has_null_key(record2, join_cols.csv2_index, join_cols.count))
+		{
+			write_csv2_unmatched(&outputs, record2);
+			record2 = next_sorted_record(&sorted2);
+			rows_read += (NULL != record2);
+			null_keys++;
+		}
+		else if (NULL == record2 || (NULL != record1 && (comparisons++, 0 > compare_keys(record1, join_cols.csv1_index, record2, join_cols.csv2_index, join_cols.count))))
+		{
+			write_csv1_unmatched(&outputs, record1);
+			record1 = next_sorted_record(&sorted1);
+			rows_read += (NULL != record1);
+		}
+		else if (NULL == record1 || (comparisons++, 0 < compare_keys(record1, join_cols.csv1_index, record2, join_cols.csv2_index, join_cols.count)))
+		{
+			write_csv2_unmatched(&outputs, record2);
+			record2 = next_sorted_record(&sorted2);
+			rows_read += (NULL != record2);
+		}
+		else
+		{
+			//gathers every csv2 record with this key then pairs each csv1 record with this key against all of them
+			group_size = 0;
+			do
+			{
+				if (group_size == group_capacity)
+				{
+					group_capacity = (0 < group_capacity) ? group_capacity * 2 : 16;
+					group = realloc(group, group_capacity * sizeof(char**));
+					assert(NULL != group);
+				}
+				group[group_size] = copy_record(record2, csv2_col_count);
+				group_size++;
+				record2 = next_sorted_record(&sorted2);
+				rows_read += (NULL != record2);
+			} while (NULL != record2 && (comparisons++, 0 == compare_keys(group[0], join_cols.csv2_index, record2, join_cols.csv2_index, join_cols.count)));
+
+			do
+			{
+				for (int g = 0; g < group_size; g++)
+				{
+					write_join_match(&outputs, record1, group[g], 0 == g);
+				}
+				matches += group_size;
+				record1 = next_sorted_record(&sorted1);
+				rows_read += (NULL != record1);
+			} while (NULL != record1 && (comparisons++, 0 == compare_keys(record1, join_cols.csv1_index, group[0], join_cols.csv2_index, join_cols.count)));
+
+			for (int g = 0; g < group_size; g++)
+			{
+				free(group[g]);
+			}
+		}
+	}
+
+	count_stat(&stats.rows_read, rows_read);
+	count_stat(&stats.key_comparisons, comparisons);
+	count_stat(&stats.matches, matches);
+	count_stat(&stats.null_keys, null_keys);
+
+	mark_phase(PHASE_OUTPUT);
+	close_join_outputs(&outputs);
+	mark_phase(PHASE_CLEANUP);
+	close_sorted_input(&sorted1);
+	close_sorted_input(&sorted2);
+	sort_key_types = NULL;
+	sort_key_scales = NULL;
+	free_join_cols(&join_cols);
+	free(group);
+	free(csv1_names);
+	free(csv2_names);
+}
+
+/**
+ * PURPOSE: starts a thread for each chunk of an input running the same work and waits for all of them to finish
+ * INPUT PARAMETERS:
+ *    chunks: the chunks, each thread is handed a pointer to its own
+ *    chunk_count: number of items in chunks
+ *    work: function each thread runs
+ */
+void run_chunk_workers(Csv_chunk* chunks, int chunk_count, void* (*work)(void*))
+{
+	pthread_t* threads = malloc((chunk_count + 1) * sizeof(pthread_t));
+
+	assert(NULL != threads);
+	for (int i = 0; i < chunk_count; i++)
+	{
+		if (0 != pthread_create(&threads[i], NULL, work, &chunks[i]))
+		{
+			fprintf(stderr, "Unable to start a worker thread.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (int i = 0; i < chunk_count; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	free(threads);
+}
+
+/**
+ * PURPOSE: scans a chunk of an input once for every state a scan for the ends of records may be in at its start, since
+ *          that depends on the chunks before it
+ * INPUT PARAMETERS:
+ *    arg: the Csv_chunk to scan, covering the bytes from its reader's pos to its reader's size
+ * OUTPUT PARAMETERS:
+ *    sets end_states in the chunk
+ */
+void* scan_chunk_states(void* arg)
+{
+	Csv_chunk* chunk = arg;
+	char* pos = chunk->reader.data + chunk->reader.pos;
+	char* end = chunk->reader.data + chunk->reader.size;
+	char* quote = NULL;
+
+	for (int i = 0; i < SCAN_STATE_COUNT; i++)
+	{
+		chunk->end_states[i] = i;
+	}
+	//away from quotes a scan outside a quoted value only depends on the last byte, so it goes from quote to quote
+	while (pos < end)
+	{
+		quote = memchr(pos, '"', (size_t)(end - pos));
+		quote = (NULL != quote) ? quote : end;
+		for (int i = 0; i < SCAN_STATE_COUNT; i++)
+		{
+			if (quote > pos && SCAN_QUOTED != chunk->end_states[i])
+			{
+				chunk->end_states[i] = next_scan_state(SCAN_UNQUOTED, quote[-1]);
+			}
+			if (quote < end)
+			{
+				chunk->end_states[i] = next_scan_state(chunk->end_states[i], '"');
+			}
+		}
+		pos = quote + 1;
+	}
+	return NULL;
+}
+
+/**
+ * PURPOSE: finds the first record that starts after a position in a csv, given the state of a scan at that position
+ * INPUT PARAMETERS:
+ *    data: the csv's data
+ *    pos: position to search from
+ *    size: bytes in data
+ *    state: one of the SCAN_ states, the state of a scan from the start of the records up to pos
+ * OUTPUT PARAMETERS:
+ *    returns the position just after the first line feed at or after pos that ends a record, or size if there is none
+ */
+size_t find_record_start(char* data, size_t pos, size_t size, int state)
+{
+	while (pos < size)
+	{
+		state = next_scan_state(state, data[pos]);
+		if (SCAN_FIELD_START == state && '\n' == data[pos])
+		{
+			return pos + 1;
+		}
+		pos++;
+	}
+	return size;
+}
+
+/**
+ * PURPOSE: parses every record of a chunk of an input into a table of its own
+ * INPUT PARAMETERS:
+ *    arg: the Csv_chunk to parse, whose reader starts and ends on record boundaries
+ * OUTPUT PARAMETERS:
+ *    sets table in the chunk, exiting the program if memory could not be allocated
+ */
+void* parse_csv_chunk(void* arg)
+{
+	Csv_chunk* chunk = arg;
+	char** values = malloc((chunk->col_count + 1) * sizeof(char*));
+
+	chunk->table = new_csv_table(chunk->columbs, chunk->col_count, 1024);
+	assert(NULL != chunk->table && NULL != values);
+
+	while (-1 != next_csv_record(&chunk->reader, values, chunk->col_count))
+	{
+		if (!add_csv_row(chunk->table, values))
+		{
+			fprintf(stderr, "Unable to allocate memory for the rows of %s.\n", chunk->reader.name);
+			exit(EXIT_FAILURE);
+		}
+		release_csv_reader(&chunk->reader);
+	}
+
+	free(values);
+	return NULL;
+}
+
+/**
+ * PURPOSE: loads the records of a mapped csv with several threads. the records are split into byte ranges on record
+ *          boundaries, found by carrying the state of a scan for the ends of records from each range into the next, and
+ *          each range is parsed into its own table before the tables are joined end to end in order
+ * INPUT PARAMETERS:
+ *    input: mapped reader positioned just after the csv's header
+ *    columbs: names of the csv's columbs
+ *    col_count: number of items in columbs
+ *    chunk_count: number of ranges, each parsed by its own thread
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_table holding the rows in the same order load_csv would give, or NULL if a quoted value is never
+ *    closed. input is then moved back to where it started so it can be parsed in one pass
+ */
+Csv_table* load_csv_chunks(Csv_reader* input, char** columbs, int col_count, int chunk_count)
+{
+	Csv_chunk* chunks = calloc(chunk_count + 1, sizeof(Csv_chunk));
+	Csv_table* table = NULL;
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = input->pos;
+	size_t length = input->size - input->pos;
+	size_t pos = 0;
+	int state = SCAN_FIELD_START;
+	int is_valid = 1; //boolean
+
+	assert(NULL != chunks);
+	for (int i = 0; i < chunk_count; i++)
+	{
+		chunks[i].reader = *input;
+		chunks[i].reader.pos = start + (size_t)((double)length * i / chunk_count);
+		chunks[i].reader.size = (i + 1 < chunk_count) ? start + (size_t)((double)length * (i + 1) / chunk_count) : input->size;
+		chunks[i].columbs = columbs;
+		chunks[i].col_count = col_count;
+	}
+	run_chunk_workers(chunks, chunk_count, scan_chunk_states);
+
+	//moves each range's start forward to the first record boundary, its scan state following from the ranges before it
+	for (int i = 1; i < chunk_count; i++)
+	{
+		state = chunks[i - 1].end_states[state];
+		pos = find_record_start(input->data, chunks[i].reader.pos, input->size, state);
+		chunks[i].reader.pos = (pos > chunks[i - 1].reader.pos) ? pos : chunks[i - 1].reader.pos;
+		chunks[i - 1].reader.size = chunks[i].reader.pos;
+	}
+	for (int i = 0; i < chunk_count; i++)
+	{
+		//each chunk only hands back whole pages of its own range
+		chunks[i].reader.released = (chunks[i].reader.pos + page_size - 1) / page_size * page_size;
+		chunks[i].reader.record_start = chunks[i].reader.pos;
+	}
+	run_chunk_workers(chunks, chunk_count, parse_csv_chunk);
+
+	//a quoted value left open before the last range runs to the end of the input, which is left to a single pass
+	for (int i = 0; i + 1 < chunk_count; i++)
+	{
+		is_valid &= !chunks[i].reader.is_unclosed;
+	}
+	if (is_valid)
+	{
+		table = chunks[0].table;
+		chunks[0].table = NULL;
+	}
+	for (int i = 1; i < chunk_count && is_valid; i++)
+	{
+		if (!append_csv_table(table, chunks[i].table))
+		{
+			fprintf(stderr, "Unable to allocate memory for the rows of %s.\n", input->name);
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (int i = 0; i < chunk_count; i++)
+	{
+		free_csv_table(chunks[i].table);
+	}
+	free(chunks);
+
+	if (is_valid)
+	{
+		input->pos = input->size;
+	}
+	else if (!seek_csv_reader(input, start))
+	{
+		fprintf(stderr, "Unable to read %s.\n", input->name);
+		exit(EXIT_FAILURE);
+	}
+	return table;
+}
+
+/**
+ * PURPOSE: describes a mapped csv the way the header of a table image made from it would, so an image can be checked
+ *          against the csv. must be called before any of the csv is parsed, since parsing changes its data
+ * INPUT PARAMETERS:
+ *    input: mapped reader for the csv
+ *    check: Cache_header to fill in with the csv's size, modification time and hashes
+ * OUTPUT PARAMETERS:
+ *    returns 1 on success or 0 if the csv's file could not be looked at
+ */
+int describe_cache_source(Csv_reader* input, Cache_header* check)
+{
+	struct stat info;
+	size_t bytes = 0;
+
+	memset(check, 0, sizeof(Cache_header));
+	if (0 != fstat(fileno(input->input), &info))
+	{
+		return 0;
+	}
+	bytes = ((size_t)info.st_size < STATE_CHECK_BYTES) ? (size_t)info.st_size : STATE_CHECK_BYTES;
+	check->magic = CACHE_MAGIC;
+	check->source_size = (int64_t)info.st_size;
+	check->source_mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+	check->head_hash = hash_bytes(input->data, bytes);
+	check->tail_hash = hash_bytes(input->data + info.st_size - bytes, bytes);
+	return 1;
+}
+
+/**
+ * PURPOSE: names the table image --cache keeps next to a csv
+ * INPUT PARAMETERS:
+ *    input: reader for the csv
+ * OUTPUT PARAMETERS:
+ *    returns the name, to be freed by the caller
+ */
+char* cache_name(Csv_reader* input)
+{
+	size_t size = strlen(input->name) + sizeof(CACHE_SUFFIX);
+	char* name = malloc(size);
+
+	assert(NULL != name);
+	snprintf(name, size, "%s%s", input->name, CACHE_SUFFIX);
+	return name;
+}
+
+/**
+ * PURPOSE: checks a section of a mapped image lies within the image and is aligned for the values it holds
+ * INPUT PARAMETERS:
+ *    image_size: bytes of the image
+ *    pos: position of the section within the image, -1 for a section the image does not have
+ *    size: bytes in the section
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the section fits, or if pos is -1, otherwise 0
+ */
+int fits_image(int64_t image_size, int64_t pos, int64_t size)
+{
+	return -1 == pos || (0 <= pos && 0 == pos % 8 && 0 <= size && pos + size <= image_size);
+}
+
+/**
+ * PURPOSE: maps a whole file into memory, writable but private so nothing is written back to the file
+ * INPUT PARAMETERS:
+ *    filename: name of the file
+ *    min_size: fewest bytes the file may hold, such as the size of its header
+ *    size: set to the bytes mapped
+ * OUTPUT PARAMETERS:
+ *    returns the mapped file, or NULL if it does not exist, is smaller than min_size or could not be mapped
+ */
+char* map_image_file(char* filename, size_t min_size, size_t* size)
+{
+	int fd = open(filename, O_RDONLY);
+	struct stat info;
+	char* image = MAP_FAILED;
+
+	if (-1 != fd && 0 == fstat(fd, &info) && min_size <= (size_t)info.st_size)
+	{
+		image = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		*size = (size_t)info.st_size;
+	}
+	if (-1 != fd)
+	{
+		close(fd);
+	}
+	return (MAP_FAILED != image) ? image : NULL;
+}
+
+/**
+ * PURPOSE: makes a Csv_table out of the table image at the start of a mapped file, without copying any value
+ * INPUT PARAMETERS:
+ *    image: the mapped file, starting with a Cache_header
+ *    map_size: bytes mapped, the table image may be followed by other sections
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_table whose names and values point into the image and which unmaps the file when it is freed,
+ *    or NULL if the image is not a whole table image, in which case the file is left mapped
+ */
+Csv_table* table_from_image(char* image, size_t map_size)
+{
+	Cache_header* header = (Cache_header*)image;
+	Cache_column* cached = (Cache_column*)(image + sizeof(Cache_header));
+	Csv_table* table = NULL;
+	Csv_column* column = NULL;
+	char* names = NULL;
+	int is_valid = 0; //boolean
+
+	is_valid = (CACHE_MAGIC == header->magic && 0 < header->image_size && (size_t)header->image_size <= map_size
+		&& 0 < header->col_count && 0 <= header->row_count
+		&& fits_image(header->image_size, sizeof(Cache_header), (int64_t)header->col_count * sizeof(Cache_column)));
+	for (int i = 0; i < header->col_count && is_valid; i++)
+	{
+		is_valid = (fits_image(header->image_size, cached[i].data_pos, cached[i].data_size)
+			&& fits_image(header->image_size, cached[i].offsets_pos, (int64_t)header->row_count * sizeof(size_t))
+			&& fits_image(header->image_size, cached[i].codes_pos, (int64_t)header->row_count * sizeof(int))
+			&& fits_image(header->image_size, cached[i].dict_offsets_pos, cached[i].dict_count * sizeof(size_t))
+			&& fits_image(header->image_size, cached[i].dict_hashes_pos, cached[i].dict_count * sizeof(uint64_t))
+			&& fits_image(header->image_size, cached[i].dict_buckets_pos, DICT_BUCKETS * sizeof(int))
+			&& (-1 == cached[i].offsets_pos) != (-1 == cached[i].codes_pos)
+			&& (-1 == cached[i].codes_pos || -1 != cached[i].dict_buckets_pos));
+	}
+	if (!is_valid)
+	{
+		return NULL;
+	}
+
+	table = calloc(1, sizeof(Csv_table));
+	assert(NULL != table);
+	table->image = image;
+	table->image_size = map_size;
+	table->col_count = header->col_count;
+	table->row_count = header->row_count;
+	table->row_capacity = (0 < header->row_count) ? header->row_count : 1;
+	table->columbs = malloc((header->col_count + 1) * sizeof(char*));
+	table->columns = calloc(header->col_count + 1, sizeof(Csv_column));
+	assert(NULL != table->columbs && NULL != table->columns);
+
+	//the columb names follow the columb descriptions, each ending in '\0'
+	names = image + sizeof(Cache_header) + header->col_count * sizeof(Cache_column);
+	for (int i = 0; i < header->col_count; i++)
+	{
+		table->columbs[i] = names;
+		names += strlen(names) + 1;
+
+		column = &table->columns[i];
+		column->data = image + cached[i].data_pos;
+		column->data_size = (size_t)cached[i].data_size;
+		column->data_capacity = (size_t)cached[i].data_size;
+		column->offsets = (-1 != cached[i].offsets_pos) ? (size_t*)(image + cached[i].offsets_pos) : NULL;
+		column->codes = (-1 != cached[i].codes_pos) ? (int*)(image + cached[i].codes_pos) : NULL;
+		column->dict_offsets = (-1 != cached[i].dict_offsets_pos) ? (size_t*)(image + cached[i].dict_offsets_pos) : NULL;
+		column->dict_hashes = (-1 != cached[i].dict_hashes_pos) ? (uint64_t*)(image + cached[i].dict_hashes_pos) : NULL;
+		column->dict_buckets = (-1 != cached[i].dict_buckets_pos) ? (int*)(image + cached[i].dict_buckets_pos) : NULL;
+		column->dict_count = (int)cached[i].dict_count;
+	}
+	return table;
+}
+
+/**
+ * PURPOSE: reads a csv from the table image --cache wrote next to it, mapping the image so no value is copied or parsed
+ * INPUT PARAMETERS:
+ *    input: reader for the csv
+ *    check: the csv described by describe_cache_source
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_table whose names and values point into the mapped image, the same table load_csv would give,
+ *    or NULL if there is no image or it was made from some other version of the csv
+ */
+Csv_table* read_table_cache(Csv_reader* input, Cache_header* check)
+{
+	char* name = cache_name(input);
+	size_t size = 0;
+	char* image = map_image_file(name, sizeof(Cache_header), &size);
+	Cache_header* header = (Cache_header*)image;
+	Csv_table* table = NULL;
+
+	free(name);
+	if (NULL != image && check->source_size == header->source_size && check->source_mtime == header->source_mtime
+		&& check->head_hash == header->head_hash && check->tail_hash == header->tail_hash && (int64_t)size == header->image_size)
+	{
+		table = table_from_image(image, size);
+	}
+	if (NULL != image && NULL == table)
+	{
+		munmap(image, size);
+	}
+	return table;
+}
+
+/**
+ * PURPOSE: writes a section of an image file, padding it so the section after it starts on an 8 byte boundary
+ * INPUT PARAMETERS:
+ *    output: the image being written
+ *    data: the bytes of the section, NULL for a section the image does not have
+ *    size: bytes in data
+ *    pos: position within the image the section starts at, moved on past the section and its padding
+ * OUTPUT PARAMETERS:
+ *    returns the position the section was written at, or -1 if data is NULL
+ */
+int64_t put_image_section(FILE* output, const void* data, size_t size, int64_t* pos)
+{
+	static const char padding[8] = { 0 };
+	int64_t start = *pos;
+
+	if (NULL == data)
+	{
+		return -1;
+	}
+	fwrite(data, 1, size, output);
+	fwrite(padding, 1, (8 - size % 8) % 8, output);
+	*pos += (int64_t)(size + (8 - size % 8) % 8);
+	return start;
+}
+
+/**
+ * PURPOSE: writes the table image of a loaded csv to the start of a new file
+ * INPUT PARAMETERS:
+ *    output: the file, newly created
+ *    check: the csv described by describe_cache_source before it was parsed
+ *    table: the table load_csv made from the csv
+ * OUTPUT PARAMETERS:
+ *    returns the bytes of the image, leaving output positioned at its end, or -1 if it could not be written
+ */
+int64_t write_table_image(FILE* output, Cache_header* check, Csv_table* table)
+{
+	Cache_column* cached = calloc(table->col_count + 1, sizeof(Cache_column));
+	Cache_header header = *check;
+	Csv_column* column = NULL;
+	int64_t pos = 0;
+	int is_written = 0; //boolean
+
+	assert(NULL != cached);
+
+	//the header and columb descriptions are written again once the positions of the sections are known
+	fwrite(&header, sizeof(Cache_header), 1, output);
+	fwrite(cached, sizeof(Cache_column), table->col_count, output);
+	pos = (int64_t)(sizeof(Cache_header) + table->col_count * sizeof(Cache_column));
+	for (int i = 0; i < table->col_count; i++)
+	{
+		fwrite(table->columbs[i], 1, strlen(table->columbs[i]) + 1, output);
+		pos += (int64_t)strlen(table->columbs[i]) + 1;
+	}
+	fwrite("\0\0\0\0\0\0\0", 1, (8 - pos % 8) % 8, output);
+	pos += (8 - pos % 8) % 8;
+
+	for (int i = 0; i < table->col_count; i++)
+	{
+		column = &table->columns[i];
+		cached[i].data_size = (int64_t)column->data_size;
+		cached[i].dict_count = (NULL != column->codes) ? column->dict_count : 0;
+		cached[i].data_pos = put_image_section(output, (NULL != column->data) ? column->data : "", column->data_size, &pos);
+		cached[i].offsets_pos = put_image_section(output, column->offsets, (size_t)table->row_count * sizeof(size_t), &pos);
+		cached[i].codes_pos = put_image_section(output, column->codes, (size_t)table->row_count * sizeof(int), &pos);
+		if (NULL != column->codes)
+		{
+			cached[i].dict_offsets_pos = put_image_section(output, column->dict_offsets, column->dict_count * sizeof(size_t), &pos);
+			cached[i].dict_hashes_pos = put_image_section(output, column->dict_hashes, column->dict_count * sizeof(uint64_t), &pos);
+			cached[i].dict_buckets_pos = put_image_section(output, column->dict_buckets, DICT_BUCKETS * sizeof(int), &pos);
+		}
+		else
+		{
+			cached[i].dict_offsets_pos = -1;
+			cached[i].dict_hashes_pos = -1;
+			cached[i].dict_buckets_pos = -1;
+		}
+	}
+
+	header.magic = CACHE_MAGIC;
+	header.image_size = pos;
+	header.col_count = table->col_count;
+	header.row_count = table->row_count;
+	is_written = (0 == fseek(output, 0, SEEK_SET) && 1 == fwrite(&header, sizeof(Cache_header), 1, output)
+		&& (size_t)table->col_count == fwrite(cached, sizeof(Cache_column), table->col_count, output)
+		&& 0 == fseek(output, pos, SEEK_SET));
+	free(cached);
+	return is_written ? pos : -1;
+}
+
+/**
+ * PURPOSE: writes the table image of a loaded csv next to it, so later runs with --cache can map it rather than parse the csv
+ * INPUT PARAMETERS:
+ *    input: reader for the csv
+ *    check: the csv described by describe_cache_source before it was parsed
+ *    table: the table load_csv made from the csv
+ * OUTPUT PARAMETERS:
+ *    writes the image under a temporary name and renames it into place once it is complete. an image that cannot be
+ *    written is skipped, the csv is then parsed again on the next run
+ */
+void write_table_cache(Csv_reader* input, Cache_header* check, Csv_table* table)
+{
+	char* name = cache_name(input);
+	size_t temp_size = strlen(name) + 5;
+	char* temp_name = malloc(temp_size);
+	FILE* output = NULL;
+	int is_written = 0; //boolean
+
+	assert(NULL != temp_name);
+	snprintf(temp_name, temp_size, "%s.tmp", name);
+	output = fopen(temp_name, "wb");
+	if (NULL != output)
+	{
+		is_written = (-1 != write_table_image(output, check, table));
+		is_written = (0 == fclose(output)) && is_written;
+	}
+	if (!is_written || 0 != rename(temp_name, name))
+	{
+		remove(temp_name);
+	}
+
+	free(name);
+	free(temp_name);
+}
+
+/**
+ * PURPOSE: loads a csv file fully into memory. with --cache a mapped csv is read from its table image when the image is
+ *          current, otherwise the csv is parsed and a new image is written for the next run
+ * INPUT PARAMETERS:
+ *    input: reader positioned at the start of the csv
+ *    thread_count: most threads to parse the csv with, a mapped csv is split between them in ranges of at least MIN_CHUNK_BYTES
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_table holding the columbs and rows of the csv, freed with free_csv_table,
+ *    or NULL if the csv is empty
+ */
+Csv_table* load_csv(Csv_reader* input, int thread_count)
+{
+	Csv_table* table = NULL;
+	Cache_header check;
+	int is_cached = use_cache && input->is_mapped && 0 == input->pos && describe_cache_source(input, &check); //boolean
+	int col_count = 0;
+	char** columbs = NULL;
+	char** values = NULL;
+	size_t chunk_count = 0;
+
+	table = is_cached ? read_table_cache(input, &check) : NULL;
+	if (NULL != table)
+	{
+		count_stat(&stats.rows_read, table->row_count);
+		return table;
+	}
+
+	columbs = read_csv_header(input, &col_count);
+	if (NULL != columbs && input->is_mapped && 1 < thread_count)
+	{
+		chunk_count = (input->size - input->pos) / MIN_CHUNK_BYTES;
+		chunk_count = (chunk_count < (size_t)thread_count) ? chunk_count : (size_t)thread_count;
+		table = (1 < chunk_count) ? load_csv_chunks(input, columbs, col_count, (int)chunk_count) : NULL;
+	}
+
+	//converts the rows and columbs of the input file to a table to allow for merging,
+	//the table grows as rows are added so the rows do not need counting first
+	if (NULL != columbs && NULL == table)
+	{
+		table = new_csv_table(columbs, col_count, 1024);
+		values = malloc((col_count + 1) * sizeof(char*)); //the columb names decide how many columbs every row is split into
+		assert(NULL != table && NULL != values);
+
+		while (-1 != next_csv_record(input, values, col_count))
+		{
+			if (!add_csv_row(table, values))
+			{
+				fprintf(stderr, "Unable to allocate memory for the rows of %s.\n", input->name);
+				exit(EXIT_FAILURE);
+			}
+			release_csv_reader(input);
+		}
+	}
+	if (is_cached && NULL != table)
+	{
+		write_table_cache(input, &check, table);
+	}
+
+	count_stat(&stats.rows_read, (NULL != table) ? table->row_count : 0);
+	free(columbs);
+	free(values);
+	return table;
+}
+
+/**
+ * PURPOSE: loads a csv file on its own thread and closes its reader, so two files can be loaded at once
+ * INPUT PARAMETERS:
+ *    arg: the Csv_load naming the reader and thread count
+ * OUTPUT PARAMETERS:
+ *    sets table in the Csv_load
+ */
+void* load_csv_thread(void* arg)
+{
+	Csv_load* load = arg;
+
+	load->table = load_csv(load->input, load->thread_count);
+	close_csv_reader(load->input);
+	return NULL;
+}
+
+/**
+ * PURPOSE: loads two csv files fully into memory and preformes the requested joins on them with a hash join
+ * INPUT PARAMETERS:
+ *    input1: reader for the first csv, closed once it is loaded
+ *    input2: reader for the second csv, closed once it is loaded
+ *    join_types: JOIN_NATURAL, JOIN_LEFT and JOIN_FULL_OUTER or'ed together to select which joins are preformed
+ *    thread_count: number of threads to load and join with, 1 does everything on this thread alone and writes rows in csv1 order.
+ *                  with more both files are loaded at once, sharing the threads in proportion to their sizes
+ *    is_ordered: boolean, 1 to join on this thread once the files are loaded so rows are written in csv1 order whatever
+ *                thread_count is, 0 to join the partitions of a parallel join in parallel
+ * OUTPUT PARAMETERS:
+ *    creates the output file of each requested join
+ */
+void hash_join_files(Csv_reader* input1, Csv_reader* input2, int join_types, int thread_count, int is_ordered)
+{
+	Csv_table* csv1 = NULL;
+	Csv_table* csv2 = NULL;
+	Csv_load load2;
+	pthread_t loader;
+	int threads1 = 1;
+
+	mark_phase(PHASE_LOAD);
+	if (1 < thread_count)
+	{
+		threads1 = (int)((double)thread_count * input1->size / ((double)input1->size + input2->size + 1) + 0.5);
+		threads1 = (1 > threads1) ? 1 : (thread_count - 1 < threads1) ? thread_count - 1 : threads1;
+		load2.input = input2;
+		load2.thread_count = thread_count - threads1;
+		load2.table = NULL;
+		if (0 != pthread_create(&loader, NULL, load_csv_thread, &load2))
+		{
+			fprintf(stderr, "Unable to start a worker thread.\n");
+			exit(EXIT_FAILURE);
+		}
+		csv1 = load_csv(input1, threads1);
+		close_csv_reader(input1);
+		pthread_join(loader, NULL);
+		csv2 = load2.table;
+	}
+	else
+	{
+		csv1 = load_csv(input1, 1);
+		close_csv_reader(input1);
+		csv2 = load_csv(input2, 1);
+		close_csv_reader(input2);
+	}
+
+	assert(NULL != csv1 && 0 < csv1->row_count);
+	assert(NULL != csv2);
+
+	//preforms the associated joins, creating nessesary output files
+	if (NULL != csv1 && NULL != csv2 && 1 < thread_count && !is_ordered)
+	{
+		parallel_join_csvs(csv1, csv2, join_types, thread_count);
+	}
+	else if (NULL != csv1 && NULL != csv2)
+	{
+		join_csvs(csv1, csv2, join_types);
+	}
+
+	//frees all allocated memory
+	mark_phase(PHASE_CLEANUP);
+	free_csv_table(csv1);
+	free_csv_table(csv2);
+}
+
+/**
+ * PURPOSE: adds an item to a ring buffer shared by one producer and one consumer, waiting while the ring is full
+ * INPUT PARAMETERS:
+ *    ring: the ring to add to, only ever added to by the calling thread
+ *    item: the item to add
+ */
+void push_batch(Batch_ring* ring, void* item)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+	while (RING_SIZE == tail - atomic_load_explicit(&ring->head, memory_order_acquire))
+	{
+		sched_yield();
+	}
+	ring->items[tail & (RING_SIZE - 1)] = item;
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * PURPOSE: takes the oldest item from a ring buffer shared by one producer and one consumer, waiting while the ring is empty
+ * INPUT PARAMETERS:
+ *    ring: the ring to take from, only ever taken from by the calling thread
+ * OUTPUT PARAMETERS:
+ *    returns the item
+ */
+void* pop_batch(Batch_ring* ring)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	void* item = NULL;
+
+	while (head == atomic_load_explicit(&ring->tail, memory_order_acquire))
+	{
+		sched_yield();
+	}
+	item = ring->items[head & (RING_SIZE - 1)];
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	return item;
+}
+
+/**
+ * PURPOSE: joins the batches of streamed records handed to one worker of a pipelined join until it is handed NULL
+ * INPUT PARAMETERS:
+ *    arg: the worker's Stream_worker
+ * OUTPUT PARAMETERS:
+ *    passes each batch on to the writer with its joined rows gathered in the batch, followed by NULL
+ */
+void* join_stream_batches(void* arg)
+{
+	Stream_worker* worker = arg;
+	Stream_pipeline* pipeline = worker->pipeline;
+	Row_batch* batch = NULL;
+	Join_key key;
+	char** csv1_values = NULL;
+
+	init_join_key(&key, pipeline->join_cols->count);
+	while (NULL != (batch = pop_batch(&pipeline->to_workers[worker->id])))
+	{
+		for (int r = 0; r < batch->row_count; r++)
+		{
+			csv1_values = batch->values + (size_t)r * pipeline->col_count;
+			make_join_key(&key, pipeline->index, pipeline->csv2, pipeline->join_cols, csv1_values, NULL, 0);
+			probe_join_index(pipeline->index, pipeline->csv2, pipeline->csv2_matched, &key, csv1_values, &batch->rows);
+		}
+		push_batch(&pipeline->to_writer[worker->id], batch);
+	}
+	push_batch(&pipeline->to_writer[worker->id], NULL);
+
+	free_join_key(&key);
+	return NULL;
+}
+
+/**
+ * PURPOSE: writes the joined rows of a pipelined join to the output files, taking batches from the workers in the same
+ *          turn they were handed out so rows are written in the order they were read
+ * INPUT PARAMETERS:
+ *    arg: the Stream_pipeline
+ * OUTPUT PARAMETERS:
+ *    appends every batch's rows to the output files, handing each written batch back to the reader until a worker passes NULL
+ */
+void* write_stream_batches(void* arg)
+{
+	Stream_pipeline* pipeline = arg;
+	Row_batch* batch = NULL;
+
+	for (int i = 0; NULL != (batch = pop_batch(&pipeline->to_writer[i])); i = (i + 1) % pipeline->worker_count)
+	{
+		append_csv_rows(pipeline->outputs->natural, batch->rows.natural);
+		append_csv_rows(pipeline->outputs->left, batch->rows.left);
+		append_csv_rows(pipeline->outputs->full_outer, batch->rows.full_outer);
+
+		//batches finish in the order they were read, so nothing before this one's last record is still in use
+		release_csv_data(pipeline->input, batch->end);
+		push_batch(&pipeline->free_batches, batch);
+	}
+	return NULL;
+}
+
+/**
+ * PURPOSE: streams the records of csv1 through a pipeline of threads. this thread splits the records into batches and
+ *          hands them out in turn to the join workers, which pass their joined rows on to a writer thread. the stages are
+ *          joined by lock free ring buffers so reading, joining and writing all happen at once
+ * INPUT PARAMETERS:
+ *    input1: reader for the first csv, positioned after its header
+ *    col_count: number of columbs of the first csv
+ *    csv2: the table holding all rows of csv2
+ *    join_cols: the columbs shared by both csvs
+ *    index: Join_index built over csv2
+ *    csv2_matched: boolean for each csv2 row, set to 1 for every row a csv1 row matches
+ *    outputs: the open join outputs
+ *    worker_count: number of join workers
+ * OUTPUT PARAMETERS:
+ *    appends the joined rows of every csv1 record to the outputs, in the order the records are read
+ */
+void pipeline_stream_join(Csv_reader* input1, int col_count, Csv_table* csv2, Join_cols* join_cols, Join_index* index,
+	atomic_char* csv2_matched, Join_outputs* outputs, int worker_count)
+{
+	Stream_pipeline pipeline;
+	Stream_worker* workers = malloc((worker_count + 1) * sizeof(Stream_worker));
+	pthread_t* threads = malloc((worker_count + 1) * sizeof(pthread_t));
+	int batch_count = (2 * worker_count + 2 < RING_SIZE) ? 2 * worker_count + 2 : RING_SIZE; //batches in flight at once
+	int batch_rows = (BATCH_VALUES / col_count > 1) ? BATCH_VALUES / col_count : 1; //records in each full batch
+	Row_batch* batches = calloc(batch_count + 1, sizeof(Row_batch));
+	Row_batch* batch = NULL;
+	int turn = 0;
+
+	memset(&pipeline, 0, sizeof(Stream_pipeline));
+	pipeline.input = input1;
+	pipeline.col_count = col_count;
+	pipeline.csv2 = csv2;
+	pipeline.join_cols = join_cols;
+	pipeline.index = index;
+	pipeline.csv2_matched = csv2_matched;
+	pipeline.outputs = outputs;
+	pipeline.worker_count = worker_count;
+	pipeline.to_workers = calloc(worker_count + 1, sizeof(Batch_ring));
+	pipeline.to_writer = calloc(worker_count + 1, sizeof(Batch_ring));
+	assert(NULL != workers && NULL != threads && NULL != batches && NULL != pipeline.to_workers && NULL != pipeline.to_writer);
+
+	for (int b = 0; b < batch_count; b++)
+	{
+		batches[b].values = malloc(((size_t)batch_rows * col_count + 1) * sizeof(char*));
+		assert(NULL != batches[b].values);
+		init_join_outputs(&batches[b].rows, col_count, csv2->col_count, join_cols);
+		batches[b].rows.natural = (NULL != outputs->natural) ? new_csv_writer(-1, 0) : NULL;
+		batches[b].rows.left = (NULL != outputs->left) ? new_csv_writer(-1, 0) : NULL;
+		batches[b].rows.full_outer = (NULL != outputs->full_outer) ? new_csv_writer(-1, 0) : NULL;
+		push_batch(&pipeline.free_batches, &batches[b]);
+	}
+
+	for (int i = 0; i <= worker_count; i++)
+	{
+		workers[i].pipeline = &pipeline;
+		workers[i].id = i;
+		if (0 != pthread_create(&threads[i], NULL, (i < worker_count) ? join_stream_batches : write_stream_batches,
+			(i < worker_count) ? (void*)&workers[i] : (void*)&pipeline))
+		{
+			fprintf(stderr, "Unable to start a worker thread.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	//fills batches until the records run out, handing them to the workers in turn
+	do
+	{
+		batch = pop_batch(&pipeline.free_batches);
+		batch->row_count = 0;
+		while (batch_rows > batch->row_count
+			&& -1 != next_csv_record(input1, batch->values + (size_t)batch->row_count * col_count, col_count))
+		{
+			batch->row_count++;
+		}
+		batch->end = input1->pos;
+		count_stat(&stats.rows_read, batch->row_count);
+		if (0 < batch->row_count)
+		{
+			push_batch(&pipeline.to_workers[turn], batch);
+			turn = (turn + 1) % worker_count;
+		}
+	} while (batch_rows == batch->row_count);
+
+	//the writer stops at the first NULL it reaches, which is in the turn after the last batch
+	for (int i = 0; i < worker_count; i++)
+	{
+		push_batch(&pipeline.to_workers[(turn + i) % worker_count], NULL);
+	}
+	for (int i = 0; i <= worker_count; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	for (int b = 0; b < batch_count; b++)
+	{
+		close_join_outputs(&batches[b].rows);
+		free(batches[b].values);
+	}
+	free(batches);
+	free(pipeline.to_workers);
+	free(pipeline.to_writer);
+	free(workers);
+	free(threads);
+}
+
+/**
+ * PURPOSE: loads a csv and writes it to an index file together with a hash index over the chosen columbs, so later runs
+ *          given the file with --index can join against the csv without loading it or building its index
+ * INPUT PARAMETERS:
+ *    input: reader for the csv, closed once it is loaded
+ *    filename: name of the index file to write
+ *    col_list: names of the columbs to index, separated by commas. split in place
+ *    thread_count: most threads to load the csv with
+ * OUTPUT PARAMETERS:
+ *    writes the index file, exiting the program if a columb is not in the csv or the file cannot be written. the file holds
+ *    the csv's table image followed by the index and a Bloom filter, which --index only uses with --bloom
+ */
+void build_index_file(Csv_reader* input, char* filename, char* col_list, int thread_count)
+{
+	Cache_header check;
+	Index_header header;
+	Csv_table* table = NULL;
+	Join_cols join_cols;
+	Join_index* index = NULL;
+	char** names = malloc((strlen(col_list) + 2) * sizeof(char*));
+	int name_count = 0;
+	size_t temp_size = strlen(filename) + 5;
+	char* temp_name = malloc(temp_size);
+	FILE* output = NULL;
+	int64_t pos = 0;
+	int64_t header_pos = 0;
+	int is_written = 0; //boolean
+	int is_found = 0; //boolean
+
+	assert(NULL != names && NULL != temp_name);
+	for (char* name = col_list; NULL != name; name_count++)
+	{
+		names[name_count] = name;
+		name = strchr(name, ',');
+		if (NULL != name)
+		{
+			*name = '\0';
+			name++;
+		}
+	}
+
+	mark_phase(PHASE_LOAD);
+	if (!input->is_mapped || !describe_cache_source(input, &check))
+	{
+		memset(&check, 0, sizeof(Cache_header));
+	}
+	table = load_csv(input, thread_count);
+	close_csv_reader(input);
+	if (NULL == table)
+	{
+		fprintf(stderr, "Unable to index an empty csv.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	mark_phase(PHASE_JOIN_COLS);
+	for (int n = 0; n < name_count; n++)
+	{
+		is_found = 0;
+		for (int i = 0; i < table->col_count; i++)
+		{
+			is_found |= (0 == strcmp(names[n], table->columbs[i]));
+		}
+		if (!is_found)
+		{
+			fprintf(stderr, "Unknown columb %s in --index-cols\n", names[n]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	find_joined_cols(names, name_count, table->columbs, table->col_count, &join_cols);
+	find_key_types(&join_cols, table);
+
+	//the Bloom filter is always stored so a run can choose whether to use it
+	mark_phase(PHASE_INDEX);
+	use_bloom = 1;
+	index = build_join_index(NULL, table, &join_cols);
+	assert(NULL != index);
+
+	mark_phase(PHASE_OUTPUT);
+	snprintf(temp_name, temp_size, "%s.tmp", filename);
+	output = fopen(temp_name, "wb");
+	if (NULL != output)
+	{
+		//the index header follows the table image and is written again once the positions of the arrays are known
+		pos = write_table_image(output, &check, table);
+		header_pos = pos;
+		memset(&header, 0, sizeof(Index_header));
+		is_written = (-1 != pos && 1 == fwrite(&header, sizeof(Index_header), 1, output));
+		header.magic = INDEX_MAGIC;
+		header.key_count = join_cols.count;
+		header.row_count = table->row_count;
+		header.bucket_count = (int64_t)index->mask + 1;
+		header.bloom_count = (int64_t)index->bloom_mask + 1;
+		pos += sizeof(Index_header);
+		header.cols_pos = put_image_section(output, join_cols.csv2_index, join_cols.count * sizeof(int), &pos);
+		header.types_pos = put_image_section(output, join_cols.key_types, join_cols.count * sizeof(int), &pos);
+		header.scales_pos = put_image_section(output, join_cols.key_scales, join_cols.count * sizeof(int), &pos);
+		header.buckets_pos = put_image_section(output, index->buckets, (size_t)header.bucket_count * sizeof(int), &pos);
+		header.next_pos = put_image_section(output, index->next, (size_t)table->row_count * sizeof(int), &pos);
+		header.hashes_pos = put_image_section(output, index->hashes, (size_t)table->row_count * sizeof(uint64_t), &pos);
+		header.keys_pos = put_image_section(output, index->keys, (size_t)table->row_count * join_cols.count * sizeof(int64_t), &pos);
+		header.bloom_pos = put_image_section(output, index->bloom, (size_t)header.bloom_count * sizeof(uint64_t), &pos);
+		header.file_size = pos;
+		is_written = is_written && 0 == fseek(output, (long)header_pos, SEEK_SET) && 1 == fwrite(&header, sizeof(Index_header), 1, output);
+		is_written = (0 == fclose(output)) && is_written;
+		//the index file is this mode's output, so its size is what --stats reports as written
+		count_stat(&stats.bytes_written, is_written ? (long)pos : 0);
+	}
+	if (!is_written || 0 != rename(temp_name, filename))
+	{
+		fprintf(stderr, "Unable to write %s.\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	mark_phase(PHASE_CLEANUP);
+	free_join_index(index);
+	free_join_cols(&join_cols);
+	free_csv_table(table);
+	free(names);
+	free(temp_name);
+}
+
+/**
+ * PURPOSE: maps an index file written by --build-index, giving the table it holds with its stored index attached
+ * INPUT PARAMETERS:
+ *    filename: name of the index file
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_table whose names, values and stored_index point into the mapped file, exiting the program if the file
+ *    cannot be read or was not written by --build-index
+ */
+Csv_table* open_index_file(char* filename)
+{
+	size_t size = 0;
+	char* image = map_image_file(filename, sizeof(Cache_header), &size);
+	Csv_table* table = (NULL != image) ? table_from_image(image, size) : NULL;
+	Index_header* header = NULL;
+	int64_t row_count = 0;
+	int is_valid = (NULL != table); //boolean
+
+	if (is_valid)
+	{
+		header = (Index_header*)(image + ((Cache_header*)image)->image_size);
+		row_count = table->row_count;
+		is_valid = (fits_image((int64_t)size, (int64_t)((char*)header - image), sizeof(Index_header)) && INDEX_MAGIC == header->magic
+			&& (int64_t)size == header->file_size && row_count == header->row_count && 0 < header->key_count
+			&& 0 < header->bucket_count && 0 == (header->bucket_count & (header->bucket_count - 1))
+			&& 0 < header->bloom_count && 0 == (header->bloom_count & (header->bloom_count - 1))
+			&& fits_image(header->file_size, header->cols_pos, header->key_count * sizeof(int))
+			&& fits_image(header->file_size, header->types_pos, header->key_count * sizeof(int))
+			&& fits_image(header->file_size, header->scales_pos, header->key_count * sizeof(int))
+			&& fits_image(header->file_size, header->buckets_pos, header->bucket_count * sizeof(int))
+			&& fits_image(header->file_size, header->next_pos, row_count * sizeof(int))
+			&& fits_image(header->file_size, header->hashes_pos, row_count * sizeof(uint64_t))
+			&& fits_image(header->file_size, header->keys_pos, row_count * header->key_count * sizeof(int64_t))
+			&& fits_image(header->file_size, header->bloom_pos, header->bloom_count * sizeof(uint64_t))
+			&& -1 != header->cols_pos && -1 != header->buckets_pos && -1 != header->bloom_pos);
+		for (int n = 0; n < header->key_count && is_valid; n++)
+		{
+			is_valid = (0 <= ((int*)(image + header->cols_pos))[n] && ((int*)(image + header->cols_pos))[n] < table->col_count);
+		}
+	}
+	if (!is_valid)
+	{
+		fprintf(stderr, "Unable to read %s as an index written by --build-index.\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	table->stored_index = header;
+	return table;
+}
+
+/**
+ * PURPOSE: sets up the Join_index of a table opened with --index from the index stored with it, rather than building one
+ * INPUT PARAMETERS:
+ *    csv2: the table, may be any table
+ *    join_cols: the columbs shared by both csvs
+ * OUTPUT PARAMETERS:
+ *    returns a Join_index whose arrays point into the index file and sets the types of join_cols, or NULL if csv2 has no
+ *    stored index or it is over other columbs or types than this join needs, in which case one has to be built
+ */
+Join_index* stored_join_index(Csv_table* csv2, Join_cols* join_cols)
+{
+	Index_header* header = csv2->stored_index;
+	Join_index* index = NULL;
+	int* cols = NULL;
+	int* types = NULL;
+	int* scales = NULL;
+	int is_match = (NULL != header && header->key_count == join_cols->count); //boolean
+	int t = 0;
+
+	if (NULL == header)
+	{
+		return NULL;
+	}
+
+	//the index keys columbs in the order they were given to --build-index, which has to be the order they are shared in
+	cols = (int*)(csv2->image + header->cols_pos);
+	types = (int*)(csv2->image + header->types_pos);
+	scales = (int*)(csv2->image + header->scales_pos);
+	for (int n = 0; n < join_cols->count && is_match; n++)
+	{
+		t = find_key_type(join_cols->names[n]);
+		is_match = (cols[n] == join_cols->csv2_index[n]
+			&& (-1 == t || (key_type_types[t] == types[n] && (0 > key_type_scales[t] || key_type_scales[t] == scales[n]))));
+	}
+	if (!is_match)
+	{
+		fprintf(stderr, "The index is not over the columbs shared with the first input, building one in memory.\n");
+		return NULL;
+	}
+
+	//with every joined columb's type already known find_key_types does not look at the values
+	for (int n = 0; n < join_cols->count; n++)
+	{
+		csv2->columns[cols[n]].key_type = types[n];
+		csv2->columns[cols[n]].key_scale = scales[n];
+	}
+	find_key_types(join_cols, csv2);
+
+	index = new_join_index(NULL, csv2, join_cols);
+	assert(NULL != index);
+	index->is_mapped = 1;
+	index->rows = NULL;
+	index->mask = (uint64_t)header->bucket_count - 1;
+	index->buckets = (int*)(csv2->image + header->buckets_pos);
+	index->next = (int*)(csv2->image + header->next_pos);
+	index->hashes = (uint64_t*)(csv2->image + header->hashes_pos);
+	index->keys = (int64_t*)(csv2->image + header->keys_pos);
+	index->bloom = use_bloom ? (uint64_t*)(csv2->image + header->bloom_pos) : NULL;
+	index->bloom_mask = (uint64_t)header->bloom_count - 1;
+	return index;
+}
+
+/**
+ * PURPOSE: joins each row of a csv1 that is read a row at a time against a loaded csv2, then adds the csv2 rows none matched
+ * INPUT PARAMETERS:
+ *    input1: reader for csv1, positioned after its columb names
+ *    csv1_col_count: number of columbs csv1 containes
+ *    csv2: the table holding all rows of csv2
+ *    join_cols: the columbs shared by both csvs
+ *    index: index over the rows of csv2
+ *    outputs: the open join outputs
+ *    thread_count: with more than one the rows are joined by a pipeline of a reading thread, thread_count - 2 join workers
+ *                  (at least one) and a writing thread
+ * OUTPUT PARAMETERS:
+ *    appends the results of each requested join to outputs, the rows of csv1 in the order they are read followed by the
+ *    unmatched csv2 rows
+ */
+void stream_csv1_rows(Csv_reader* input1, int csv1_col_count, Csv_table* csv2, Join_cols* join_cols, Join_index* index, Join_outputs* outputs, int thread_count)
+{
+	char** csv1_values = malloc((csv1_col_count + 1) * sizeof(char*));
+	atomic_char* csv2_matched = calloc(csv2->row_count + 1, sizeof(atomic_char)); //boolean for each csv2 row
+	long row_count = 0; //rows streamed on this thread
+	int worker_count = (2 < thread_count) ? thread_count - 2 : 1; //join workers alongside the reading and writing threads
+	Join_key key;
+
+	assert(NULL != csv1_values && NULL != csv2_matched);
+	init_join_key(&key, join_cols->count);
+
+	if (1 < thread_count)
+	{
+		pipeline_stream_join(input1, csv1_col_count, csv2, join_cols, index, csv2_matched, outputs, worker_count);
+	}
+	while (1 == thread_count && -1 != next_csv_record(input1, csv1_values, csv1_col_count))
+	{
+		release_csv_reader(input1);
+		make_join_key(&key, index, csv2, join_cols, csv1_values, NULL, 0);
+		probe_join_index(index, csv2, csv2_matched, &key, csv1_values, outputs);
+		row_count++;
+	}
+	write_csv2_unmatched_rows(outputs, csv2, csv2_matched);
+	count_stat(&stats.rows_read, row_count);
+
+	free_join_key(&key);
+	free(csv1_values);
+	free(csv2_matched);
+}
+
+/**
+ * PURPOSE: preformes the requested joins with only the second csv held in memory, the first csv is read a row at a time
+ *          and each row is joined and written out as soon as it is read
+ * INPUT PARAMETERS:
+ *    input1: reader for the first csv, which is streamed, closed once the join is done
+ *    input2: reader for the second csv, which is loaded into memory, closed once it is loaded. NULL maps the second
+ *            csv and its index from index_file instead
+ *    join_types: JOIN_NATURAL, JOIN_LEFT and JOIN_FULL_OUTER or'ed together to select which joins are preformed
+ *    thread_count: most threads to load the second csv with. with more than one the first csv is streamed through a
+ *                  pipeline of a reading thread, thread_count - 2 join workers (at least one) and a writing thread
+ * OUTPUT PARAMETERS:
+ *    creates the output file of each requested join, with the same contents hash_join_files would create with one thread
+ */
+void stream_join_files(Csv_reader* input1, Csv_reader* input2, int join_types, int thread_count)
+{
+	int csv1_col_count = 0;
+	char** csv1_names = NULL;
+	Csv_table* csv2 = NULL;
+	Join_cols join_cols;
+	Join_outputs outputs;
+	Join_index* index = NULL;
+
+	mark_phase(PHASE_LOAD);
+	csv1_names = read_csv_header(input1, &csv1_col_count);
+	csv2 = (NULL != input2) ? load_csv(input2, thread_count) : open_index_file(index_file);
+	close_csv_reader(input2);
+	assert(NULL != csv1_names);
+	assert(NULL != csv2);
+
+	if (NULL != csv1_names && NULL != csv2)
+	{
+		mark_phase(PHASE_JOIN_COLS);
+		find_joined_cols(csv1_names, csv1_col_count, csv2->columbs, csv2->col_count, &join_cols);
+		index = stored_join_index(csv2, &join_cols);
+		if (NULL == index)
+		{
+			find_key_types(&join_cols, csv2);
+			mark_phase(PHASE_INDEX);
+			index = build_join_index(NULL, csv2, &join_cols);
+		}
+		assert(NULL != index);
+		mark_phase(PHASE_JOIN);
+		open_join_outputs(&outputs, join_types, csv1_names, csv1_col_count, csv2->columbs, csv2->col_count, &join_cols);
+		stream_csv1_rows(input1, csv1_col_count, csv2, &join_cols, index, &outputs, thread_count);
+
+		mark_phase(PHASE_OUTPUT);
+		close_join_outputs(&outputs);
+		mark_phase(PHASE_CLEANUP);
+		free_join_index(index);
+		free_join_cols(&join_cols);
+	}
+
+	close_csv_reader(input1);
+	free_csv_table(csv2);
+	free(csv1_names);
+}
+
+/**
+ * PURPOSE: collects the values of a row leaving one level of a Join_chain, laid out the same way as the output of a join of two csvs
+ * INPUT PARAMETERS:
+ *    chain: the chain the level belongs to
+ *    step: the level
+ *    csv1_values: value of each columb of the row reaching the level (or their names), NULL for an unmatched csv2 row
+ *    csv2_values: value of each columb of the csv2 row (or their names), NULL for an unmatched row reaching the level
+ * OUTPUT PARAMETERS:
+ *    fills the level's values and returns how many it holds
+ */
+int fill_chain_values(Join_chain* chain, Chain_level* step, char** csv1_values, char** csv2_values)
+{
+	if (JOIN_NATURAL == chain->join_type)
+	{
+		return fill_natural_values(csv1_values, step->csv1_col_count, csv2_values, step->csv2->col_count, &step->join_cols, step->values);
+	}
+	return fill_outer_values(csv1_values, step->csv1_col_count, csv2_values, step->csv2->col_count, &step->join_cols, step->values);
+}
+
+/**
+ * PURPOSE: sets up a chain of joins of the same type that joins a streamed csv to several tables one after the other,
+ *          giving the same rows as joining the csv to the first table, that result to the second table, and so on
+ * INPUT PARAMETERS:
+ *    chain: Join_chain struct to be filled in
+ *    join_type: JOIN_NATURAL, JOIN_LEFT or JOIN_FULL_OUTER
+ *    filename: name of the file the chain's rows are written to
+ *    csv1_names: the names of the columbs in the streamed csv
+ *    csv1_col_count: number of columbs the streamed csv containes
+ *    tables: the tables to join, in order
+ *    table_count: number of items in tables
+ * OUTPUT PARAMETERS:
+ *    builds an index over each table for the columbs it shares with the rows reaching it, creates the output file
+ *    and prints the columbs of the final rows to it
+ */
+void open_join_chain(Join_chain* chain, int join_type, char* filename, char** csv1_names, int csv1_col_count, Csv_table** tables, int table_count)
+{
+	Chain_level* step = NULL;
+	char** names = csv1_names;
+	int col_count = csv1_col_count;
+
+	chain->join_type = join_type;
+	chain->level_count = table_count;
+	chain->levels = calloc(table_count + 1, sizeof(Chain_level));
+	assert(NULL != chain->levels);
+
+	for (int k = 0; k < table_count; k++)
+	{
+		step = &chain->levels[k];
+		step->csv2 = tables[k];
+		step->csv1_col_count = col_count;
+		find_joined_cols(names, col_count, step->csv2->columbs, step->csv2->col_count, &step->join_cols);
+		find_key_types(&step->join_cols, step->csv2);
+		step->index = build_join_index(NULL, step->csv2, &step->join_cols);
+		init_join_key(&step->key, step->join_cols.count);
+		step->csv2_matched = (JOIN_FULL_OUTER == join_type) ? calloc(step->csv2->row_count + 1, sizeof(atomic_char)) : NULL;
+
+		//no row leaving the level has more values than both sides' columbs plus each shared columb once more
+		step->values = malloc((col_count + step->csv2->col_count + step->join_cols.count + 1) * sizeof(char*));
+		step->names = malloc((col_count + step->csv2->col_count + step->join_cols.count + 1) * sizeof(char*));
+		step->csv2_values = malloc((step->csv2->col_count + 1) * sizeof(char*));
+		assert(NULL != step->index && (JOIN_FULL_OUTER != join_type || NULL != step->csv2_matched)
+			&& NULL != step->values && NULL != step->names && NULL != step->csv2_values);
+
+		//the columbs leaving each level are the ones the next level is joined on
+		step->col_count = fill_chain_values(chain, step, names, step->csv2->columbs);
+		memcpy(step->names, step->values, step->col_count * sizeof(char*));
+		names = step->names;
+		col_count = step->col_count;
+	}
+
+	chain->output = open_csv_writer(filename, direct_io);
+	if (NULL == chain->output)
+	{
+		fprintf(stderr, "Unable to create %s.\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	write_csv_values(chain->output, names, col_count, 1);
+}
+
+/**
+ * PURPOSE: joins a row through the levels of a Join_chain from a given level on, writing every row that leaves the last level
+ * INPUT PARAMETERS:
+ *    chain: the chain to join the row through
+ *    level: the level the row reaches first, level_count writes it out as it is
+ *    csv1_values: value of each columb of the row
+ * OUTPUT PARAMETERS:
+ *    appends a row to the chain's output for every combination of matches the row has at each level. at each level
+ *    left join keeps only the first match, and left and full outer joins carry an unmatched row on padded with null
+ */
+void join_chain_row(Join_chain* chain, int level, char** csv1_values)
+{
+	Chain_level* step = NULL;
+	int row_matched = 0; //boolean
+
+	if (level == chain->level_count)
+	{
+		write_csv_values(chain->output, csv1_values, chain->levels[level - 1].col_count, 0);
+		return;
+	}
+	step = &chain->levels[level];
+
+	make_join_key(&step->key, step->index, step->csv2, &step->join_cols, csv1_values, NULL, 0);
+	for (int l = (step->key.has_null || step->key.is_absent) ? -1 : find_join_match(step->index, step->csv2, &step->key, &step->join_cols, -1); -1 != l;
+		l = (JOIN_LEFT == chain->join_type) ? -1 : find_join_match(step->index, step->csv2, &step->key, &step->join_cols, l))
+	{
+		if (NULL != step->csv2_matched)
+		{
+			atomic_store_explicit(&step->csv2_matched[l], 1, memory_order_relaxed);
+		}
+		fill_chain_values(chain, step, csv1_values, csv_row(step->csv2, l, step->csv2_values));
+		join_chain_row(chain, level + 1, step->values);
+		row_matched = 1;
+		step->key.matches++;
+	}
+	step->key.null_keys += step->key.has_null;
+
+	if (!row_matched && JOIN_NATURAL != chain->join_type)
+	{
+		fill_chain_values(chain, step, csv1_values, NULL);
+		join_chain_row(chain, level + 1, step->values);
+	}
+}
+
+/**
+ * PURPOSE: finishes a full outer Join_chain by carrying the rows of each table that matched nothing on through the levels after it
+ * INPUT PARAMETERS:
+ *    chain: the chain, once every row of the streamed csv has been joined through it
+ * OUTPUT PARAMETERS:
+ *    appends the rows each unmatched table row gives to the chain's output. levels are finished in order so the rows
+ *    carried on from one level can still match the tables of the levels after it
+ */
+void write_chain_unmatched(Join_chain* chain)
+{
+	Chain_level* step = NULL;
+
+	for (int k = 0; k < chain->level_count && JOIN_FULL_OUTER == chain->join_type; k++)
+	{
+		step = &chain->levels[k];
+		for (int l = 0; l < step->csv2->row_count; l++)
+		{
+			if (!atomic_load_explicit(&step->csv2_matched[l], memory_order_relaxed))
+			{
+				fill_chain_values(chain, step, NULL, csv_row(step->csv2, l, step->csv2_values));
+				join_chain_row(chain, k + 1, step->values);
 			}
-			equivilent_counter = 0;
+		}
+	}
+}
+
+/**
+ * PURPOSE: closes the output of a Join_chain and frees its levels
+ * INPUT PARAMETERS:
+ *    chain: the chain set up by open_join_chain
+ */
+void close_join_chain(Join_chain* chain)
+{
+	Chain_level* step = NULL;
 
+	close_csv_writer(chain->output);
+	for (int k = 0; k < chain->level_count; k++)
+	{
+		step = &chain->levels[k];
+		free_join_key(&step->key);
+		free_join_index(step->index);
+		free_join_cols(&step->join_cols);
+		free(step->csv2_matched);
+		free(step->values);
+		free(step->names);
+		free(step->csv2_values);
+	}
+	free(chain->levels);
+}
+
+/**
+ * PURPOSE: joins a csv to any number of other csvs in a single pass. every csv but the first is loaded into memory and
+ *          indexed, then the first csv is streamed through them a row at a time, so no intermediate results are written
+ * INPUT PARAMETERS:
+ *    inputs: readers for the csvs, the first is streamed and the rest are loaded, all are closed once the join is done
+ *    input_count: number of items in inputs, at least 2
+ *    join_types: JOIN_NATURAL, JOIN_LEFT and JOIN_FULL_OUTER or'ed together to select which joins are preformed
+ *    thread_count: most threads to load each of the other csvs with
+ * OUTPUT PARAMETERS:
+ *    creates the output file of each requested join, holding the same rows as joining the first csv to the second,
+ *    joining that result to the third and so on with the same join each time
+ */
+void chain_join_files(Csv_reader** inputs, int input_count, int join_types, int thread_count)
+{
+	int csv1_col_count = 0;
+	char** csv1_names = NULL;
+	char** csv1_values = NULL;
+	Csv_table** tables = calloc(input_count + 1, sizeof(Csv_table*));
+	Join_chain chains[3];
+	int chain_types[3] = { JOIN_NATURAL, JOIN_LEFT, JOIN_FULL_OUTER };
+	char* chain_outputs[3] = { natural_output, left_output, full_outer_output };
+	int chain_count = 0;
+	int is_loaded = 1; //boolean
+	long row_count = 0;
+
+	assert(NULL != tables);
+	mark_phase(PHASE_LOAD);
+	csv1_names = read_csv_header(inputs[0], &csv1_col_count);
+	csv1_values = malloc((csv1_col_count + 1) * sizeof(char*));
+	assert(NULL != csv1_names && NULL != csv1_values);
+	for (int k = 1; k < input_count; k++)
+	{
+		tables[k - 1] = load_csv(inputs[k], thread_count);
+		close_csv_reader(inputs[k]);
+		assert(NULL != tables[k - 1]);
+		is_loaded &= (NULL != tables[k - 1]);
+	}
+
+	if (NULL != csv1_names && is_loaded)
+	{
+		mark_phase(PHASE_INDEX);
+		for (int c = 0; c < 3; c++)
+		{
+			if (join_types & chain_types[c])
+			{
+				open_join_chain(&chains[chain_count], chain_types[c], chain_outputs[c], csv1_names, csv1_col_count, tables, input_count - 1);
+				chain_count++;
+			}
 		}
 
-		if (!row_matched && !row_completed) //handles if left row had no right counterpart
+		mark_phase(PHASE_JOIN);
+		while (-1 != next_csv_record(inputs[0], csv1_values, csv1_col_count))
 		{
-			values_size = 0;
-			for (int m = 0; m < csv1_col_count; m++)
+			release_csv_reader(inputs[0]);
+			for (int c = 0; c < chain_count; c++)
 			{
-				assert(NULL != csv1_rows[k].col[m]->value);
-				strcpy(values[values_size], csv1_rows[k].col[m]->value);
-				assert(NULL != values[values_size]);
-				values_size++;
+				join_chain_row(&chains[c], 0, csv1_values);
 			}
-			for (int m = 0; m < csv2_col_count - joined_col_count; m++)
+			row_count++;
+		}
+		for (int c = 0; c < chain_count; c++)
+		{
+			write_chain_unmatched(&chains[c]);
+		}
+		count_stat(&stats.rows_read, row_count);
+
+		mark_phase(PHASE_OUTPUT);
+		for (int c = 0; c < chain_count; c++)
+		{
+			close_join_chain(&chains[c]);
+		}
+	}
+
+	mark_phase(PHASE_CLEANUP);
+	close_csv_reader(inputs[0]);
+	for (int k = 0; k < input_count - 1; k++)
+	{
+		free_csv_table(tables[k]);
+	}
+	free(tables);
+	free(csv1_names);
+	free(csv1_values);
+}
+
+/**
+ * PURPOSE: hashes the values a record holds in its joined columbs, parsing those compared as numbers or dates so equal
+ *          values written differently hash the same
+ * INPUT PARAMETERS:
+ *    values: value of each columb of the record
+ *    key_cols: positions of the joined columbs within the record
+ *    join_cols: the columbs shared by both csvs, giving the type each is compared as
+ *    has_null: set to 1 if any of the key values is null or not of its columb's type, otherwise set to 0
+ * OUTPUT PARAMETERS:
+ *    returns the hash of the record's key, which only depends on the key values and their types so it can be kept between runs
+ */
+uint64_t hash_record_key(char** values, int* key_cols, Join_cols* join_cols, int* has_null)
+{
+	uint64_t hash = FNV_OFFSET;
+	uint64_t value_hash = 0;
+	int64_t word = 0;
+
+	*has_null = 0;
+	for (int n = 0; n < join_cols->count; n++)
+	{
+		if (KEY_TEXT != join_cols->key_types[n])
+		{
+			word = parse_key_word(values[key_cols[n]], join_cols->key_types[n], join_cols->key_scales[n]);
+			value_hash = hash_word(word);
+			*has_null |= (INVALID_WORD == word);
+		}
+		else
+		{
+			value_hash = hash_value(values[key_cols[n]]);
+			*has_null |= (0 == strcmp(values[key_cols[n]], null));
+		}
+		hash = (hash ^ value_hash) * FNV_PRIME;
+	}
+	return hash;
+}
+
+/**
+ * PURPOSE: reads the state an earlier --incremental run saved
+ * INPUT PARAMETERS:
+ *    join: Incremental_join to fill in, zeroed beforehand
+ *    filename: name of the state file
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the file was read, or 0 if it does not exist or is not a whole state file, leaving join without state
+ */
+int load_incremental_state(Incremental_join* join, char* filename)
+{
+	FILE* input = fopen(filename, "rb");
+	Incremental_header* header = &join->header;
+	int is_read = 0; //boolean
+
+	if (NULL == input)
+	{
+		return 0;
+	}
+
+	if (1 == fread(header, sizeof(Incremental_header), 1, input) && STATE_MAGIC == header->magic
+		&& 0 <= header->key_count && 0 <= header->row_counts[0] && 0 <= header->row_counts[1])
+	{
+		join->key_types = malloc((header->key_count + 1) * sizeof(int));
+		join->key_scales = malloc((header->key_count + 1) * sizeof(int));
+		join->key_seen = malloc((header->key_count + 1) * sizeof(int));
+		for (int k = 0; k < 2; k++)
+		{
+			join->row_capacity[k] = header->row_counts[k] + 1;
+			join->rows[k] = malloc((size_t)join->row_capacity[k] * sizeof(Incremental_row));
+		}
+		assert(NULL != join->key_types && NULL != join->key_scales && NULL != join->key_seen && NULL != join->rows[0] && NULL != join->rows[1]);
+
+		is_read = ((size_t)header->key_count == fread(join->key_types, sizeof(int), header->key_count, input)
+			&& (size_t)header->key_count == fread(join->key_scales, sizeof(int), header->key_count, input)
+			&& (size_t)header->key_count == fread(join->key_seen, sizeof(int), header->key_count, input)
+			&& (size_t)header->row_counts[0] == fread(join->rows[0], sizeof(Incremental_row), header->row_counts[0], input)
+			&& (size_t)header->row_counts[1] == fread(join->rows[1], sizeof(Incremental_row), header->row_counts[1], input));
+		join->old_rows[0] = header->row_counts[0];
+		join->old_rows[1] = header->row_counts[1];
+	}
+	fclose(input);
+	return is_read;
+}
+
+/**
+ * PURPOSE: writes the state of an --incremental run for the next run to pick up from, replacing the old state only once
+ *          the new state is completely written
+ * INPUT PARAMETERS:
+ *    join: the finished join
+ *    filename: name of the state file
+ * OUTPUT PARAMETERS:
+ *    writes the state file, exiting the program if it cannot be written
+ */
+void save_incremental_state(Incremental_join* join, char* filename)
+{
+	size_t name_size = strlen(filename) + 5;
+	char* temp_name = malloc(name_size);
+	Incremental_header* header = &join->header;
+	FILE* output = NULL;
+	int is_written = 0; //boolean
+
+	assert(NULL != temp_name);
+	snprintf(temp_name, name_size, "%s.tmp", filename);
+	output = fopen(temp_name, "wb");
+	if (NULL != output)
+	{
+		is_written = (1 == fwrite(header, sizeof(Incremental_header), 1, output)
+			&& (size_t)header->key_count == fwrite(join->key_types, sizeof(int), header->key_count, output)
+			&& (size_t)header->key_count == fwrite(join->key_scales, sizeof(int), header->key_count, output)
+			&& (size_t)header->key_count == fwrite(join->key_seen, sizeof(int), header->key_count, output)
+			&& (size_t)header->row_counts[0] == fwrite(join->rows[0], sizeof(Incremental_row), header->row_counts[0], output)
+			&& (size_t)header->row_counts[1] == fwrite(join->rows[1], sizeof(Incremental_row), header->row_counts[1], output));
+		is_written = (0 == fclose(output)) && is_written;
+	}
+	if (!is_written || 0 != rename(temp_name, filename))
+	{
+		fprintf(stderr, "Unable to write %s.\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	free(temp_name);
+}
+
+/**
+ * PURPOSE: finds where the records an input gained since the last --incremental run start, after checking the part of it
+ *          joined then is unchanged. must be called before any of the input is parsed, since parsing changes its data
+ * INPUT PARAMETERS:
+ *    join: the join, holding the state of the last run if there was one
+ *    k: 0 for csv1, 1 for csv2
+ * OUTPUT PARAMETERS:
+ *    returns 1 if the input only had records added to its end, setting new_start to the first of them (0 if the input
+ *    has to be joined from its start), or 0 if the input was changed in some other way. the input's current head and
+ *    tail hashes are taken either way
+ */
+int find_new_records(Incremental_join* join, int k)
+{
+	Csv_reader* reader = join->inputs[k];
+	struct stat info;
+	size_t size = 0;
+	size_t old_size = (size_t)join->header.input_sizes[k];
+	size_t check = 0;
+
+	if (0 != fstat(fileno(reader->input), &info))
+	{
+		return 0;
+	}
+	size = (size_t)info.st_size;
+	check = (size < STATE_CHECK_BYTES) ? size : STATE_CHECK_BYTES;
+	join->new_sizes[k] = (int64_t)size;
+	join->new_head_hashes[k] = hash_bytes(reader->data, check);
+	join->new_tail_hashes[k] = hash_bytes(reader->data + size - check, check);
+
+	join->new_start[k] = 0;
+	if (0 == old_size)
+	{
+		return 1;
+	}
+	check = (old_size < STATE_CHECK_BYTES) ? old_size : STATE_CHECK_BYTES;
+	if (size < old_size || join->header.head_hashes[k] != hash_bytes(reader->data, check)
+		|| join->header.tail_hashes[k] != hash_bytes(reader->data + old_size - check, check))
+	{
+		return 0;
+	}
+
+	//an input that did not end its last record either still does not, leaving the line feed the reader ends the data with,
+	//or had the line ending added before the new records
+	join->new_start[k] = old_size;
+	if ('\n' != reader->data[old_size - 1])
+	{
+		join->new_start[k] += ('\r' == reader->data[old_size] && '\n' == reader->data[old_size + 1]) ? 2 : 1;
+		return (old_size == size || '\n' == reader->data[old_size] || '\r' == reader->data[old_size]);
+	}
+	return 1;
+}
+
+/**
+ * PURPOSE: adds a row to the state of an --incremental join
+ * INPUT PARAMETERS:
+ *    join: the join
+ *    k: 0 for a csv1 row, 1 for a csv2 row
+ *    hash: hash of the row's key
+ *    has_null: boolean, the row's key holds a null or a value not of its columb's type
+ *    offset: start of the row's record within its input
+ * OUTPUT PARAMETERS:
+ *    returns the row's position among the rows of its input
+ */
+int64_t add_incremental_row(Incremental_join* join, int k, uint64_t hash, int has_null, size_t offset)
+{
+	Incremental_row* row = NULL;
+	int64_t count = join->header.row_counts[k];
+
+	if (count == join->row_capacity[k])
+	{
+		join->row_capacity[k] = (0 < count) ? count * 2 : 1024;
+		join->rows[k] = realloc(join->rows[k], (size_t)join->row_capacity[k] * sizeof(Incremental_row));
+		assert(NULL != join->rows[k]);
+		count_stat(&stats.allocations, 1);
+	}
+	row = &join->rows[k][count];
+	row->hash = hash;
+	row->offset = (int64_t)offset;
+	row->left_pos = -1;
+	row->full_pos = -1;
+	row->pad_size = 0;
+	row->has_null = has_null;
+	join->header.row_counts[k]++;
+	return count;
+}
+
+/**
+ * PURPOSE: reads the columb names of both inputs of an --incremental join, finds the columbs they share and the type each
+ *          is compared as, and reads every csv2 record not yet joined
+ * INPUT PARAMETERS:
+ *    join: the join, with new_start found for both inputs
+ *    is_fresh: boolean, 1 if both inputs are joined from their start so the types are worked out from csv2's values,
+ *              0 if the types the last run used are kept
+ * OUTPUT PARAMETERS:
+ *    returns 1 on success, or 0 if the state of the last run cannot be kept because the columbs changed or a new csv2
+ *    value would change the type its columb is compared as. input1 is left at its first record not yet joined
+ */
+int read_incremental_inputs(Incremental_join* join, int is_fresh)
+{
+	Join_cols* join_cols = &join->join_cols;
+	Csv_reader* input2 = join->inputs[1];
+	char** values = NULL;
+	uint64_t hash = 0;
+	int64_t row = 0;
+	int64_t capacity = 0;
+	int has_null = 0;
+	int t = 0;
+
+	for (int k = 0; k < 2; k++)
+	{
+		join->names[k] = read_csv_header(join->inputs[k], &join->col_counts[k]);
+		assert(NULL != join->names[k]);
+		join->inputs[k]->pos = (join->inputs[k]->pos < join->new_start[k]) ? join->new_start[k] : join->inputs[k]->pos;
+	}
+
+	find_joined_cols(join->names[0], join->col_counts[0], join->names[1], join->col_counts[1], join_cols);
+	if (is_fresh)
+	{
+		find_sorted_key_types(join_cols, input2, join->col_counts[1]);
+		join->header.key_count = join_cols->count;
+		join->key_types = realloc(join->key_types, (join_cols->count + 1) * sizeof(int));
+		join->key_scales = realloc(join->key_scales, (join_cols->count + 1) * sizeof(int));
+		join->key_seen = realloc(join->key_seen, (join_cols->count + 1) * sizeof(int));
+		assert(NULL != join->key_types && NULL != join->key_scales && NULL != join->key_seen);
+		for (int n = 0; n < join_cols->count; n++)
+		{
+			join->key_types[n] = join_cols->key_types[n];
+			join->key_scales[n] = join_cols->key_scales[n];
+			join->key_seen[n] = 0;
+		}
+	}
+	else if (join_cols->count != join->header.key_count)
+	{
+		return 0;
+	}
+
+	//a type given with --key-type that differs from the one the outputs were joined with needs them joined again
+	for (int n = 0; n < join_cols->count; n++)
+	{
+		join_cols->key_types[n] = join->key_types[n];
+		join_cols->key_scales[n] = join->key_scales[n];
+		t = find_key_type(join_cols->names[n]);
+		if (-1 != t && (key_type_types[t] != join->key_types[n] || (0 <= key_type_scales[t] && key_type_scales[t] != join->key_scales[n])))
+		{
+			return 0;
+		}
+	}
+
+	//the records of csv2 rows joined by earlier runs are only read if a new csv1 row matches them
+	join->csv2_records = calloc(join->row_capacity[1] + 1, sizeof(char**));
+	assert(NULL != join->csv2_records);
+	for (values = malloc((join->col_counts[1] + 1) * sizeof(char*)); NULL != values && -1 != next_csv_record(input2, values, join->col_counts[1]);
+		values = malloc((join->col_counts[1] + 1) * sizeof(char*)))
+	{
+		//a value the last run's types cannot hold, or the first value of a columb that only held null, could change the
+		//type a full join would compare the columb as
+		for (int n = 0; n < join_cols->count; n++)
+		{
+			t = find_key_type(join_cols->names[n]);
+			if (!is_fresh && -1 == t && 0 != strcmp(values[join_cols->csv2_index[n]], null)
+				&& (!join->key_seen[n] || (KEY_TEXT != join->key_types[n]
+				&& INVALID_WORD == parse_key_word(values[join_cols->csv2_index[n]], join->key_types[n], join->key_scales[n]))))
 			{
-				strcpy(values[values_size], null);
-				assert(NULL != values[values_size]);
-				values_size++;
+				free(values);
+				return 0;
 			}
-			joined_rows[joined_row_count] = *new_csv_row(values, csv1_col_count + csv2_col_count - joined_col_count);
+			join->key_seen[n] |= (0 != strcmp(values[join_cols->csv2_index[n]], null));
+		}
 
-			joined_row_count++;
-			row_completed = 1;
+		hash = hash_record_key(values, join_cols->csv2_index, join_cols, &has_null);
+		capacity = join->row_capacity[1];
+		row = add_incremental_row(join, 1, hash, has_null, input2->record_start);
+		if (capacity != join->row_capacity[1])
+		{
+			join->csv2_records = realloc(join->csv2_records, (size_t)join->row_capacity[1] * sizeof(char**));
+			assert(NULL != join->csv2_records);
 		}
+		join->csv2_records[row] = values;
+	}
+	assert(NULL != values);
+	free(values);
+	count_stat(&stats.rows_read, (long)(join->header.row_counts[1] - join->old_rows[1]));
+	return 1;
+}
 
-		row_matched = 0;
+/**
+ * PURPOSE: gets the values of a csv2 row of an --incremental join, reading its record the first time it is needed
+ * INPUT PARAMETERS:
+ *    join: the join
+ *    row: position of the row among csv2's rows
+ * OUTPUT PARAMETERS:
+ *    returns the value of each columb of the row, which stays valid until the join is finished
+ */
+char** incremental_csv2_record(Incremental_join* join, int64_t row)
+{
+	Csv_reader* input2 = join->inputs[1];
+
+	if (NULL == join->csv2_records[row])
+	{
+		join->csv2_records[row] = malloc((join->col_counts[1] + 1) * sizeof(char*));
+		assert(NULL != join->csv2_records[row]);
+		input2->pos = (size_t)join->rows[1][row].offset;
+		next_csv_record(input2, join->csv2_records[row], join->col_counts[1]);
 	}
+	return join->csv2_records[row];
+}
 
-	output = fopen(output_name, "w");
+/**
+ * PURPOSE: creates or reopens an output of an --incremental join
+ * INPUT PARAMETERS:
+ *    filename: name of the output
+ *    is_fresh: boolean, 1 to replace the output, 0 to add to the end of it
+ *    header: values of the output's columb names, written only when the output is replaced
+ *    header_size: number of items in header
+ * OUTPUT PARAMETERS:
+ *    returns a Csv_writer positioned at the end of the output, whose written count starts at the output's size so
+ *    csv_writer_pos gives positions within the file. exits the program if the output cannot be opened
+ */
+Csv_writer* open_incremental_output(char* filename, int is_fresh, char** header, int header_size)
+{
+	int fd = open(filename, is_fresh ? (O_WRONLY | O_CREAT | O_TRUNC) : (O_WRONLY | O_APPEND), 0644);
+	Csv_writer* writer = NULL;
 
-	//prints columbs to output file
-	for (int i = 0; i < csv1_col_count; i++)
+	if (-1 == fd)
+	{
+		fprintf(stderr, "Unable to create %s.\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	writer = new_csv_writer(fd, 0);
+	writer->written = lseek(fd, 0, SEEK_END);
+	if (is_fresh)
+	{
+		write_csv_values(writer, header, header_size, 1);
+	}
+	return writer;
+}
+
+/**
+ * PURPOSE: gives the position within its file the next byte put in a Csv_writer will have
+ * INPUT PARAMETERS:
+ *    writer: a writer with a file, not opened with O_DIRECT
+ * OUTPUT PARAMETERS:
+ *    returns the position
+ */
+int64_t csv_writer_pos(Csv_writer* writer)
+{
+	return (int64_t)writer->written + (int64_t)writer->used;
+}
+
+/**
+ * PURPOSE: writes a null padded row of an --incremental join, noting where each copy of it was written so a later run can
+ *          cut it once the row is matched
+ * INPUT PARAMETERS:
+ *    join: the join
+ *    row: the state of the row, left_pos and full_pos are only set for outputs that are open
+ *    csv1_values: value of each columb of the row if it is a csv1 row, otherwise NULL
+ *    csv2_values: value of each columb of the row if it is a csv2 row, otherwise NULL
+ */
+void write_incremental_unmatched(Incremental_join* join, Incremental_row* row, char** csv1_values, char** csv2_values)
+{
+	Join_outputs* outputs = &join->outputs;
+	Csv_writer* output = NULL;
+	int64_t start = 0;
+
+	if (NULL != csv1_values && NULL != outputs->left)
+	{
+		row->left_pos = csv_writer_pos(outputs->left);
+	}
+	if (NULL != outputs->full_outer)
+	{
+		row->full_pos = csv_writer_pos(outputs->full_outer);
+	}
+	output = (-1 != row->left_pos) ? outputs->left : outputs->full_outer;
+	if (NULL == output)
+	{
+		return;
+	}
+	start = csv_writer_pos(output);
+
+	if (NULL != csv1_values)
+	{
+		write_csv1_unmatched(outputs, csv1_values);
+	}
+	else
 	{
-		fprintf(output, "%s", csv1_columbs[i].value);
+		write_csv2_unmatched(outputs, csv2_values);
+	}
+	row->pad_size = (int)(csv_writer_pos(output) - start);
+}
 
-		if (((i < csv1_col_count - 1) || (0 < csv2_col_count)))
+/**
+ * PURPOSE: marks a null padded line of an earlier run to be cut from the left or full outer output, now its row has matched
+ * INPUT PARAMETERS:
+ *    join: the join
+ *    o: 0 for the left output, 1 for the full outer output
+ *    pos: the line's position within the output, -1 if the row has no padded line there, in which case nothing is cut
+ *    size: bytes in the line
+ * OUTPUT PARAMETERS:
+ *    returns -1, the position the row's padded line has from then on
+ */
+int64_t cut_incremental_line(Incremental_join* join, int o, int64_t pos, int size)
+{
+	if (-1 != pos)
+	{
+		if (join->cut_counts[o] == join->cut_capacity[o])
 		{
-			fprintf(output, ",");
+			join->cut_capacity[o] = (0 < join->cut_capacity[o]) ? join->cut_capacity[o] * 2 : 64;
+			join->cuts[o] = realloc(join->cuts[o], join->cut_capacity[o] * sizeof(Output_cut));
+			assert(NULL != join->cuts[o]);
 		}
+		join->cuts[o][join->cut_counts[o]].pos = pos;
+		join->cuts[o][join->cut_counts[o]].size = size;
+		join->cut_counts[o]++;
 	}
+	return -1;
+}
 
-	for (int j = 0; j < csv2_col_count; j++)
+/**
+ * PURPOSE: qsort comparison function ordering Output_cuts by their position
+ * INPUT PARAMETERS:
+ *    a, b: pointers to the two cuts being compared
+ * OUTPUT PARAMETERS:
+ *    returns a negative number, zero or a positive number if cut a comes before, at or after cut b
+ */
+int compare_output_cuts(const void* a, const void* b)
+{
+	int64_t pos_a = ((const Output_cut*)a)->pos;
+	int64_t pos_b = ((const Output_cut*)b)->pos;
+
+	return (pos_a > pos_b) - (pos_a < pos_b);
+}
+
+/**
+ * PURPOSE: removes lines from an output file in place, moving everything after each line back over it
+ * INPUT PARAMETERS:
+ *    filename: name of the output
+ *    cuts: the lines to remove, sorted by position and not overlapping
+ *    cut_count: number of items in cuts
+ * OUTPUT PARAMETERS:
+ *    shortens the output by the bytes of every line cut, exiting the program if the output cannot be rewritten.
+ *    replaces the size of each cut with the bytes cut before its line, counting its own
+ */
+void cut_output_lines(char* filename, Output_cut* cuts, int cut_count)
+{
+	int fd = open(filename, O_RDWR);
+	char* buffer = malloc(WRITE_BUFFER_SIZE);
+	int64_t write_pos = (0 < cut_count) ? cuts[0].pos : 0;
+	int64_t read_pos = 0;
+	int64_t end = 0;
+	int64_t removed = 0;
+	ssize_t part = 0;
+	int is_written = (-1 != fd); //boolean
+
+	assert(NULL != buffer);
+	for (int c = 0; c < cut_count && is_written; c++)
 	{
-		is_joined_col = 0;
-		for (int n = 0; n < joined_col_count; n++)
+		removed += cuts[c].size;
+		cuts[c].size = removed;
+		read_pos = cuts[c].pos + cuts[c].size - ((0 < c) ? cuts[c - 1].size : 0);
+		end = (c + 1 < cut_count) ? cuts[c + 1].pos : INT64_MAX;
+		while (read_pos < end && is_written)
 		{
-			if (0 == strcmp(csv2_columbs[j].value, joined_cols[n]))
+			part = pread(fd, buffer, (size_t)((end - read_pos < WRITE_BUFFER_SIZE) ? end - read_pos : WRITE_BUFFER_SIZE), read_pos);
+			if (0 >= part)
 			{
-				is_joined_col = 1;
+				is_written = (0 == part && INT64_MAX == end);
+				break;
 			}
+			is_written = (part == pwrite(fd, buffer, (size_t)part, write_pos));
+			read_pos += part;
+			write_pos += part;
+		}
+	}
+
+	if (!is_written || 0 != ftruncate(fd, write_pos))
+	{
+		fprintf(stderr, "Unable to rewrite %s.\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+	free(buffer);
+}
+
+/**
+ * PURPOSE: moves a position within an output back by the bytes cut before it
+ * INPUT PARAMETERS:
+ *    cuts: the lines cut from the output, as left by cut_output_lines
+ *    cut_count: number of items in cuts
+ *    pos: position of a line that was not cut, -1 for none
+ * OUTPUT PARAMETERS:
+ *    returns the line's position once the cuts were made, or -1 if pos was -1
+ */
+int64_t shift_output_pos(Output_cut* cuts, int cut_count, int64_t pos)
+{
+	int low = 0;
+	int high = cut_count;
+	int mid = 0;
+
+	//finds the number of cuts before pos
+	while (low < high)
+	{
+		mid = low + (high - low) / 2;
+		if (cuts[mid].pos < pos)
+		{
+			low = mid + 1;
 		}
-		if (!is_joined_col) {
-			fprintf(output, "%s", csv2_columbs[j].value);
+		else
+		{
+			high = mid;
 		}
-		if ((j < csv2_col_count - 1) && (!is_joined_col))
+	}
+	return (-1 == pos || 0 == low) ? pos : pos - cuts[low - 1].size;
+}
+
+/**
+ * PURPOSE: joins the csv1 rows of earlier runs to the csv2 rows added this run, only reading the records of csv1 rows whose
+ *          key hash matches one of the new csv2 rows
+ * INPUT PARAMETERS:
+ *    join: the join, with every new csv2 row read
+ * OUTPUT PARAMETERS:
+ *    appends every new match to the outputs, cutting the padded line of a csv1 row that matches for the first time.
+ *    input1 is left at the record it was at
+ */
+void join_old_csv1_rows(Incremental_join* join)
+{
+	Csv_reader* input1 = join->inputs[0];
+	size_t start = input1->pos;
+	int64_t new_count = join->header.row_counts[1] - join->old_rows[1];
+	Join_index* index = calloc(1, sizeof(Join_index));
+	uint64_t* hashes = malloc((new_count + 1) * sizeof(uint64_t));
+	char* has_null = malloc((new_count + 1) * sizeof(char));
+	int64_t dummy_key = 0;
+	char** csv1_values = malloc((join->col_counts[0] + 1) * sizeof(char*));
+	char** csv2_values = NULL;
+	Incremental_row* row = NULL;
+	int is_read = 0; //boolean
+
+	assert(NULL != index && NULL != hashes && NULL != has_null && NULL != csv1_values);
+	for (int64_t l = 0; l < new_count; l++)
+	{
+		hashes[l] = join->rows[1][join->old_rows[1] + l].hash;
+		has_null[l] = (char)join->rows[1][join->old_rows[1] + l].has_null;
+	}
+	if (!chain_join_rows(index, NULL, (int)new_count, hashes, has_null, &dummy_key, 0))
+	{
+		fprintf(stderr, "Unable to allocate memory for the hash table.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int64_t r = 0; r < join->old_rows[0] && 0 < new_count; r++)
+	{
+		row = &join->rows[0][r];
+		is_read = 0;
+		for (int l = row->has_null ? -1 : index->buckets[row->hash & index->mask]; -1 != l; l = index->next[l])
 		{
-			fprintf(output, ",");
+			if (index->hashes[l] != row->hash)
+			{
+				continue;
+			}
+			if (!is_read)
+			{
+				input1->pos = (size_t)row->offset;
+				next_csv_record(input1, csv1_values, join->col_counts[0]);
+				is_read = 1;
+			}
+			csv2_values = join->csv2_records[join->old_rows[1] + l];
+			join->comparisons++;
+			if (0 == compare_keys(csv1_values, join->join_cols.csv1_index, csv2_values, join->join_cols.csv2_index, join->join_cols.count))
+			{
+				//the left join keeps a row's first match, so only a row that had none gains a line there
+				write_join_match(&join->outputs, csv1_values, csv2_values, -1 != row->left_pos);
+				row->left_pos = cut_incremental_line(join, 0, row->left_pos, row->pad_size);
+				row->full_pos = cut_incremental_line(join, 1, row->full_pos, row->pad_size);
+				join->csv2_matched[l] = 1;
+				join->matches++;
+			}
 		}
 	}
 
-	for (int i = 0; i < joined_row_count; i++)
+	input1->pos = start;
+
+	free_join_index(index);
+	free(hashes);
+	free(has_null);
+	free(csv1_values);
+}
+
+/**
+ * PURPOSE: joins the csv1 rows added this run to every csv2 row, streaming them from input1
+ * INPUT PARAMETERS:
+ *    join: the join, with input1 at its first record not yet joined and every new csv2 row read
+ * OUTPUT PARAMETERS:
+ *    appends the rows of every join for each new csv1 row, cutting the padded line of an old csv2 row that matches for the
+ *    first time
+ */
+void join_new_csv1_rows(Incremental_join* join)
+{
+	Csv_reader* input1 = join->inputs[0];
+	Join_cols* join_cols = &join->join_cols;
+	Join_index* index = NULL;
+	uint64_t* hashes = NULL;
+	char* has_null = NULL;
+	int64_t dummy_key = 0;
+	int64_t csv2_count = join->header.row_counts[1];
+	char** csv1_values = malloc((join->col_counts[0] + 1) * sizeof(char*));
+	char** csv2_values = NULL;
+	Incremental_row* csv2_row = NULL;
+	uint64_t hash = 0;
+	int64_t row = 0;
+	int row_has_null = 0;
+	int row_matched = 0; //boolean
+
+	assert(NULL != csv1_values);
+	mark_phase(PHASE_INDEX);
+	while (-1 != next_csv_record(input1, csv1_values, join->col_counts[0]))
 	{
-		fprintf(output, "\n");
-		for (int j = 0; j < csv1_col_count + csv2_col_count - joined_col_count; j++)
+		release_csv_reader(input1);
+		hash = hash_record_key(csv1_values, join_cols->csv1_index, join_cols, &row_has_null);
+		row = add_incremental_row(join, 0, hash, row_has_null, input1->record_start);
+		row_matched = 0;
+
+		//the index over every csv2 row is only built once there is a new csv1 row to probe it with
+		if (NULL == index)
+		{
+			index = calloc(1, sizeof(Join_index));
+			hashes = malloc((csv2_count + 1) * sizeof(uint64_t));
+			has_null = malloc((csv2_count + 1) * sizeof(char));
+			assert(NULL != index && NULL != hashes && NULL != has_null);
+			for (int64_t l = 0; l < csv2_count; l++)
+			{
+				hashes[l] = join->rows[1][l].hash;
+				has_null[l] = (char)join->rows[1][l].has_null;
+			}
+			if (!chain_join_rows(index, NULL, (int)csv2_count, hashes, has_null, &dummy_key, 0))
+			{
+				fprintf(stderr, "Unable to allocate memory for the hash table.\n");
+				exit(EXIT_FAILURE);
+			}
+			mark_phase(PHASE_JOIN);
+		}
+
+		for (int l = (row_has_null || (NULL != index->bloom && !bloom_may_contain(index, hash))) ? -1 : index->buckets[hash & index->mask];
+			-1 != l; l = index->next[l])
 		{
-			fprintf(output, "%s", joined_rows[i].col[j]->value);
-			if (j < csv1_col_count + csv2_col_count - joined_col_count - 1)
+			if (index->hashes[l] != hash)
+			{
+				continue;
+			}
+			csv2_values = incremental_csv2_record(join, l);
+			join->comparisons++;
+			if (0 == compare_keys(csv1_values, join_cols->csv1_index, csv2_values, join_cols->csv2_index, join_cols->count))
 			{
-				fprintf(output, ",");
+				write_join_match(&join->outputs, csv1_values, csv2_values, !row_matched);
+				csv2_row = &join->rows[1][l];
+				csv2_row->full_pos = cut_incremental_line(join, 1, csv2_row->full_pos, csv2_row->pad_size);
+				if (l >= join->old_rows[1])
+				{
+					join->csv2_matched[l - join->old_rows[1]] = 1;
+				}
+				row_matched = 1;
+				join->matches++;
 			}
 		}
+		if (!row_matched)
+		{
+			write_incremental_unmatched(join, &join->rows[0][row], csv1_values, NULL);
+		}
 	}
+	count_stat(&stats.rows_read, (long)(join->header.row_counts[0] - join->old_rows[0]));
 
-	fclose(output);
+	free_join_index(index);
+	free(hashes);
+	free(has_null);
+	free(csv1_values);
 }
 
-
 /**
- * PURPOSE: preformes a full outer join on the two csvs represented by inputs and prints the resulting table as a csv named Full_Outer_Join.txt
+ * PURPOSE: preformes the requested joins on two files, saving enough state that a later run on the same files with rows
+ *          added to their ends only joins the added rows, appending the new results to the outputs and cutting the null
+ *          padded lines of rows that have since found a match. if there is no usable state the files are joined in full
  * INPUT PARAMETERS:
- *    csv1_columbs: an array of Csv_col structs holding the names of the columbs in csv1
- *    csv1_rows: an array of Csv_row structs holding all rows of csv1
- *    csv1_col_count: number of columbs csv1 containes
- *    csv1_row_count: number of rows csv1 containes
- *    csv2_columbs: an array of Csv_col structs holding the names of the columbs in csv2
- *    csv2_rows: an array of Csv_row structs holding all rows of csv2
- *    csv2_col_count: number of columbs csv2 containes
- *    csv2_row_count: number of rows csv2 containes
+ *    input1: reader for csv1, which must be mapped, closed before returning
+ *    input2: reader for csv2, which must be mapped, closed before returning
+ *    join_types: JOIN_NATURAL, JOIN_LEFT and JOIN_FULL_OUTER or'ed together to select which joins are preformed
+ *    state_file: name of the file the state is kept in between runs
  * OUTPUT PARAMETERS:
- *    creates a new file named Full_Outer_Join.txt and puts the result of a full outer joining the input csv values in it
+ *    brings the output of each requested join up to date and rewrites the state file. the outputs hold the same rows a
+ *    full join of the files would give, with the rows each run added after those of earlier runs
  */
-void full_outer_join(Csv_col* csv1_columbs, Csv_row* csv1_rows, int csv1_col_count, int csv1_row_count, Csv_col* csv2_columbs, Csv_row* csv2_rows, int csv2_col_count, int csv2_row_count)
+void incremental_join_files(Csv_reader* input1, Csv_reader* input2, int join_types, char* state_file)
 {
-	const char* output_name = "Full_Outer_Join.txt";
-	int joined_row_count = 0;
-	int joined_col_count = 0;
-	char joined_cols[MAX_COL][MAX_LINE];
-	Csv_row* joined_rows = calloc(csv1_row_count + csv2_row_count, sizeof(Csv_row));
-	Csv_row* csv2_unjoined_rows = calloc(csv2_row_count, sizeof(Csv_row));
-	char values[MAX_COL][MAX_LINE];
+	Incremental_join join;
+	Incremental_header* header = &join.header;
+	char* output_names[3] = { natural_output, left_output, full_outer_output };
+	int output_types[3] = { JOIN_NATURAL, JOIN_LEFT, JOIN_FULL_OUTER };
+	Output_cut* cuts = NULL;
+	struct stat info;
+	char** values = NULL;
 	int values_size = 0;
-	int is_joined_col = 0; //boolean
-	FILE* output;
-	int equivilent_counter = 0;
-	int row_matched = 0; //boolean
-	int empty_row_len = 1;
-	char empty_values[1][MAX_LINE] = { EMPTY };
+	int is_fresh = 0; //boolean
 
-	//duplicates the csv2 row list
-	for (int i = 0; i < csv2_row_count; i++)
+	memset(&join, 0, sizeof(Incremental_join));
+	join.inputs[0] = input1;
+	join.inputs[1] = input2;
+	if (!input1->is_mapped || !input2->is_mapped)
 	{
-		csv2_unjoined_rows[i] = csv2_rows[i];
+		fprintf(stderr, "--incremental needs both inputs to be uncompressed regular files.\n");
+		exit(EXIT_FAILURE);
 	}
 
-	for (int i = 0; i < csv1_col_count; i++)
+	//the state is only kept if it is for the same joins, the inputs only had rows added, and the outputs are as it left them
+	mark_phase(PHASE_LOAD);
+	is_fresh = !load_incremental_state(&join, state_file) || header->join_types != join_types;
+	for (int k = 0; k < 2; k++)
 	{
-		for (int j = 0; j < csv2_col_count; j++)
-		{
-			if (0 == strcmp(csv1_columbs[i].value, csv2_columbs[j].value) && 0 != strcmp(csv1_columbs[i].value, null))
-			{
-				strcpy(joined_cols[joined_col_count], csv1_columbs[i].value);
-				joined_col_count++;
-			}
-		}
+		is_fresh = !find_new_records(&join, k) || is_fresh;
+	}
+	for (int o = 0; o < 3 && !is_fresh; o++)
+	{
+		is_fresh = (join_types & output_types[o]) && (0 != stat(output_names[o], &info) || info.st_size != header->output_sizes[o]);
 	}
+	is_fresh = is_fresh || !read_incremental_inputs(&join, 0);
 
-	for (int k = 0; k < csv1_row_count; k++)
+	if (is_fresh)
 	{
-		for (int l = 0; l < csv2_row_count;l++)
+		if (STATE_MAGIC == header->magic)
 		{
-			for (int i2 = 0; i2 < joined_col_count; i2++)
+			fprintf(stderr, "%s does not match the inputs and outputs, joining the inputs in full.\n", state_file);
+		}
+		for (int64_t l = join.old_rows[1]; l < header->row_counts[1] && NULL != join.csv2_records; l++)
+		{
+			free(join.csv2_records[l]);
+		}
+		free(join.csv2_records);
+		free(join.names[0]);
+		free(join.names[1]);
+		if (NULL != join.join_cols.names)
+		{
+			free_join_cols(&join.join_cols);
+		}
+		join.csv2_records = NULL;
+		join.old_rows[0] = 0;
+		join.old_rows[1] = 0;
+		memset(header, 0, sizeof(Incremental_header));
+		for (int k = 0; k < 2; k++)
+		{
+			if (!seek_csv_reader(join.inputs[k], 0))
 			{
-				for (int j2 = 0; j2 < csv1_col_count; j2++)
-				{
-					if (0 == strcmp(csv1_columbs[j2].value, joined_cols[i2]))
-					{
-						for (int k2 = 0; k2 < csv2_col_count; k2++)
-						{
-							if (0 == strcmp(csv2_columbs[k2].value, joined_cols[i2]) && 0 != strcmp(csv2_columbs[k2].value, null))
-							{
-								if (0 == strcmp(csv1_rows[k].col[j2]->value, csv2_rows[l].col[k2]->value) && 0 != strcmp(csv1_rows[k].col[j2]->value, null))
-								{
-									equivilent_counter++;
-								}
-							}
-						}
-					}
-				}
+				fprintf(stderr, "Unable to map %s.\n", join.inputs[k]->name);
+				exit(EXIT_FAILURE);
 			}
-			if (equivilent_counter == joined_col_count)
-			{
-				row_matched = 1;
-				values_size = 0;
-				csv2_unjoined_rows[l] = *new_csv_row(empty_values, empty_row_len);
-
-				for (int m = 0; m < csv1_col_count; m++)
-				{
-					for (int m2 = 0; m2 < joined_col_count; m2++)
-					{
-						if (0 == strcmp(csv1_columbs[m].value, joined_cols[m2]))
-						{
-							if (0 == strcmp(csv1_rows[k].col[m]->value, null))
-							{
-								row_matched = 0;
-							}
-						}
-					}
-					assert(NULL != csv1_rows[k].col[m]->value);
-					strcpy(values[values_size], csv1_rows[k].col[m]->value);
-					assert(NULL != values[values_size]);
-					values_size++;
-				}
-
-
-				is_joined_col = 0;
-				for (int m = 0; m < csv2_col_count; m++)
-				{
-					is_joined_col = 0;
-					for (int n = 0; n < joined_col_count; n++)
-					{
-						if (0 == strcmp(csv2_columbs[m].value, joined_cols[n]) && 0 != strcmp(csv2_columbs[m].value, null))
-						{
-							is_joined_col = 1;
-						}
-					}
-					if (!is_joined_col)
-					{
-						assert(NULL != csv2_rows[l].col[m]->value);
-						strcpy(values[values_size], csv2_rows[l].col[m]->value);
-						assert(NULL != values[values_size]);
-						values_size++;
-					}
-				}
-
-				//creates a completed row
-				validate_values(values, values_size);
-				if (0 < values_size && row_matched)
-				{
-					joined_rows[joined_row_count] = *new_csv_row(values, csv1_col_count + csv2_col_count - joined_col_count);
-					joined_row_count++;
-				}
-				values_size = 0;
+			find_new_records(&join, k);
+		}
+		read_incremental_inputs(&join, 1);
+	}
+	header->magic = STATE_MAGIC;
+	header->join_types = join_types;
+	sort_key_types = join.join_cols.key_types;
+	sort_key_scales = join.join_cols.key_scales;
+	join.csv2_matched = calloc(header->row_counts[1] - join.old_rows[1] + 1, sizeof(char));
+	assert(NULL != join.csv2_matched);
 
-			}
-			equivilent_counter = 0;
+	//the outputs are only added to, apart from cutting padded lines once every row is joined
+	mark_phase(PHASE_JOIN);
+	init_join_outputs(&join.outputs, join.col_counts[0], join.col_counts[1], &join.join_cols);
+	values = join.outputs.values;
+	if (join_types & JOIN_NATURAL)
+	{
+		values_size = fill_natural_values(join.names[0], join.col_counts[0], join.names[1], join.col_counts[1], &join.join_cols, values);
+		join.outputs.natural = open_incremental_output(natural_output, is_fresh, values, values_size);
+	}
+	values_size = fill_outer_values(join.names[0], join.col_counts[0], join.names[1], join.col_counts[1], &join.join_cols, values);
+	if (join_types & JOIN_LEFT)
+	{
+		join.outputs.left = open_incremental_output(left_output, is_fresh, values, values_size);
+	}
+	if (join_types & JOIN_FULL_OUTER)
+	{
+		join.outputs.full_outer = open_incremental_output(full_outer_output, is_fresh, values, values_size);
+	}
 
+	join_old_csv1_rows(&join);
+	join_new_csv1_rows(&join);
+	for (int64_t l = join.old_rows[1]; l < header->row_counts[1] && NULL != join.outputs.full_outer; l++)
+	{
+		if (!join.csv2_matched[l - join.old_rows[1]])
+		{
+			write_incremental_unmatched(&join, &join.rows[1][l], NULL, join.csv2_records[l]);
 		}
+	}
+	count_stat(&stats.key_comparisons, join.comparisons);
+	count_stat(&stats.matches, join.matches);
 
-		if (!row_matched) //handles if left row had no right counterpart
+	mark_phase(PHASE_OUTPUT);
+	close_join_outputs(&join.outputs);
+	for (int o = 0; o < 2; o++)
+	{
+		cuts = join.cuts[o];
+		if (0 < join.cut_counts[o])
 		{
-			values_size = 0;
-			for (int m = 0; m < csv1_col_count; m++)
+			qsort(cuts, join.cut_counts[o], sizeof(Output_cut), compare_output_cuts);
+			cut_output_lines((0 == o) ? left_output : full_outer_output, cuts, join.cut_counts[o]);
+			for (int64_t r = 0; r < header->row_counts[0]; r++)
 			{
-				assert(NULL != csv1_rows[k].col[m]->value);
-				strcpy(values[values_size], csv1_rows[k].col[m]->value);
-				assert(NULL != values[values_size]);
-				values_size++;
+				join.rows[0][r].left_pos = (0 == o) ? shift_output_pos(cuts, join.cut_counts[o], join.rows[0][r].left_pos) : join.rows[0][r].left_pos;
+				join.rows[0][r].full_pos = (1 == o) ? shift_output_pos(cuts, join.cut_counts[o], join.rows[0][r].full_pos) : join.rows[0][r].full_pos;
 			}
-			for (int m = 0; m < csv2_col_count - joined_col_count; m++)
+			for (int64_t l = 0; l < header->row_counts[1] && 1 == o; l++)
 			{
-				strcpy(values[values_size], null);
-				assert(NULL != values[values_size]);
-				values_size++;
+				join.rows[1][l].full_pos = shift_output_pos(cuts, join.cut_counts[o], join.rows[1][l].full_pos);
 			}
-			joined_rows[joined_row_count] = *new_csv_row(values, csv1_col_count + csv2_col_count - joined_col_count);
-			joined_row_count++;
 		}
-
-		row_matched = 0;
 	}
+	for (int k = 0; k < 2; k++)
+	{
+		header->input_sizes[k] = join.new_sizes[k];
+		header->head_hashes[k] = join.new_head_hashes[k];
+		header->tail_hashes[k] = join.new_tail_hashes[k];
+	}
+	for (int o = 0; o < 3; o++)
+	{
+		header->output_sizes[o] = ((join_types & output_types[o]) && 0 == stat(output_names[o], &info)) ? (int64_t)info.st_size : 0;
+	}
+	save_incremental_state(&join, state_file);
 
-	//handles all right rows with no left counterpart
-	values_size = 0;
-	for (int i = 0; i < csv2_row_count; i++)
+	mark_phase(PHASE_CLEANUP);
+	sort_key_types = NULL;
+	sort_key_scales = NULL;
+	for (int64_t l = 0; l < header->row_counts[1]; l++)
 	{
-		if (0 != strcmp(csv2_unjoined_rows[i].col[0]->value, EMPTY))
-		{
-			for (int j = 0; j < csv1_col_count; j++)
-			{
-				is_joined_col = 0;
-				for (int n = 0; n < joined_col_count && !is_joined_col; n++)
-				{
-					if (0 == strcmp(csv1_columbs[j].value, joined_cols[n]) && 0 != strcmp(csv1_columbs[j].value, null))
-					{
-						is_joined_col = 1;
-					}
-				}
-				if (!is_joined_col)
-				{
-					strcpy(values[values_size], null);
-					values_size++;
-				}
-				else
-				{
-					for (int k = 0; k < csv2_col_count; k++)
-					{
-						if (0 == strcmp(csv1_columbs[j].value, csv2_columbs[k].value))
-						{
-							strcpy(values[values_size], csv2_unjoined_rows[i].col[k]->value);
-							values_size++;
-						}
-					}
+		free(join.csv2_records[l]);
+	}
+	free(join.csv2_records);
+	free(join.csv2_matched);
+	free(join.rows[0]);
+	free(join.rows[1]);
+	free(join.key_types);
+	free(join.key_scales);
+	free(join.key_seen);
+	free(join.cuts[0]);
+	free(join.cuts[1]);
+	free(join.names[0]);
+	free(join.names[1]);
+	free_join_cols(&join.join_cols);
+	close_csv_reader(input1);
+	close_csv_reader(input2);
+}
 
-				}
-			}
-			for (int j = 0; j < csv2_col_count; j++)
-			{
-				is_joined_col = 0;
-				for (int n = 0; n < joined_col_count && !is_joined_col; n++)
-				{
-					if (0 == strcmp(csv2_columbs[j].value, joined_cols[n]) && 0 != strcmp(csv2_columbs[j].value, null))
-					{
-						is_joined_col = 1;
-					}
-				}
-				if (!is_joined_col)
-				{
-					strcpy(values[values_size], csv2_unjoined_rows[i].col[j]->value);
-					values_size++;
-				}
-			}
+/**
+ * PURPOSE: estimates the memory a csv takes once it is loaded into a Csv_table and a hash index is built over it
+ * INPUT PARAMETERS:
+ *    data_size: bytes of the csv's records
+ *    row_count: number of records
+ *    value_count: number of values in those records
+ * OUTPUT PARAMETERS:
+ *    returns the estimate in bytes
+ */
+size_t estimate_table_memory(size_t data_size, size_t row_count, size_t value_count)
+{
+	return data_size + value_count * sizeof(size_t) + row_count * ROW_INDEX_BYTES;
+}
 
-			joined_rows[joined_row_count] = *new_csv_row(values, csv1_col_count + csv2_col_count - joined_col_count);
-			joined_row_count++;
-			values_size = 0;
-		}
+/**
+ * PURPOSE: estimates the memory a csv takes once it is loaded and indexed without parsing it, scaling up the records and
+ *          values found in its first MIN_CHUNK_BYTES
+ * INPUT PARAMETERS:
+ *    input: reader for the csv, positioned at its start
+ * OUTPUT PARAMETERS:
+ *    returns the estimate in bytes
+ */
+size_t estimate_csv_memory(Csv_reader* input)
+{
+	size_t size = input->size - input->pos;
+	size_t sample = (size < MIN_CHUNK_BYTES) ? size : MIN_CHUNK_BYTES;
+	size_t row_count = 0;
+	size_t value_count = 0;
+	char* data = input->data + input->pos;
+
+	//the size of a compressed input or pipe is not known until it has all been read, so it is taken not to fit
+	if (NULL != input->ahead)
+	{
+		return SIZE_MAX;
+	}
+	//a line break or comma within a quoted value is counted as well, which only makes the estimate larger
+	for (size_t i = 0; i < sample; i++)
+	{
+		row_count += ('\n' == data[i]);
+		value_count += ('\n' == data[i] || ',' == data[i]);
 	}
+	if (0 == sample)
+	{
+		return 0;
+	}
+	return estimate_table_memory(size, (size_t)((double)row_count * size / sample), (size_t)((double)value_count * size / sample));
+}
 
-	output = fopen(output_name, "w");
+/**
+ * PURPOSE: works out how many partitions to split some rows of csv2 into so each partition fits within --memory-limit
+ * INPUT PARAMETERS:
+ *    needed: memory the rows are estimated to take once loaded and indexed
+ * OUTPUT PARAMETERS:
+ *    returns the number of bits of the key hashes to split the rows on, from 1 to SPILL_PARTITION_BITS. the partitions
+ *    aim for half the limit each, so one holding more than its share of the rows still fits
+ */
+int spill_partition_bits(size_t needed)
+{
+	int partition_bits = 1;
 
-	//prints columbs to output file
-	for (int i = 0; i < csv1_col_count; i++)
+	while (partition_bits < SPILL_PARTITION_BITS && (needed >> partition_bits) > memory_limit / 2)
 	{
-		fprintf(output, "%s", csv1_columbs[i].value);
+		partition_bits++;
+	}
+	return partition_bits;
+}
+
+/**
+ * PURPOSE: splits the records of one csv of a grace hash join between partition files by the hash of their keys,
+ *          so the rows of both csvs that could match always land in partitions of the same number
+ * INPUT PARAMETERS:
+ *    join: the grace hash join
+ *    input: reader for the csv, positioned after its columb names
+ *    side: 0 if the csv is csv1, 1 if it is csv2
+ *    parts: 1 << partition_bits partitions to fill, zeroed beforehand
+ *    partition_bits: number of bits of the key hashes that choose a record's partition
+ *    used_bits: number of high bits of the key hashes earlier splits already used, the bits after them are used
+ * OUTPUT PARAMETERS:
+ *    writes each record to the file of its partition and counts it there, apart from records whose key holds a null,
+ *    which can match nothing and are written straight to the outputs instead
+ */
+void spill_csv(Grace_join* join, Csv_reader* input, int side, Spill_partition* parts, int partition_bits, int used_bits)
+{
+	int* key_cols = (0 == side) ? join->join_cols.csv1_index : join->join_cols.csv2_index;
+	int col_count = join->col_counts[side];
+	Spill_partition* part = NULL;
+	uint64_t hash = 0;
+	int has_null = 0; //boolean
+	size_t start = input->pos;
+	long null_keys = 0;
 
-		if (((i < csv1_col_count - 1) || (0 < csv2_col_count)))
+	for (int p = 0; p < (1 << partition_bits); p++)
+	{
+		parts[p].files[side] = tmpfile();
+		if (NULL == parts[p].files[side])
 		{
-			fprintf(output, ",");
+			fprintf(stderr, "Unable to create a temporary file to split %s into.\n", input->name);
+			exit(EXIT_FAILURE);
 		}
+		parts[p].writers[side] = new_sized_csv_writer(dup(fileno(parts[p].files[side])), 0, SPILL_BUFFER_SIZE);
+		write_run_record(parts[p].writers[side], join->names[side], col_count);
 	}
 
-	for (int j = 0; j < csv2_col_count; j++)
+	while (-1 != next_csv_record(input, join->values, col_count))
 	{
-		is_joined_col = 0;
-		for (int n = 0; n < joined_col_count; n++)
+		hash = hash_record_key(join->values, key_cols, &join->join_cols, &has_null);
+		if (has_null && 0 == side)
 		{
-			if (0 == strcmp(csv2_columbs[j].value, joined_cols[n]))
-			{
-				is_joined_col = 1;
-			}
+			write_csv1_unmatched(&join->outputs, join->values);
 		}
-		if (!is_joined_col) {
-			fprintf(output, "%s", csv2_columbs[j].value);
+		else if (has_null)
+		{
+			write_csv2_unmatched(&join->outputs, join->values);
 		}
-		if ((j < csv2_col_count - 1) && (!is_joined_col))
+		else
 		{
-			fprintf(output, ",");
+			part = &parts[hash_partition(hash << used_bits, partition_bits)];
+			write_run_record(part->writers[side], join->values, col_count);
+			part->rows[side]++;
+			part->bytes[side] += input->pos - start;
 		}
+		null_keys += has_null;
+		release_csv_reader(input);
+		start = input->pos;
+	}
+
+	for (int p = 0; p < (1 << partition_bits); p++)
+	{
+		close_csv_writer(parts[p].writers[side]);
+		parts[p].writers[side] = NULL;
 	}
+	//the other rows are counted as read once their partition is joined
+	count_stat(&stats.rows_read, null_keys);
+	count_stat(&stats.null_keys, null_keys);
+}
+
+/**
+ * PURPOSE: joins the rows of both csvs that a grace hash join put in one partition, splitting the partition again if its
+ *          csv2 rows would not fit within --memory-limit once loaded
+ * INPUT PARAMETERS:
+ *    join: the grace hash join
+ *    part: the partition, whose files are closed once it is joined
+ *    used_bits: number of high bits of the key hashes the splits that made the partition used
+ *    can_split: boolean, 0 if splitting the partition's rows last time left them all together, so their keys are most
+ *               likely all the same and splitting them again would not help
+ * OUTPUT PARAMETERS:
+ *    appends the results of each requested join on the partition's rows to the outputs
+ */
+void join_spilled_partition(Grace_join* join, Spill_partition* part, int used_bits, int can_split)
+{
+	size_t needed = estimate_table_memory(part->bytes[1], (size_t)part->rows[1], (size_t)part->rows[1] * join->col_counts[1]);
+	int partition_bits = spill_partition_bits(needed);
+	Spill_partition* parts = NULL;
+	Csv_reader* inputs[2] = { new_csv_reader(part->files[0], "a temporary partition"), new_csv_reader(part->files[1], "a temporary partition") };
+	Csv_table* csv2 = NULL;
+	Join_index* index = NULL;
+	int col_count = 0;
 
-	for (int i = 0; i < joined_row_count; i++)
+	assert(NULL != inputs[0] && NULL != inputs[1]);
+	free(read_csv_header(inputs[0], &col_count));
+
+	if (memory_limit < needed && can_split && 64 >= used_bits + partition_bits)
 	{
-		fprintf(output, "\n");
-		for (int j = 0; j < csv1_col_count + csv2_col_count - joined_col_count; j++)
+		mark_phase(PHASE_LOAD);
+		free(read_csv_header(inputs[1], &col_count));
+		parts = calloc((size_t)1 << partition_bits, sizeof(Spill_partition));
+		assert(NULL != parts);
+		spill_csv(join, inputs[1], 1, parts, partition_bits, used_bits);
+		spill_csv(join, inputs[0], 0, parts, partition_bits, used_bits);
+		close_csv_reader(inputs[0]);
+		close_csv_reader(inputs[1]);
+		for (int p = 0; p < (1 << partition_bits); p++)
 		{
-			fprintf(output, "%s", joined_rows[i].col[j]->value);
-			if (j < csv1_col_count + csv2_col_count - joined_col_count - 1)
-			{
-				fprintf(output, ",");
-			}
+			join_spilled_partition(join, &parts[p], used_bits + partition_bits, parts[p].rows[1] < part->rows[1]);
 		}
+		free(parts);
+		return;
+	}
+	if (memory_limit < needed)
+	{
+		fprintf(stderr, "%ld rows of the second input that most likely share a key take more than --memory-limit, joining them in memory.\n", part->rows[1]);
 	}
 
-	fclose(output);
-}
+	mark_phase(PHASE_LOAD);
+	csv2 = load_csv(inputs[1], join->thread_count);
+	close_csv_reader(inputs[1]);
+	assert(NULL != csv2);
 
+	//every partition compares the shared columbs as the types worked out from all of csv2, which find_key_types then keeps
+	for (int n = 0; n < join->join_cols.count; n++)
+	{
+		csv2->columns[join->join_cols.csv2_index[n]].key_type = join->join_cols.key_types[n];
+		csv2->columns[join->join_cols.csv2_index[n]].key_scale = join->join_cols.key_scales[n];
+	}
+	find_key_types(&join->join_cols, csv2);
+	mark_phase(PHASE_INDEX);
+	index = build_join_index(NULL, csv2, &join->join_cols);
+	assert(NULL != index);
+	mark_phase(PHASE_JOIN);
+	stream_csv1_rows(inputs[0], join->col_counts[0], csv2, &join->join_cols, index, &join->outputs, join->thread_count);
 
-int main(void)
-{
-	char* SEPERATORS = ",\n";
-	FILE* input1, * input2;
-	int csv1_row_count = 0;
-	int csv1_col_count = 0;
-	int csv2_row_count = 0;
-	int csv2_col_count = 0;
-	int curr_row = 0;
-	char line[MAX_LINE * MAX_COL] = "\0";
-	char temp_col[MAX_LINE] = "\0";
-	char* token;
-	char values[MAX_COL][MAX_LINE];
-	Csv_col* csv1_columbs;
-	Csv_col* csv2_columbs;
-	Csv_row* csv1_rows;
-	Csv_row* csv2_rows;
+	close_csv_reader(inputs[0]);
+	free_join_index(index);
+	free_csv_table(csv2);
+}
 
-	input1 = fopen(FILENAME1, "r");
-	assert(NULL != input1);
+/**
+ * PURPOSE: preformes the requested joins as a grace hash join, for a csv2 too big to load within --memory-limit. both csvs
+ *          are split into partition files on the hash of their keys and each partition is then joined in memory on its own
+ * INPUT PARAMETERS:
+ *    input1: reader for the first csv, closed once it is split
+ *    input2: reader for the second csv, closed once it is split
+ *    join_types: JOIN_NATURAL, JOIN_LEFT and JOIN_FULL_OUTER or'ed together to select which joins are preformed
+ *    thread_count: most threads to load and join each partition with
+ * OUTPUT PARAMETERS:
+ *    creates the output file of each requested join with the same rows as hash_join_files, written partition by partition.
+ *    rows whose key holds a null come first, then the rows of each partition in the order of the csvs
+ */
+void grace_join_files(Csv_reader* input1, Csv_reader* input2, int join_types, int thread_count)
+{
+	Grace_join join;
+	Spill_partition* parts = NULL;
+	int partition_bits = spill_partition_bits(estimate_csv_memory(input2));
+	int max_cols = 0; //columbs of whichever input has more, the most values a spilled row is split into
 
-	input2 = fopen(FILENAME2, "r");
-	assert(NULL != input2);
-	;
+	memset(&join, 0, sizeof(Grace_join));
+	join.thread_count = thread_count;
 
-    //only attempts to process files if they both exist and can be opened 
-	if (NULL != input1 && NULL != input2)
+	mark_phase(PHASE_LOAD);
+	join.names[0] = read_csv_header(input1, &join.col_counts[0]);
+	join.names[1] = read_csv_header(input2, &join.col_counts[1]);
+	assert(0 < join.col_counts[0] && 0 < join.col_counts[1]);
+	if (0 == join.col_counts[0] || 0 == join.col_counts[1])
 	{
-		fclose(input1);
-		fclose(input2);
-
-		//gets basic information about both files such as row and columb counts to allow for merging 
+		close_csv_reader(input1);
+		close_csv_reader(input2);
+		free(join.names[0]);
+		free(join.names[1]);
+		return;
+	}
 
-		csv1_row_count = count_lines(FILENAME1) - 1;//-1 for columb row
-		csv1_col_count = count_columbs(FILENAME1, SEPERATORS);
-		assert(0 < csv1_row_count);
-		assert(-1 < csv1_col_count);
+	//the keys are hashed by the type of each shared columb before any partition is loaded, so values that match but are
+	//written differently land in the same partition
+	mark_phase(PHASE_JOIN_COLS);
+	find_joined_cols(join.names[0], join.col_counts[0], join.names[1], join.col_counts[1], &join.join_cols);
+	find_sorted_key_types(&join.join_cols, input2, join.col_counts[1]);
+	open_join_outputs(&join.outputs, join_types, join.names[0], join.col_counts[0], join.names[1], join.col_counts[1], &join.join_cols);
 
-		csv1_columbs = calloc(csv1_col_count, sizeof(Csv_col));
-		csv1_rows = calloc(csv1_row_count, sizeof(Csv_row));
-		assert(NULL != csv1_columbs);
-		assert(NULL != csv1_rows);
+	//partitions only last as long as the run, so no table image is kept of them
+	use_cache = 0;
+	mark_phase(PHASE_LOAD);
+	max_cols = (join.col_counts[0] > join.col_counts[1]) ? join.col_counts[0] : join.col_counts[1];
+	join.values = malloc((max_cols + 1) * sizeof(char*));
+	parts = calloc((size_t)1 << partition_bits, sizeof(Spill_partition));
+	assert(NULL != join.values && NULL != parts);
+	spill_csv(&join, input2, 1, parts, partition_bits, 0);
+	spill_csv(&join, input1, 0, parts, partition_bits, 0);
+	close_csv_reader(input1);
+	close_csv_reader(input2);
 
-		input1 = fopen(FILENAME1, "r");
+	for (int p = 0; p < (1 << partition_bits); p++)
+	{
+		join_spilled_partition(&join, &parts[p], partition_bits, 1);
+	}
 
-		csv2_row_count = count_lines(FILENAME2) - 1;//-1 for collumb row
-		csv2_col_count = count_columbs(FILENAME2, SEPERATORS);
-		assert(-1 < csv2_row_count);
-		assert(-1 < csv2_col_count);
+	mark_phase(PHASE_OUTPUT);
+	close_join_outputs(&join.outputs);
+	mark_phase(PHASE_CLEANUP);
+	free_join_cols(&join.join_cols);
+	free(parts);
+	free(join.values);
+	free(join.names[0]);
+	free(join.names[1]);
+}
 
-		csv2_columbs = calloc(csv2_col_count, sizeof(Csv_col));
-		csv2_rows = calloc(csv2_row_count, sizeof(Csv_row));
-		assert(NULL != csv2_columbs);
-		assert(NULL != csv2_rows);
 
+int main(int argc, char* argv[])
+{
+	char* default_files[] = { FILENAME1, FILENAME2 };
+	char** filenames = malloc((argc + 1) * sizeof(char*)); //input files given on the command line
+	Csv_reader** inputs = NULL;
+	int input_count = 0;
+	int stdin_count = 0;
+	int is_opened = 1; //boolean
+	int join_types = 0; //joins asked for with --natural, --left and --full-outer, every join if none are
+	int sort_merge = 0; //boolean
+	int stream = 0; //boolean
+	int thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN); //threads used to load and join the files, one per core unless --threads is given
+	int is_ordered = 1; //boolean, a hash join keeps rows in the order of the first input unless --threads is given
+	char* end = NULL;
+	char* type = NULL;
+	char* state_file = NULL; //file --incremental keeps the state of the last run in, NULL to join the files in full
+	char* build_file = NULL; //index file --build-index writes, NULL to join the files
+	char* index_cols = NULL; //columbs --build-index indexes, as given to --index-cols
+	int grace = 0; //boolean, the second input is too big for --memory-limit so both inputs are split into partitions
 
-		input2 = fopen(FILENAME2, "r");
+	if (1 > thread_count)
+	{
+		thread_count = 1;
+	}
 
-		//converts the rows and columbs of the first input file to arrays to allow for merging 
-		if (NULL != fgets(line, MAX_LINE * MAX_COL, input1))
+	assert(NULL != filenames);
+	for (int i = 1; i < argc; i++)
+	{
+		if (0 == strcmp(argv[i], "--sort-merge"))
+		{
+			sort_merge = 1;
+		}
+		else if (0 == strcmp(argv[i], "--stream"))
+		{
+			stream = 1;
+		}
+		else if (0 == strcmp(argv[i], "--direct-io"))
+		{
+			direct_io = 1;
+		}
+		else if (0 == strcmp(argv[i], "--stats"))
+		{
+			show_stats = 1;
+		}
+		else if (0 == strcmp(argv[i], "--bloom"))
+		{
+			use_bloom = 1;
+		}
+		else if (0 == strcmp(argv[i], "--cache"))
+		{
+			use_cache = 1;
+		}
+		else if (0 == strcmp(argv[i], "--build-index") && i + 1 < argc)
 		{
-			token = strtok(line, SEPERATORS);
-			for (int i = 0; i < csv1_col_count; i++)
+			i++;
+			build_file = argv[i];
+		}
+		else if (0 == strcmp(argv[i], "--index-cols") && i + 1 < argc)
+		{
+			i++;
+			index_cols = argv[i];
+		}
+		else if (0 == strcmp(argv[i], "--index") && i + 1 < argc)
+		{
+			i++;
+			index_file = argv[i];
+		}
+		else if (0 == strcmp(argv[i], "--incremental") && i + 1 < argc)
+		{
+			i++;
+			state_file = argv[i];
+		}
+		else if (0 == strcmp(argv[i], "--threads") && i + 1 < argc)
+		{
+			i++;
+			thread_count = (int)strtol(argv[i], &end, 10);
+			if ('\0' != *end || 1 > thread_count)
 			{
-				if (NULL != token) {
-					strcpy(temp_col, token);
-					if (i == csv1_col_count - 1)
-					{
-						temp_col[strlen(temp_col) - 1] = '\0';
-					}
-					csv1_columbs[i] = *new_csv_col(temp_col);
-					token = strtok(NULL, SEPERATORS);
-				}
+				fprintf(stderr, "Invalid thread count %s\n", argv[i]);
+				return 1;
 			}
-
-			while (NULL != fgets(line, MAX_LINE * MAX_COL, input1))
+			is_ordered = 0;
+		}
+		else if (0 == strcmp(argv[i], "--memory-limit") && i + 1 < argc)
+		{
+			i++;
+			memory_limit = (size_t)strtoull(argv[i], &end, 10);
+			memory_limit <<= ('K' == *end) ? 10 : ('M' == *end) ? 20 : ('G' == *end) ? 30 : 0;
+			end += ('K' == *end || 'M' == *end || 'G' == *end);
+			if ('\0' != *end || '-' == argv[i][0] || 0 == memory_limit)
 			{
-				token = strtok(line, SEPERATORS);
-				for (int i = 0; i < csv1_col_count; i++)
-				{
-					if (NULL != token && MAX_LINE > strlen(token))
-					{
-						strcpy(values[i], token);
-
-						//fixes error with strtok where an extra overwritting charecter is placed at the end of a line
-						if ((i == csv1_col_count - 1) && (curr_row < csv1_row_count - 1))
-						{
-							values[i][strlen(values[i]) - 1] = '\0';
-						}
-						token = strtok(NULL, SEPERATORS);
-					}
-				}
-				csv1_rows[curr_row] = *new_csv_row(values, csv1_col_count);
-				curr_row++;
+				fprintf(stderr, "Invalid memory limit %s\n", argv[i]);
+				return 1;
 			}
 		}
-
-		curr_row = 0;
-
-		//converts the rows and columbs of the second input file to arrays to allow for merging
-		if (NULL != fgets(line, MAX_LINE * MAX_COL, input2))
+		else if (0 == strcmp(argv[i], "--key-type") && i + 1 < argc)
 		{
-			token = strtok(line, SEPERATORS);
-			for (int i = 0; i < csv2_col_count; i++)
+			//split at the last '=' so column names may contain one
+			i++;
+			type = strrchr(argv[i], '=');
+			key_type_names = realloc(key_type_names, (key_type_count + 1) * sizeof(char*));
+			key_type_types = realloc(key_type_types, (key_type_count + 1) * sizeof(int));
+			key_type_scales = realloc(key_type_scales, (key_type_count + 1) * sizeof(int));
+			assert(NULL != key_type_names && NULL != key_type_types && NULL != key_type_scales);
+			key_type_scales[key_type_count] = 0;
+			if (NULL == type || type == argv[i])
 			{
-				if (NULL != token) {
-					strcpy(temp_col, token);
-					if (i == csv2_col_count - 1)
-					{
-						temp_col[strlen(temp_col) - 1] = '\0';
-					}
-					csv2_columbs[i] = *new_csv_col(temp_col);
-					token = strtok(NULL, SEPERATORS);
-				}
+				fprintf(stderr, "Invalid key type %s\n", argv[i]);
+				return 1;
 			}
-
-			while (NULL != fgets(line, MAX_LINE * MAX_COL, input2))
+			else if (0 == strcmp(type, "=text"))
 			{
-				token = strtok(line, SEPERATORS);
-				for (int i = 0; i < csv2_col_count; i++)
-				{
-					if (NULL != token && MAX_LINE > strlen(token))
-					{
-						strcpy(values[i], token);
-
-						if ((i == csv2_col_count - 1) && (curr_row < csv2_row_count - 1))
-						{
-							values[i][strlen(values[i]) - 1] = '\0';
-						}
-						token = strtok(NULL, SEPERATORS);
-					}
-				}
-				csv2_rows[curr_row] = *new_csv_row(values, csv2_col_count);
-				curr_row++;
+				key_type_types[key_type_count] = KEY_TEXT;
+			}
+			else if (0 == strcmp(type, "=integer"))
+			{
+				key_type_types[key_type_count] = KEY_NUMBER;
+			}
+			else if (0 == strcmp(type, "=decimal"))
+			{
+				key_type_types[key_type_count] = KEY_NUMBER;
+				key_type_scales[key_type_count] = -1;
 			}
+			else if (0 == strcmp(type, "=date"))
+			{
+				key_type_types[key_type_count] = KEY_DATE;
+			}
+			else
+			{
+				fprintf(stderr, "Invalid key type %s\n", argv[i]);
+				return 1;
+			}
+			*type = '\0';
+			key_type_names[key_type_count] = argv[i];
+			key_type_count++;
+		}
+		else if (0 == strcmp(argv[i], "--natural") && i + 1 < argc)
+		{
+			i++;
+			natural_output = argv[i];
+			join_types |= JOIN_NATURAL;
+		}
+		else if (0 == strcmp(argv[i], "--left") && i + 1 < argc)
+		{
+			i++;
+			left_output = argv[i];
+			join_types |= JOIN_LEFT;
 		}
+		else if (0 == strcmp(argv[i], "--full-outer") && i + 1 < argc)
+		{
+			i++;
+			full_outer_output = argv[i];
+			join_types |= JOIN_FULL_OUTER;
+		}
+		else if ('-' != argv[i][0] || 0 == strcmp(argv[i], "-"))
+		{
+			filenames[input_count] = argv[i];
+			input_count++;
+			stdin_count += (0 == strcmp(argv[i], "-"));
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\nUsage: %s [--sort-merge | --stream | --incremental STATE_FILE] [--direct-io] [--bloom] "
+				"[--cache] [--memory-limit SIZE] [--threads N] [--stats] [--key-type NAME=TYPE] [--natural FILE] [--left FILE] [--full-outer FILE] [INPUT1 INPUT2 ...]\n"
+				"       %s --build-index INDEX_FILE --index-cols NAME,NAME... INPUT\n"
+				"       %s --index INDEX_FILE [OPTIONS] INPUT\n", argv[i], argv[0], argv[0], argv[0]);
+			return 1;
+		}
+	}
 
-		//preforms the associated joins, creating nessesary output files
-		natural_join(csv1_columbs, csv1_rows, csv1_col_count, csv1_row_count, csv2_columbs, csv2_rows, csv2_col_count, csv2_row_count);
-		left_join(csv1_columbs, csv1_rows, csv1_col_count, csv1_row_count, csv2_columbs, csv2_rows, csv2_col_count, csv2_row_count);
-		full_outer_join(csv1_columbs, csv1_rows, csv1_col_count, csv1_row_count, csv2_columbs, csv2_rows, csv2_col_count, csv2_row_count);
+	//an index file stands in for the second input, and building one only reads the input it indexes
+	if ((NULL != build_file || NULL != index_file) && 1 != input_count)
+	{
+		fprintf(stderr, "--build-index and --index take a single input file.\n");
+		return 1;
+	}
+	if (NULL != build_file && NULL == index_cols)
+	{
+		fprintf(stderr, "--build-index needs the columbs to index given with --index-cols.\n");
+		return 1;
+	}
+	if (NULL != index_file && (sort_merge || NULL != state_file))
+	{
+		fprintf(stderr, "--index cannot be used with --sort-merge or --incremental.\n");
+		return 1;
+	}
+	if (1 == input_count && NULL == build_file && NULL == index_file)
+	{
+		fprintf(stderr, "At least two input files must be given, or none.\n");
+		return 1;
+	}
+	if (2 < input_count && sort_merge)
+	{
+		fprintf(stderr, "--sort-merge only joins two files.\n");
+		return 1;
+	}
+	if (NULL != state_file && (2 < input_count || sort_merge || stream))
+	{
+		fprintf(stderr, "--incremental only joins two files in hash mode.\n");
+		return 1;
+	}
+	if (0 < memory_limit && (2 < input_count || sort_merge || NULL != state_file || NULL != build_file || NULL != index_file))
+	{
+		fprintf(stderr, "--memory-limit only applies to the hash and --stream joins of two files.\n");
+		return 1;
+	}
+	if (0 == input_count)
+	{
+		free(filenames);
+		filenames = default_files;
+		input_count = 2;
+	}
+	if (0 == join_types)
+	{
+		join_types = JOIN_NATURAL | JOIN_LEFT | JOIN_FULL_OUTER;
+	}
+	//stdin can only be read once, and the rows of two joins sent to stdout would be mixed together
+	if (1 < stdin_count)
+	{
+		fprintf(stderr, "Only one input can be read from stdin.\n");
+		return 1;
+	}
+	if (1 < (0 == strcmp(natural_output, "-")) + (0 == strcmp(left_output, "-")) + (0 == strcmp(full_outer_output, "-")))
+	{
+		fprintf(stderr, "Only one join can be written to stdout.\n");
+		return 1;
+	}
+	//an incremental run adds to the outputs the last run left and rereads records by their position in the inputs
+	if (NULL != state_file && (0 < stdin_count || ((join_types & JOIN_NATURAL) && 0 == strcmp(natural_output, "-"))
+		|| ((join_types & JOIN_LEFT) && 0 == strcmp(left_output, "-")) || ((join_types & JOIN_FULL_OUTER) && 0 == strcmp(full_outer_output, "-"))))
+	{
+		fprintf(stderr, "--incremental cannot read from stdin or write to stdout.\n");
+		return 1;
+	}
+	//compressed outputs cannot have lines cut out of them or be appended to in place
+	if (NULL != state_file && (((join_types & JOIN_NATURAL) && FORMAT_PLAIN != compression_of_name(natural_output))
+		|| ((join_types & JOIN_LEFT) && FORMAT_PLAIN != compression_of_name(left_output))
+		|| ((join_types & JOIN_FULL_OUTER) && FORMAT_PLAIN != compression_of_name(full_outer_output))))
+	{
+		fprintf(stderr, "--incremental cannot write compressed outputs.\n");
+		return 1;
+	}
 
-		fclose(input1);
-		fclose(input2);
+	stats.start = now_seconds();
+	stats.phase_start = stats.start;
+	stats.phase = PHASE_OPEN;
 
-		//frees all allocated memory
-		for (int i = 0; i < csv1_row_count; i++)
+	//each file is opened and read only once, by the reader the join is handed
+	inputs = calloc(input_count + 1, sizeof(Csv_reader*));
+	assert(NULL != inputs);
+	for (int k = 0; k < input_count && is_opened; k++)
+	{
+		inputs[k] = open_csv_reader(filenames[k]);
+		is_opened = (NULL != inputs[k]);
+		if (!is_opened)
 		{
-			for (int j = 0; j < csv1_col_count; j++)
-			{
-				free(csv1_rows[i].col[j]);
-			}
+			fprintf(stderr, "Unable to open %s.\n", filenames[k]);
 		}
-		free(csv1_rows);
+	}
 
-		for (int i = 0; i < csv2_row_count; i++)
+    //only attempts to process files if they all exist and can be opened
+	if (!is_opened)
+	{
+		for (int k = 0; k < input_count; k++)
 		{
-			for (int j = 0; j < csv2_col_count; j++)
-			{
-				free(csv2_rows[i].col[j]);
-			}
+			close_csv_reader(inputs[k]);
 		}
-		free(csv2_rows);
+		return 1;
+	}
+
+	//a second file too big for the memory limit is joined a partition at a time. one that fits but does not leave room
+	//for the first file to be loaded as well has the first file streamed through it instead
+	if (0 < memory_limit && 2 == input_count && !sort_merge && NULL == state_file && NULL == build_file && NULL == index_file)
+	{
+		grace = (memory_limit < estimate_csv_memory(inputs[1]));
+		stream = stream || (!grace && memory_limit - estimate_csv_memory(inputs[1]) < estimate_csv_memory(inputs[0]));
+	}
 
-		free(csv1_columbs);
-		free(csv2_columbs);
+	//an index file is joined against by streaming the input through it like stream mode does with a loaded second file.
+	//more than two files are joined by streaming the first through all the others, sort-merge mode keeps memory use bounded
+	//for inputs too large to load, stream mode only loads the second file, otherwise both files are joined in memory
+	if (NULL != build_file)
+	{
+		build_index_file(inputs[0], build_file, index_cols, thread_count);
+	}
+	else if (NULL != index_file)
+	{
+		stream_join_files(inputs[0], NULL, join_types, thread_count);
+	}
+	else if (2 < input_count)
+	{
+		chain_join_files(inputs, input_count, join_types, thread_count);
+	}
+	else if (sort_merge)
+	{
+		sort_merge_join_files(inputs[0], inputs[1], join_types);
+	}
+	else if (grace)
+	{
+		grace_join_files(inputs[0], inputs[1], join_types, thread_count);
+	}
+	else if (stream)
+	{
+		stream_join_files(inputs[0], inputs[1], join_types, thread_count);
+	}
+	else if (NULL != state_file)
+	{
+		incremental_join_files(inputs[0], inputs[1], join_types, state_file);
 	}
 	else
 	{
-		fprintf(stderr, "Unable to open an input file.\n");
+		hash_join_files(inputs[0], inputs[1], join_types, thread_count, is_ordered);
 	}
 
-	printf("Program completed succesfully\n");
+	if (show_stats)
+	{
+		print_stats((NULL != build_file) ? "build-index" : (NULL != index_file) ? "index" : (2 < input_count) ? "chain" : sort_merge ? "sort-merge"
+			: grace ? "grace" : stream ? "stream" : (NULL != state_file) ? "incremental" : "hash",
+			(NULL != state_file) ? 1 : thread_count);
+	}
+	//stdout is left to the rows of a join written there
+	if (0 != strcmp(natural_output, "-") && 0 != strcmp(left_output, "-") && 0 != strcmp(full_outer_output, "-"))
+	{
+		printf("Program completed succesfully\n");
+	}
+	free(inputs);
+	free(key_type_names);
+	free(key_type_types);
+	free(key_type_scales);
+	if (default_files != filenames)
+	{
+		free(filenames);
+	}
 	return 0;
 }